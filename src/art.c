@@ -2,21 +2,33 @@
 /* art.c (load art files)                                                     */
 /******************************************************************************/
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "art.h"
 
+#include "cache.h"
+#include "mem.h"
 #include "rom.h"
+#include "stats.h"
 
-/* nametable */
+/* nametable (with --trim, each entry has a sixth word for the */
+/* crop origin, and bit 15 of its first word is set to say so)  */
 #define VDP_ENTRY_SIZE        5
+#define VDP_ENTRY_SIZE_ORIGIN 6
+#define VDP_ENTRY_FLAG_ORIGIN 0x8000
 #define VDP_MAX_ENTRIES       (1 << 12)
-#define VDP_NAMETABLE_SIZE    (VDP_ENTRY_SIZE * VDP_MAX_ENTRIES)
+#define VDP_NAMETABLE_SIZE    (VDP_ENTRY_SIZE_ORIGIN * VDP_MAX_ENTRIES)
+
+#define ART_ENTRY_SIZE                                                         \
+  ((G_art_options & ART_OPTION_TRIM) ? VDP_ENTRY_SIZE_ORIGIN : VDP_ENTRY_SIZE)
 
-unsigned short G_art_nametable[VDP_NAMETABLE_SIZE];
-unsigned short G_art_num_entries;
+__thread unsigned short* G_art_nametable;
+__thread unsigned short G_art_num_entries;
 
 /* palettes */
 #define VDP_COLORS_PER_PAL    16
@@ -24,41 +36,148 @@ unsigned short G_art_num_entries;
 #define VDP_ROM_MAX_PALS      (1 << 8) /* 8 KB total size */ 
 #define VDP_ROM_PALS_SIZE     (VDP_ROM_MAX_PALS * VDP_COLORS_PER_PAL)
 
-unsigned short G_art_pals[VDP_ROM_PALS_SIZE];
-unsigned short G_art_num_pals;
+__thread unsigned short* G_art_pals;
+__thread unsigned short G_art_num_pals;
+
+/* palette variants (sprites that only differ by palette) share */
+/* an entry, and have their palettes grouped at rom time        */
+#define ART_MAX_PALS_PER_ENTRY 8
+
+static __thread unsigned short* S_art_entry_pals;
+static __thread unsigned short* S_art_entry_num_pals;
+
+static __thread unsigned short* S_art_sorted_pals;
 
 /* cells */
 #define VDP_CELL_W_H          8
 #define VDP_PIXELS_PER_CELL   (VDP_CELL_W_H * VDP_CELL_W_H)
 #define VDP_BYTES_PER_CELL    (VDP_PIXELS_PER_CELL / 2)
 
+#define VDP_CELL_DEPTH_4BPP       0
+#define VDP_CELL_DEPTH_2BPP       1
+
+#define VDP_COLORS_PER_PAL_2BPP   4
+#define VDP_BYTES_PER_CELL_2BPP   (VDP_PIXELS_PER_CELL / 4)
+
 #define VDP_ROM_MAX_CELLS     (1 << 16) /* 2 MB total size */
 #define VDP_ROM_CELLS_SIZE    (VDP_ROM_MAX_CELLS * VDP_BYTES_PER_CELL)
 
 #define VDP_CACHE_MAX_CELLS   (1 << 13) /* 256 KB total size */
 #define VDP_CACHE_CELLS_SIZE  (VDP_CACHE_MAX_CELLS * VDP_BYTES_PER_CELL)
 
-unsigned char  G_art_cells[VDP_ROM_CELLS_SIZE];
-unsigned long  G_art_num_cells;
+__thread unsigned char* G_art_cells;
+__thread unsigned long  G_art_num_cells;
+
+/* the cells are packed straight into the free space at the end */
+/* of the rom, past where the nametable and palette chunks (and */
+/* the chunk table entries) can reach, so adding the cell chunk */
+/* only has to move them down into place                        */
+#define ART_CELLS_ROM_OFFSET                                                   \
+  ( 3 * ART_ROM_CHUNK_ENTRY_BYTES +                                            \
+    2 * VDP_NAMETABLE_SIZE + 2 * VDP_ROM_PALS_SIZE)
+
+static __thread unsigned long  S_art_max_cells;
+
+/* metasprites */
+#define ART_MAX_PIECE_ROWS        4
+#define ART_MAX_PIECE_COLUMNS     4
+
+/* the piece list offsets are 16 bits, so the lists must end below 1 << 16 */
+#define ART_META_MAX_PIECE_WORDS  ((1 << 16) - 1)
+
+/* the table of piece list offsets (one per entry) comes first, */
+/* and the piece lists are packed down behind it at rom time    */
+#define ART_META_BUFFER_SIZE      (VDP_MAX_ENTRIES + ART_META_MAX_PIECE_WORDS)
+
+__thread unsigned short* G_art_metasprites;
+__thread unsigned long  G_art_num_meta_words;
+
+/* angle maps */
+#define ART_ANGLE_MAX_MAP_WORDS   (VDP_MAX_ENTRIES * 4)
+
+/* like the metasprites, the table of angle map offsets (one per */
+/* entry) comes first, and the maps are packed down behind it    */
+#define ART_ANGLE_BUFFER_SIZE     (VDP_MAX_ENTRIES + ART_ANGLE_MAX_MAP_WORDS)
+
+__thread unsigned short* G_art_angles;
+__thread unsigned long  G_art_num_angle_words;
+
+/* background palettes, tiles and tilemaps */
+#define VDP_MAX_TILES             (1 << 14) /* 512 KB total size */
+#define VDP_TILES_SIZE            (VDP_MAX_TILES * VDP_BYTES_PER_CELL)
+
+#define ART_MAX_BACKGROUNDS       256
+#define ART_TILEMAP_HEADER_SIZE   4
+
+#define ART_TILEMAP_MAX_WORDS     (1 << 20)
+
+/* the tilemap headers (one per background) come first, and */
+/* the tilemaps are packed down behind them at rom time     */
+#define ART_TILEMAP_BUFFER_SIZE   (ART_MAX_BACKGROUNDS * ART_TILEMAP_HEADER_SIZE + ART_TILEMAP_MAX_WORDS)
+
+#define ART_TILE_FLIP_H           0x4000
+#define ART_TILE_FLIP_V           0x8000
+
+#define ART_TILE_HASH_SIZE        (2 * VDP_MAX_TILES)
+
+__thread unsigned short* G_art_bg_pals;
+__thread unsigned short G_art_bg_num_pals;
+
+__thread unsigned char* G_art_tiles;
+__thread unsigned long  G_art_num_tiles;
+
+__thread unsigned short* G_art_tilemaps;
+__thread unsigned short G_art_num_backgrounds;
+__thread unsigned long  G_art_num_tilemap_words;
+
+static __thread unsigned short* S_art_tile_hash;
+
+/* options */
+__thread unsigned short G_art_options;
 
 /* image variables */
 #define ART_ANIM_FLAG_LOOP      0x0001
 #define ART_ANIM_FLAG_PING_PONG 0x0002
 
-static FILE* S_art_fp;
+static __thread FILE* S_art_fp;
+
+/* gif file data in memory (for library callers) */
+static __thread unsigned char* S_art_gif_data;
+static __thread unsigned long  S_art_gif_data_size;
+
+static __thread unsigned short S_art_image_w;
+static __thread unsigned short S_art_image_h;
+
+static __thread unsigned short S_art_frame_rows;
+static __thread unsigned short S_art_frame_columns;
+static __thread unsigned short S_art_origin_row;
+static __thread unsigned short S_art_origin_column;
+static __thread unsigned short S_art_num_frames;
+static __thread unsigned short S_art_num_stored_frames;
+static __thread unsigned short S_art_anim_ticks;
+static __thread unsigned short S_art_anim_flags;
+
+/* angles */
+#define ART_MAX_ANGLES    8
+
+#define ART_ANGLE_FLIP_H  0x40
+#define ART_ANGLE_FLIP_V  0x80
 
-static unsigned short S_art_image_w;
-static unsigned short S_art_image_h;
+static __thread unsigned short S_art_num_angles;
+static __thread unsigned short S_art_num_stored_angles;
+static __thread unsigned char  S_art_angle_map[ART_MAX_ANGLES];
+static __thread unsigned char  S_art_angle_flips;
+static __thread unsigned long  S_art_angle_addr;
 
-static unsigned short S_art_frame_rows;
-static unsigned short S_art_frame_columns;
-static unsigned short S_art_num_frames;
-static unsigned short S_art_anim_ticks;
-static unsigned short S_art_anim_flags;
+static __thread unsigned short S_art_pal_index;
+static __thread unsigned short S_art_cell_depth;
+static __thread unsigned long  S_art_cells_addr;
+static __thread unsigned long  S_art_cells_size;
 
-static unsigned short S_art_pal_index;
-static unsigned long  S_art_cells_addr;
-static unsigned long  S_art_cells_size;
+/* the cells buffer is addressed in 4bpp cell sized slots, */
+/* so 2bpp sprites are padded out to an even cell count    */
+#define ART_CELL_SLOTS(num_cells)                                              \
+  ((S_art_cell_depth == VDP_CELL_DEPTH_2BPP) ? (((num_cells) + 1) / 2) : (num_cells))
 
 /* gif */
 #define ART_GIF_FLAG_GCT_EXISTS   0x0001
@@ -66,30 +185,32 @@ static unsigned long  S_art_cells_size;
 #define ART_GIF_FLAG_PAL_FOUND    0x0004
 #define ART_GIF_FLAG_DELAY_FOUND  0x0008
 #define ART_GIF_FLAG_INTERLACED   0x0010
+#define ART_GIF_FLAG_HEADER_ONLY  0x0020
+#define ART_GIF_FLAG_BACKGROUND   0x0040
 
 #define ART_GIF_DICT_MAX_ENTRIES  4096 /* 12 bits */
 #define ART_GIF_DICT_MAX_BYTES    (2 * ART_GIF_DICT_MAX_ENTRIES)
 
-static unsigned short S_art_gif_color_table_size;
+static __thread unsigned short S_art_gif_color_table_size;
 
-static unsigned short S_art_gif_colors[VDP_COLORS_PER_PAL];
+static __thread unsigned short S_art_gif_colors[VDP_COLORS_PER_PAL];
 
-static unsigned short S_art_gif_sub_left;
-static unsigned short S_art_gif_sub_top;
-static unsigned short S_art_gif_sub_w;
-static unsigned short S_art_gif_sub_h;
+static __thread unsigned short S_art_gif_sub_left;
+static __thread unsigned short S_art_gif_sub_top;
+static __thread unsigned short S_art_gif_sub_w;
+static __thread unsigned short S_art_gif_sub_h;
 
-static unsigned short S_art_gif_flags;
+static __thread unsigned short S_art_gif_flags;
 
 /* lzw */
-static unsigned char  S_art_lzw_root_bits;
-static unsigned char  S_art_lzw_code_bits;
+static __thread unsigned char  S_art_lzw_root_bits;
+static __thread unsigned char  S_art_lzw_code_bits;
 
-static unsigned short S_art_lzw_num_roots;
-static unsigned short S_art_lzw_num_codes;
+static __thread unsigned short S_art_lzw_num_roots;
+static __thread unsigned short S_art_lzw_num_codes;
 
-static unsigned short S_art_lzw_dict[ART_GIF_DICT_MAX_BYTES];
-static unsigned short S_art_lzw_dict_size;
+static __thread unsigned short* S_art_lzw_dict;
+static __thread unsigned short S_art_lzw_dict_size;
 
 /* image buffers */
 #define ART_MAX_FRAME_ROWS    16
@@ -99,41 +220,341 @@ static unsigned short S_art_lzw_dict_size;
 #define ART_MAX_CELLS_PER_FRAME  (ART_MAX_FRAME_ROWS * ART_MAX_FRAME_COLUMNS)
 #define ART_MAX_PIXELS_PER_FRAME (ART_MAX_CELLS_PER_FRAME * VDP_PIXELS_PER_CELL)
 
-/* we multiply by 2 here, because a ping-pong animation */
-/* will describe repeated frames before being reduced   */
-#define ART_PIXELS_BUFFER_SIZE (2 * ART_MAX_NUM_FRAMES * ART_MAX_PIXELS_PER_FRAME)
+/* the pixels buffer holds one angle, with twice the frames because */
+/* it describes repeated frames before its ping-pong reduction. the  */
+/* earlier angles of a set are kept too, so a set of more than one   */
+/* angle is decoded to the (otherwise idle) sheet buffer instead     */
+#define ART_PIXELS_BUFFER_SIZE     (2 * ART_MAX_NUM_FRAMES * ART_MAX_PIXELS_PER_FRAME)
+#define ART_ANGLE_SET_BUFFER_SIZE  ((ART_MAX_ANGLES + 1) * ART_MAX_NUM_FRAMES * ART_MAX_PIXELS_PER_FRAME)
 
-static unsigned char  S_art_lzw_image_buf[ART_MAX_PIXELS_PER_FRAME];
-static unsigned long  S_art_lzw_image_size;
+/* sprite sheets and backgrounds are decoded whole, and then sliced up */
+#define ART_MAX_SHEET_PIXELS   (1 << 18) /* 512 x 512 */
+#define ART_SHEET_BUFFER_SIZE  (2 * ART_MAX_NUM_FRAMES * ART_MAX_SHEET_PIXELS)
+
+#define ART_MAX_IMAGE_PIXELS   (1 << 20) /* 1024 x 1024 */
+
+static __thread unsigned char* S_art_lzw_image_buf;
+static __thread unsigned long  S_art_lzw_image_size;
 
 /* the decompressed buffer is in words, because in the middle of    */
 /* decompressing it may need to hold the codes (up to 12 bits each) */
-static unsigned short S_art_decomp_image_buf[ART_MAX_PIXELS_PER_FRAME];
-static unsigned long  S_art_decomp_image_size;
+static __thread unsigned short* S_art_decomp_image_buf;
+static __thread unsigned long  S_art_decomp_image_size;
+
+static __thread unsigned char* S_art_angle_buf;
+
+static __thread unsigned char* S_art_pixels_buf;
+static __thread unsigned long  S_art_pixels_buf_size;
+static __thread unsigned long  S_art_pixels_size;
+
+/* the gif frames are decoded to the pixels buffer, or the sheet buffer */
+/* cache records: image header words and colors, then the frames */
+#define ART_CACHE_HEADER_WORDS  (5 + VDP_COLORS_PER_PAL)
+#define ART_CACHE_HEADER_BYTES  (2 * ART_CACHE_HEADER_WORDS)
+#define ART_CACHE_BUFFER_SIZE   (ART_CACHE_HEADER_BYTES + ART_MAX_NUM_FRAMES * ART_MAX_PIXELS_PER_FRAME)
+
+static __thread unsigned char* S_art_cache_buf;
+
+static __thread unsigned char* S_art_frames_buf;
+static __thread unsigned long  S_art_frames_buf_size;
+
+/* sprite sheet */
+static __thread unsigned char* S_art_sheet_buf;
+
+static __thread unsigned short S_art_sheet_w;
+static __thread unsigned short S_art_sheet_h;
+static __thread unsigned short S_art_sheet_cell_w;
+static __thread unsigned short S_art_sheet_cell_h;
+static __thread unsigned short S_art_sheet_num_frames;
+static __thread unsigned short S_art_sheet_anim_ticks;
+static __thread unsigned short S_art_sheet_colors[VDP_COLORS_PER_PAL];
+
+/* metasprite pieces (for the current frame) */
+static __thread unsigned char  S_art_opaque_cells[ART_MAX_CELLS_PER_FRAME];
+
+static __thread unsigned short S_art_piece_rows[ART_MAX_CELLS_PER_FRAME];
+static __thread unsigned short S_art_piece_columns[ART_MAX_CELLS_PER_FRAME];
+static __thread unsigned short S_art_piece_h[ART_MAX_CELLS_PER_FRAME];
+static __thread unsigned short S_art_piece_w[ART_MAX_CELLS_PER_FRAME];
+static __thread unsigned short S_art_num_pieces;
+
+/* rom budget estimates (upper bounds from the gif headers) */
+#define ART_ROM_CHUNK_ENTRY_BYTES 6
+
+static __thread unsigned long  S_art_est_num_entries;
+static __thread unsigned long  S_art_est_num_pals;
+static __thread unsigned long  S_art_est_num_cells;
+static __thread unsigned long  S_art_est_num_meta_words;
+static __thread unsigned long  S_art_est_num_backgrounds;
+static __thread unsigned long  S_art_est_num_tiles;
+static __thread unsigned long  S_art_est_num_tilemap_words;
+static __thread unsigned long  S_art_est_num_failed;
+
+/* build report (one record per nametable entry) */
+#define ART_REPORT_SOURCE_SIZE 256
+
+struct art_report_entry
+{
+  char           source[ART_REPORT_SOURCE_SIZE];
+  unsigned short image_w;
+  unsigned short image_h;
+  unsigned short num_frames;
+  unsigned short num_stored_frames;
+  unsigned short num_angles;
+  unsigned short anim_flags;
+  unsigned short cell_depth;
+  unsigned short num_variants;
+  unsigned long  cells_addr;
+  unsigned long  cells_size;
+  unsigned long  decode_ns;
+  unsigned long  num_bytes;
+};
+
+static __thread struct art_report_entry* S_art_report;
+
+static __thread char            S_art_report_source[ART_REPORT_SOURCE_SIZE];
+static __thread char            S_art_report_sheet[ART_REPORT_SOURCE_SIZE];
+static __thread struct timespec S_art_report_start;
+static __thread unsigned short  S_art_report_variant_of;
+
+/* the counts that describe the rom data (the buffers alone */
+/* are not enough); these are kept in the context buffers,   */
+/* so the context can be picked up again on another thread   */
+struct art_state
+{
+  unsigned short num_entries;
+  unsigned short num_pals;
+  unsigned long  num_cells;
+  unsigned long  num_meta_words;
+  unsigned long  num_angle_words;
+  unsigned short bg_num_pals;
+  unsigned long  num_tiles;
+  unsigned short num_backgrounds;
+  unsigned long  num_tilemap_words;
+};
+
+static __thread struct art_state* S_art_state;
+
+/* the large buffers are owned by the packer context, */
+/* which binds them to the thread that is using it    */
+#define ART_BUFFER_BYTES(num, type)                                            \
+  ((((num) * sizeof(type)) + 7) & ~7UL)
+
+/******************************************************************************/
+/* art_buffers_size()                                                         */
+/******************************************************************************/
+unsigned long art_buffers_size()
+{
+  return
+    ART_BUFFER_BYTES(VDP_NAMETABLE_SIZE, unsigned short) +
+    ART_BUFFER_BYTES(VDP_ROM_PALS_SIZE, unsigned short) +
+    ART_BUFFER_BYTES(VDP_MAX_ENTRIES * ART_MAX_PALS_PER_ENTRY, unsigned short) +
+    ART_BUFFER_BYTES(VDP_MAX_ENTRIES, unsigned short) +
+    ART_BUFFER_BYTES(VDP_ROM_PALS_SIZE, unsigned short) +
+    ART_BUFFER_BYTES(ART_META_BUFFER_SIZE, unsigned short) +
+    ART_BUFFER_BYTES(ART_ANGLE_BUFFER_SIZE, unsigned short) +
+    ART_BUFFER_BYTES(VDP_ROM_PALS_SIZE, unsigned short) +
+    ART_BUFFER_BYTES(VDP_TILES_SIZE, unsigned char) +
+    ART_BUFFER_BYTES(ART_TILEMAP_BUFFER_SIZE, unsigned short) +
+    ART_BUFFER_BYTES(ART_TILE_HASH_SIZE, unsigned short) +
+    ART_BUFFER_BYTES(ART_GIF_DICT_MAX_BYTES, unsigned short) +
+    ART_BUFFER_BYTES(ART_MAX_IMAGE_PIXELS, unsigned char) +
+    ART_BUFFER_BYTES(ART_MAX_IMAGE_PIXELS, unsigned short) +
+    ART_BUFFER_BYTES(ART_PIXELS_BUFFER_SIZE, unsigned char) +
+    ART_BUFFER_BYTES(ART_CACHE_BUFFER_SIZE, unsigned char) +
+    ART_BUFFER_BYTES(ART_SHEET_BUFFER_SIZE, unsigned char) +
+    ART_BUFFER_BYTES(VDP_MAX_ENTRIES, struct art_report_entry) +
+    ART_BUFFER_BYTES(1, struct art_state);
+}
+
+/******************************************************************************/
+/* art_bind_buffers()                                                         */
+/******************************************************************************/
+int art_bind_buffers(unsigned char* buf)
+{
+  if (buf == NULL)
+    return 1;
+
+  G_art_nametable = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(VDP_NAMETABLE_SIZE, unsigned short);
+
+  G_art_pals = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(VDP_ROM_PALS_SIZE, unsigned short);
+
+  S_art_entry_pals = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(VDP_MAX_ENTRIES * ART_MAX_PALS_PER_ENTRY, unsigned short);
+
+  S_art_entry_num_pals = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(VDP_MAX_ENTRIES, unsigned short);
+
+  S_art_sorted_pals = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(VDP_ROM_PALS_SIZE, unsigned short);
+
+  G_art_metasprites = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(ART_META_BUFFER_SIZE, unsigned short);
+
+  G_art_angles = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(ART_ANGLE_BUFFER_SIZE, unsigned short);
+
+  G_art_bg_pals = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(VDP_ROM_PALS_SIZE, unsigned short);
+
+  G_art_tiles = (unsigned char*) buf;
+  buf += ART_BUFFER_BYTES(VDP_TILES_SIZE, unsigned char);
+
+  G_art_tilemaps = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(ART_TILEMAP_BUFFER_SIZE, unsigned short);
+
+  S_art_tile_hash = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(ART_TILE_HASH_SIZE, unsigned short);
+
+  S_art_lzw_dict = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(ART_GIF_DICT_MAX_BYTES, unsigned short);
+
+  S_art_lzw_image_buf = (unsigned char*) buf;
+  buf += ART_BUFFER_BYTES(ART_MAX_IMAGE_PIXELS, unsigned char);
+
+  S_art_decomp_image_buf = (unsigned short*) buf;
+  buf += ART_BUFFER_BYTES(ART_MAX_IMAGE_PIXELS, unsigned short);
+
+  S_art_angle_buf = (unsigned char*) buf;
+  buf += ART_BUFFER_BYTES(ART_PIXELS_BUFFER_SIZE, unsigned char);
+
+  S_art_pixels_buf = S_art_angle_buf;
+  S_art_pixels_buf_size = ART_PIXELS_BUFFER_SIZE;
+
+  S_art_cache_buf = (unsigned char*) buf;
+  buf += ART_BUFFER_BYTES(ART_CACHE_BUFFER_SIZE, unsigned char);
+
+  S_art_sheet_buf = (unsigned char*) buf;
+  buf += ART_BUFFER_BYTES(ART_SHEET_BUFFER_SIZE, unsigned char);
 
-static unsigned char  S_art_pixels_buf[ART_PIXELS_BUFFER_SIZE];
-static unsigned long  S_art_pixels_size;
+  S_art_report = (struct art_report_entry*) buf;
+  buf += ART_BUFFER_BYTES(VDP_MAX_ENTRIES, struct art_report_entry);
+
+  S_art_state = (struct art_state*) buf;
+  buf += ART_BUFFER_BYTES(1, struct art_state);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_save_state()                                                           */
+/******************************************************************************/
+int art_save_state()
+{
+  if (S_art_state == NULL)
+    return 1;
+
+  S_art_state->num_entries = G_art_num_entries;
+  S_art_state->num_pals = G_art_num_pals;
+  S_art_state->num_cells = G_art_num_cells;
+  S_art_state->num_meta_words = G_art_num_meta_words;
+  S_art_state->num_angle_words = G_art_num_angle_words;
+  S_art_state->bg_num_pals = G_art_bg_num_pals;
+  S_art_state->num_tiles = G_art_num_tiles;
+  S_art_state->num_backgrounds = G_art_num_backgrounds;
+  S_art_state->num_tilemap_words = G_art_num_tilemap_words;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_restore_state()                                                        */
+/******************************************************************************/
+int art_restore_state()
+{
+  if (S_art_state == NULL)
+    return 1;
+
+  G_art_num_entries = S_art_state->num_entries;
+  G_art_num_pals = S_art_state->num_pals;
+  G_art_num_cells = S_art_state->num_cells;
+  G_art_num_meta_words = S_art_state->num_meta_words;
+  G_art_num_angle_words = S_art_state->num_angle_words;
+  G_art_bg_num_pals = S_art_state->bg_num_pals;
+  G_art_num_tiles = S_art_state->num_tiles;
+  G_art_num_backgrounds = S_art_state->num_backgrounds;
+  G_art_num_tilemap_words = S_art_state->num_tilemap_words;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_print_memory()                                                         */
+/******************************************************************************/
+int art_print_memory()
+{
+  mem_print_buffer("Nametable", G_art_nametable, VDP_NAMETABLE_SIZE * sizeof(unsigned short));
+  mem_print_buffer("Palettes", G_art_pals, VDP_ROM_PALS_SIZE * sizeof(unsigned short));
+  mem_print_buffer("Entry Palettes", S_art_entry_pals, VDP_MAX_ENTRIES * ART_MAX_PALS_PER_ENTRY * sizeof(unsigned short));
+  mem_print_buffer("Entry Palette Counts", S_art_entry_num_pals, VDP_MAX_ENTRIES * sizeof(unsigned short));
+  mem_print_buffer("Sorted Palettes", S_art_sorted_pals, VDP_ROM_PALS_SIZE * sizeof(unsigned short));
+  mem_print_buffer("Metasprites", G_art_metasprites, ART_META_BUFFER_SIZE * sizeof(unsigned short));
+  mem_print_buffer("Angles", G_art_angles, ART_ANGLE_BUFFER_SIZE * sizeof(unsigned short));
+  mem_print_buffer("BG Palettes", G_art_bg_pals, VDP_ROM_PALS_SIZE * sizeof(unsigned short));
+  mem_print_buffer("BG Tiles", G_art_tiles, VDP_TILES_SIZE * sizeof(unsigned char));
+  mem_print_buffer("BG Tilemaps", G_art_tilemaps, ART_TILEMAP_BUFFER_SIZE * sizeof(unsigned short));
+  mem_print_buffer("BG Tile Hash", S_art_tile_hash, ART_TILE_HASH_SIZE * sizeof(unsigned short));
+  mem_print_buffer("LZW Dictionary", S_art_lzw_dict, ART_GIF_DICT_MAX_BYTES * sizeof(unsigned short));
+  mem_print_buffer("LZW Image", S_art_lzw_image_buf, ART_MAX_IMAGE_PIXELS * sizeof(unsigned char));
+  mem_print_buffer("Decompressed Image", S_art_decomp_image_buf, ART_MAX_IMAGE_PIXELS * sizeof(unsigned short));
+  mem_print_buffer("Pixels", S_art_angle_buf, ART_PIXELS_BUFFER_SIZE * sizeof(unsigned char));
+  mem_print_buffer("Cache Record", S_art_cache_buf, ART_CACHE_BUFFER_SIZE * sizeof(unsigned char));
+  mem_print_buffer("Sprite Sheet", S_art_sheet_buf, ART_SHEET_BUFFER_SIZE * sizeof(unsigned char));
+  mem_print_buffer("Report", S_art_report, VDP_MAX_ENTRIES * sizeof(struct art_report_entry));
+
+  return 0;
+}
 
 /******************************************************************************/
 /* art_clear_rom_data_vars()                                                  */
 /******************************************************************************/
 int art_clear_rom_data_vars()
 {
-  unsigned long k;
+  unsigned long num_bytes;
 
   /* rom data buffers */
-  for (k = 0; k < VDP_NAMETABLE_SIZE; k++)
-    G_art_nametable[k] = 0;
+  mem_clear(G_art_nametable, VDP_NAMETABLE_SIZE * sizeof(unsigned short));
+  mem_clear(G_art_pals, VDP_ROM_PALS_SIZE * sizeof(unsigned short));
+  mem_clear(G_art_metasprites, ART_META_BUFFER_SIZE * sizeof(unsigned short));
+  mem_clear(G_art_angles, ART_ANGLE_BUFFER_SIZE * sizeof(unsigned short));
+
+  mem_clear(S_art_entry_pals, VDP_MAX_ENTRIES * ART_MAX_PALS_PER_ENTRY * sizeof(unsigned short));
+  mem_clear(S_art_entry_num_pals, VDP_MAX_ENTRIES * sizeof(unsigned short));
+
+  /* the cells are built in the rom itself */
+  G_art_cells = rom_reserve_tail(ART_CELLS_ROM_OFFSET, &num_bytes);
 
-  for (k = 0; k < VDP_ROM_PALS_SIZE; k++)
-    G_art_pals[k] = 0;
+  S_art_max_cells = num_bytes / VDP_BYTES_PER_CELL;
 
-  for (k = 0; k < VDP_ROM_CELLS_SIZE; k++)
-    G_art_cells[k] = 0;
+  if (S_art_max_cells > VDP_ROM_MAX_CELLS)
+    S_art_max_cells = VDP_ROM_MAX_CELLS;
 
   G_art_num_entries = 0;
   G_art_num_pals = 0;
   G_art_num_cells = 0;
+  G_art_num_meta_words = 0;
+  G_art_num_angle_words = 0;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_clear_bg_data_vars()                                                   */
+/******************************************************************************/
+int art_clear_bg_data_vars()
+{
+  /* background data buffers */
+  mem_clear(G_art_bg_pals, VDP_ROM_PALS_SIZE * sizeof(unsigned short));
+  mem_clear(G_art_tiles, VDP_TILES_SIZE * sizeof(unsigned char));
+  mem_clear(G_art_tilemaps, ART_TILEMAP_BUFFER_SIZE * sizeof(unsigned short));
+  mem_clear(S_art_tile_hash, ART_TILE_HASH_SIZE * sizeof(unsigned short));
+
+  G_art_bg_num_pals = 0;
+  G_art_num_tiles = 0;
+  G_art_num_backgrounds = 0;
+  G_art_num_tilemap_words = 0;
 
   return 0;
 }
@@ -153,30 +574,47 @@ int art_clear_image_vars()
 
   S_art_frame_rows = 0;
   S_art_frame_columns = 0;
+  S_art_origin_row = 0;
+  S_art_origin_column = 0;
   S_art_num_frames = 0;
+  S_art_num_stored_frames = 0;
   S_art_anim_ticks = 0;
   S_art_anim_flags = 0x0000;
 
+  S_art_num_angles = 0;
+  S_art_num_stored_angles = 0;
+
+  for (k = 0; k < ART_MAX_ANGLES; k++)
+    S_art_angle_map[k] = 0;
+
+  S_art_angle_flips = 0x00;
+  S_art_angle_addr = 0;
+
   S_art_pal_index = 0;
+  S_art_cell_depth = VDP_CELL_DEPTH_4BPP;
   S_art_cells_addr = 0;
   S_art_cells_size = 0;
 
-  /* image buffers */
-  for (k = 0; k < ART_MAX_PIXELS_PER_FRAME; k++)
+  /* image buffers (these are large enough for a whole sheet, */
+  /* or a full angle set, so we only clear the part last used) */
+  for (k = 0; k < S_art_lzw_image_size; k++)
     S_art_lzw_image_buf[k] = 0;
 
   S_art_lzw_image_size = 0;
 
-  for (k = 0; k < ART_MAX_PIXELS_PER_FRAME; k++)
+  for (k = 0; k < S_art_decomp_image_size; k++)
     S_art_decomp_image_buf[k] = 0;
 
   S_art_decomp_image_size = 0;
 
-  for (k = 0; k < ART_PIXELS_BUFFER_SIZE; k++)
+  for (k = 0; k < S_art_pixels_size; k++)
     S_art_pixels_buf[k] = 0;
 
   S_art_pixels_size = 0;
 
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
+
   return 0;
 }
 
@@ -279,6 +717,22 @@ int art_gif_logical_screen_descriptor()
   if (fread(buf, sizeof(unsigned char), 2, S_art_fp) < 2)
     return 1;
 
+  /* sheets are checked against their grid when they are sliced */
+  /* (backgrounds are decoded the same way, but can be larger)   */
+  if (S_art_frames_buf != S_art_pixels_buf)
+  {
+    if ((S_art_image_w == 0) || (S_art_image_h == 0))
+      return 1;
+
+    if ((unsigned long) S_art_image_w * S_art_image_h > 
+        ((S_art_gif_flags & ART_GIF_FLAG_BACKGROUND) ? ART_MAX_IMAGE_PIXELS : ART_MAX_SHEET_PIXELS))
+    {
+      return 1;
+    }
+
+    return 0;
+  }
+
   /* check that image width and height are valid */
   if ((S_art_image_w % VDP_CELL_W_H) != 0)
     return 1;
@@ -608,7 +1062,7 @@ int art_gif_image_data()
     /* sub-block */
     if (c > 0)
     {
-      if ((S_art_lzw_image_size + c) > ART_MAX_PIXELS_PER_FRAME)
+      if ((S_art_lzw_image_size + c) > ART_MAX_IMAGE_PIXELS)
         return 1;
 
       if (fread(&S_art_lzw_image_buf[S_art_lzw_image_size], sizeof(unsigned char), c, S_art_fp) < c)
@@ -624,6 +1078,40 @@ int art_gif_image_data()
   return 0;
 }
 
+/******************************************************************************/
+/* art_gif_skip_image_data()                                                  */
+/******************************************************************************/
+int art_gif_skip_image_data()
+{
+  unsigned char c;
+
+  if (S_art_fp == NULL)
+    return 1;
+
+  /* skip lzw minimum code size */
+  if (fread(&c, sizeof(unsigned char), 1, S_art_fp) < 1)
+    return 1;
+
+  /* skip sub-blocks */
+  while (1)
+  {
+    if (fread(&c, sizeof(unsigned char), 1, S_art_fp) < 1)
+      return 1;
+
+    /* sub-block */
+    if (c > 0)
+    {
+      if (fseek(S_art_fp, c, SEEK_CUR))
+        return 1;
+    }
+    /* block terminator */
+    else
+      break;
+  }
+
+  return 0;
+}
+
 /******************************************************************************/
 /* art_gif_init_dictionary()                                                  */
 /******************************************************************************/
@@ -660,8 +1148,8 @@ int art_gif_decompress_image()
   unsigned long k;
 
   unsigned short dict_index;
-  unsigned short lzw_index;
-  unsigned short decomp_index;
+  unsigned long  lzw_index;
+  unsigned long  decomp_index;
 
   unsigned short bit;
   unsigned short mask;
@@ -669,9 +1157,15 @@ int art_gif_decompress_image()
   unsigned short code;
   unsigned short prev;
 
+  unsigned long  num_codes;
+  unsigned long  num_clear_codes;
+
   /* initialize the dictionary */
   art_gif_init_dictionary();
 
+  num_codes = 0;
+  num_clear_codes = 0;
+
   /* start decompressing! */
   lzw_index = 0;
   bit = 0;
@@ -709,10 +1203,13 @@ int art_gif_decompress_image()
       bit = bit % 8;
     }
 
+    num_codes += 1;
+
     /* clear code */
     if (code == S_art_lzw_num_roots)
     {
       art_gif_init_dictionary();
+      num_clear_codes += 1;
       continue;
     }
     /* end of stream */
@@ -735,7 +1232,7 @@ int art_gif_decompress_image()
         /* output the string for the current code */
         if (code < S_art_lzw_num_roots)
         {
-          if ((S_art_decomp_image_size + 1) > ART_MAX_PIXELS_PER_FRAME)
+          if ((S_art_decomp_image_size + 1) > ART_MAX_IMAGE_PIXELS)
             return 1;
 
           S_art_decomp_image_buf[decomp_index] = S_art_lzw_dict[2 * code + 0];
@@ -743,7 +1240,7 @@ int art_gif_decompress_image()
         }
         else
         {
-          if ((S_art_decomp_image_size + 2) > ART_MAX_PIXELS_PER_FRAME)
+          if ((S_art_decomp_image_size + 2) > ART_MAX_IMAGE_PIXELS)
             return 1;
 
           S_art_decomp_image_buf[decomp_index + 0] = S_art_lzw_dict[2 * code + 0];
@@ -764,7 +1261,7 @@ int art_gif_decompress_image()
 
         /* output the string for the previous code, */
         /* concatenated with its first character    */
-        if ((S_art_decomp_image_size + 2) > ART_MAX_PIXELS_PER_FRAME)
+        if ((S_art_decomp_image_size + 2) > ART_MAX_IMAGE_PIXELS)
           return 1;
 
         S_art_decomp_image_buf[decomp_index + 0] = prev;
@@ -796,7 +1293,7 @@ int art_gif_decompress_image()
       {
         dict_index = S_art_decomp_image_buf[decomp_index];
 
-        if ((S_art_decomp_image_size + 1) > ART_MAX_PIXELS_PER_FRAME)
+        if ((S_art_decomp_image_size + 1) > ART_MAX_IMAGE_PIXELS)
           return 1;
 
         S_art_decomp_image_size += 1;
@@ -810,6 +1307,9 @@ int art_gif_decompress_image()
     }
   }
 
+  STATS_COUNT(STATS_COUNT_LZW_CODES, num_codes);
+  STATS_COUNT(STATS_COUNT_CLEAR_CODES, num_clear_codes);
+
   return 0;
 }
 
@@ -820,31 +1320,33 @@ int art_gif_copy_image_to_pixels()
 {
   unsigned long k;
 
-  unsigned short pixel_addr;
-  unsigned short pixel_offset;
+  unsigned long  pixel_addr;
+  unsigned long  pixel_offset;
 
-  unsigned short last_addr;
+  unsigned long  last_addr;
 
   /* create space for this frame */
-  S_art_pixels_size += S_art_image_w * S_art_image_h;
+  pixel_addr = S_art_angle_addr + S_art_num_frames * (S_art_image_w * S_art_image_h);
 
-  if (S_art_pixels_size > ART_PIXELS_BUFFER_SIZE)
+  if (pixel_addr + (S_art_image_w * S_art_image_h) > S_art_frames_buf_size)
     return 1;
 
+  if (S_art_frames_buf == S_art_pixels_buf)
+    S_art_pixels_size = pixel_addr + (S_art_image_w * S_art_image_h);
+
   /* clear 1st frame, or copy the last frame to this one */
-  pixel_addr = S_art_num_frames * (S_art_image_w * S_art_image_h);
 
   if (S_art_num_frames == 0)
   {
     for (k = 0; k < (S_art_image_w * S_art_image_h); k++)
-      S_art_pixels_buf[pixel_addr + k] = 0;
+      S_art_frames_buf[pixel_addr + k] = 0;
   }
   else
   {
     last_addr = pixel_addr - (S_art_image_w * S_art_image_h);
 
     for (k = 0; k < (S_art_image_w * S_art_image_h); k++)
-      S_art_pixels_buf[pixel_addr + k] = S_art_pixels_buf[last_addr + k];
+      S_art_frames_buf[pixel_addr + k] = S_art_frames_buf[last_addr + k];
   }
 
   /* copy decompressed pixels to this frame */
@@ -856,11 +1358,13 @@ int art_gif_copy_image_to_pixels()
     pixel_offset += k % S_art_gif_sub_w;
     pixel_offset += (k / S_art_gif_sub_w) * S_art_image_w;
     
-    S_art_pixels_buf[pixel_addr + pixel_offset] = S_art_decomp_image_buf[k];
+    S_art_frames_buf[pixel_addr + pixel_offset] = S_art_decomp_image_buf[k];
   }
 
   S_art_num_frames += 1;
 
+  STATS_COUNT(STATS_COUNT_PIXELS, S_art_image_w * S_art_image_h);
+
   return 0;
 }
 
@@ -872,8 +1376,8 @@ int art_check_for_ping_pong_animation()
   unsigned short k;
   unsigned short m;
 
-  unsigned short pixel_addr_1;
-  unsigned short pixel_addr_2;
+  unsigned long  pixel_addr_1;
+  unsigned long  pixel_addr_2;
 
   /* check number of frames first */
   if (S_art_num_frames > (2 * (ART_MAX_NUM_FRAMES - 1)))
@@ -885,8 +1389,8 @@ int art_check_for_ping_pong_animation()
   /* compare potential ping-pong frames */
   for (k = 1; k < S_art_num_frames / 2; k++)
   {
-    pixel_addr_1 = k * (S_art_image_w * S_art_image_h);
-    pixel_addr_2 = (S_art_num_frames - k) * (S_art_image_w * S_art_image_h);
+    pixel_addr_1 = S_art_angle_addr + k * (S_art_image_w * S_art_image_h);
+    pixel_addr_2 = S_art_angle_addr + (S_art_num_frames - k) * (S_art_image_w * S_art_image_h);
 
     for (m = 0; m < (S_art_image_w * S_art_image_h); m++)
     {
@@ -903,288 +1407,2560 @@ int art_check_for_ping_pong_animation()
 }
 
 /******************************************************************************/
-/* art_add_entry()                                                            */
+/* art_compare_angles()                                                       */
 /******************************************************************************/
-int art_add_entry()
+int art_compare_angles(unsigned short angle_1, unsigned short angle_2, unsigned char flips)
 {
-  unsigned short val;
-
-  if (G_art_num_entries >= VDP_MAX_ENTRIES)
-    return 1;
-
-  /* word 1: dimensions, number of frames & angles, animation info */
-  val =  ((S_art_frame_columns - 1) << 13) & 0x6000;
-  val |= ((S_art_frame_rows - 1) << 11) & 0x1800;
-  val |= ((S_art_num_frames - 1) << 8) & 0x0700;
-#if 0
-  val |= (S_art_num_angles << 6) & 0x00C0;
-#endif
-  val |= (S_art_anim_flags << 4) & 0x0030;
-  val |= (S_art_anim_ticks / 2) & 0x000F;
-
-  G_art_nametable[VDP_ENTRY_SIZE * G_art_num_entries + 0] = val;
+  unsigned long k;
+  unsigned long m;
 
-  /* word 2: number of palettes, palette number */
-#if 0
-  val = ((S_art_num_pals - 1) << 12) & 0x7000;
-#endif
-  val = S_art_pal_index & 0x00FF;
+  unsigned short x;
+  unsigned short y;
 
-  G_art_nametable[VDP_ENTRY_SIZE * G_art_num_entries + 1] = val;
+  unsigned long  angle_size;
 
-  /* word 3: cells array address (upper 6 bits), data size (upper 6 bits) */
-  val =  (S_art_cells_addr >> 8) & 0x3F00;
-  val |= (S_art_cells_size >> 16) & 0x003F;
+  unsigned long  pixel_addr_1;
+  unsigned long  pixel_addr_2;
 
-  G_art_nametable[VDP_ENTRY_SIZE * G_art_num_entries + 2] = val;
+  /* returns 0 if angle 1 matches angle 2 with the given flips */
+  angle_size = S_art_num_frames * (S_art_image_w * S_art_image_h);
 
-  /* word 4: cells array address (lower 16 bits) */
-  val = S_art_cells_addr & 0xFFFF;
+  for (k = 0; k < S_art_num_frames; k++)
+  {
+    pixel_addr_1 = angle_1 * angle_size + k * (S_art_image_w * S_art_image_h);
+    pixel_addr_2 = angle_2 * angle_size + k * (S_art_image_w * S_art_image_h);
 
-  G_art_nametable[VDP_ENTRY_SIZE * G_art_num_entries + 3] = val;
+    for (m = 0; m < (unsigned long) (S_art_image_w * S_art_image_h); m++)
+    {
+      x = m % S_art_image_w;
+      y = m / S_art_image_w;
 
-  /* word 5: data size (lower 16 bits) */
-  val = S_art_cells_size & 0xFFFF;
+      if (flips & ART_ANGLE_FLIP_H)
+        x = S_art_image_w - 1 - x;
 
-  G_art_nametable[VDP_ENTRY_SIZE * G_art_num_entries + 4] = val;
+      if (flips & ART_ANGLE_FLIP_V)
+        y = S_art_image_h - 1 - y;
 
-  G_art_num_entries += 1;
+      if (S_art_pixels_buf[pixel_addr_1 + m] != S_art_pixels_buf[pixel_addr_2 + (y * S_art_image_w) + x])
+        return 1;
+    }
+  }
 
   return 0;
 }
 
 /******************************************************************************/
-/* art_add_palette()                                                          */
+/* art_find_mirrored_angles()                                                 */
 /******************************************************************************/
-int art_add_palette()
+int art_find_mirrored_angles()
 {
   unsigned short k;
+  unsigned short m;
+  unsigned short n;
 
-  if (G_art_num_pals >= VDP_ROM_MAX_PALS)
-    return 1;
+  unsigned long  angle_size;
 
-  S_art_pal_index = G_art_num_pals;
+  unsigned char  flips[4];
 
-  /* add the new palette */
-  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
-    G_art_pals[G_art_num_pals * VDP_COLORS_PER_PAL + k] = S_art_gif_colors[k];
+  flips[0] = 0x00;
+  flips[1] = ART_ANGLE_FLIP_H;
+  flips[2] = ART_ANGLE_FLIP_V;
+  flips[3] = ART_ANGLE_FLIP_H | ART_ANGLE_FLIP_V;
 
-  G_art_num_pals += 1;
+  angle_size = S_art_num_frames * (S_art_image_w * S_art_image_h);
+
+  S_art_num_stored_angles = 0;
+  S_art_angle_flips = 0x00;
+
+  /* each angle is either a (flipped) copy of an angle that was */
+  /* already stored, or it is moved down to be stored itself    */
+  for (k = 0; k < S_art_num_angles; k++)
+  {
+    for (m = 0; m < S_art_num_stored_angles; m++)
+    {
+      for (n = 0; n < 4; n++)
+      {
+        if (!art_compare_angles(k, m, flips[n]))
+          break;
+      }
+
+      if (n < 4)
+        break;
+    }
+
+    if (m < S_art_num_stored_angles)
+    {
+      S_art_angle_map[k] = m | flips[n];
+      S_art_angle_flips |= flips[n];
+    }
+    else
+    {
+      if (S_art_num_stored_angles < k)
+      {
+        memmove(&S_art_pixels_buf[S_art_num_stored_angles * angle_size], 
+                &S_art_pixels_buf[k * angle_size], 
+                angle_size);
+      }
+
+      S_art_angle_map[k] = S_art_num_stored_angles;
+      S_art_num_stored_angles += 1;
+    }
+  }
+
+  if (S_art_num_stored_angles < S_art_num_angles)
+    printf("Mirrored Angles: %d\n", S_art_num_angles - S_art_num_stored_angles);
+
+  S_art_num_stored_frames = S_art_num_stored_angles * S_art_num_frames;
+  S_art_pixels_size = S_art_num_stored_angles * angle_size;
 
   return 0;
 }
 
 /******************************************************************************/
-/* art_add_cells()                                                            */
+/* art_trim_frames()                                                          */
 /******************************************************************************/
-int art_add_cells()
+int art_trim_frames()
 {
   unsigned long k;
   unsigned long m;
   unsigned long n;
 
-  unsigned short frame_cells;
-
-  unsigned long  cell_addr;
-  unsigned long  cell_offset;
-
-  unsigned short pixel_addr;
-  unsigned short pixel_offset;
+  unsigned short row;
+  unsigned short column;
 
-  unsigned char val;
+  unsigned short min_row;
+  unsigned short max_row;
+  unsigned short min_column;
+  unsigned short max_column;
 
-  /* determine how many cells are to be created */
-  frame_cells = S_art_frame_rows * S_art_frame_columns;
+  unsigned long  pixel_addr;
+  unsigned long  pixel_offset;
 
-  if (G_art_num_cells + (S_art_num_frames * frame_cells) > VDP_ROM_MAX_CELLS)
-    return 1;
+  unsigned long  old_cells;
+  unsigned long  new_cells;
 
-  S_art_cells_addr = G_art_num_cells;
-  S_art_cells_size = S_art_num_frames * frame_cells;
+  /* find the bounding box of the opaque cells over all frames */
+  min_row = S_art_frame_rows;
+  max_row = 0;
+  min_column = S_art_frame_columns;
+  max_column = 0;
 
-  /* create cells */
-  for (k = 0; k < S_art_num_frames; k++)
+  for (k = 0; k < S_art_num_stored_frames; k++)
   {
-    for (m = 0; m < frame_cells; m++)
+    for (m = 0; m < (unsigned long) (S_art_frame_rows * S_art_frame_columns); m++)
     {
-      /* determine cell & pixel addresses */
-      cell_addr = VDP_BYTES_PER_CELL * G_art_num_cells;
-      cell_addr += VDP_BYTES_PER_CELL * ((k * frame_cells) + m);
+      row = m / S_art_frame_columns;
+      column = m % S_art_frame_columns;
 
       pixel_addr = k * (S_art_image_w * S_art_image_h);
-      pixel_addr += VDP_CELL_W_H * S_art_image_w * (m / S_art_frame_columns);
-      pixel_addr += VDP_CELL_W_H * (m % S_art_frame_columns);
+      pixel_addr += VDP_CELL_W_H * S_art_image_w * row;
+      pixel_addr += VDP_CELL_W_H * column;
 
+      /* color 0 is transparent */
       for (n = 0; n < VDP_PIXELS_PER_CELL; n++)
       {
-        /* determine cell & pixel offsets */
-        cell_offset = n / 2;
-
         pixel_offset = S_art_image_w * (n / VDP_CELL_W_H);
         pixel_offset += n % VDP_CELL_W_H;
 
-        /* obtain pixel value */
-        val = S_art_pixels_buf[pixel_addr + pixel_offset];
-
-        /* write this pixel value to the cells buffer */
-        if (n % 2 == 0)
-        {
-          G_art_cells[cell_addr + cell_offset] &= 0x0F;
-          G_art_cells[cell_addr + cell_offset] |= (val << 4) & 0xF0;
-        }
-        else
-        {
-          G_art_cells[cell_addr + cell_offset] &= 0xF0;
-          G_art_cells[cell_addr + cell_offset] |= val & 0x0F;
-        }
+        if (S_art_pixels_buf[pixel_addr + pixel_offset] != 0)
+          break;
       }
+
+      if (n == VDP_PIXELS_PER_CELL)
+        continue;
+
+      if (row < min_row)
+        min_row = row;
+
+      if (row > max_row)
+        max_row = row;
+
+      if (column < min_column)
+        min_column = column;
+
+      if (column > max_column)
+        max_column = column;
     }
   }
 
-  G_art_num_cells += S_art_num_frames * frame_cells;
+  /* if the sprite is fully transparent, just keep one cell */
+  if (min_row > max_row)
+  {
+    min_row = 0;
+    max_row = 0;
+    min_column = 0;
+    max_column = 0;
+  }
+
+  /* if any angles are flipped copies of others, center the box */
+  /* so that flipping it matches flipping the untrimmed frames   */
+  if ((S_art_angle_flips & ART_ANGLE_FLIP_H) && (min_column > S_art_frame_columns - 1 - max_column))
+    min_column = S_art_frame_columns - 1 - max_column;
+
+  if (S_art_angle_flips & ART_ANGLE_FLIP_H)
+    max_column = S_art_frame_columns - 1 - min_column;
+
+  if ((S_art_angle_flips & ART_ANGLE_FLIP_V) && (min_row > S_art_frame_rows - 1 - max_row))
+    min_row = S_art_frame_rows - 1 - max_row;
+
+  if (S_art_angle_flips & ART_ANGLE_FLIP_V)
+    max_row = S_art_frame_rows - 1 - min_row;
+
+  /* shrink the frames down to the bounding box */
+  old_cells = S_art_num_stored_frames * (S_art_frame_rows * S_art_frame_columns);
+
+  S_art_origin_row = min_row;
+  S_art_origin_column = min_column;
+
+  S_art_frame_rows = max_row - min_row + 1;
+  S_art_frame_columns = max_column - min_column + 1;
+
+  new_cells = S_art_num_stored_frames * (S_art_frame_rows * S_art_frame_columns);
+
+  printf("Trimmed Cells Saved: %lu\n", old_cells - new_cells);
 
   return 0;
 }
 
 /******************************************************************************/
-/* art_load_gif()                                                             */
+/* art_add_entry()                                                            */
 /******************************************************************************/
-int art_load_gif(char* filename)
+int art_add_entry()
+{
+  unsigned short val;
+
+  unsigned short angle_bits;
+
+  if (G_art_num_entries >= VDP_MAX_ENTRIES)
+    return 1;
+
+  /* the number of angles is stored as a power of 2 */
+  angle_bits = 0;
+
+  while ((1 << angle_bits) < S_art_num_angles)
+    angle_bits += 1;
+
+  /* word 1: dimensions, number of frames & angles, animation info */
+  val =  ((S_art_frame_columns - 1) << 13) & 0x6000;
+  val |= ((S_art_frame_rows - 1) << 11) & 0x1800;
+  val |= ((S_art_num_frames - 1) << 8) & 0x0700;
+  val |= (angle_bits << 6) & 0x00C0;
+  val |= (S_art_anim_flags << 4) & 0x0030;
+  val |= (S_art_anim_ticks / 2) & 0x000F;
+
+  if (G_art_options & ART_OPTION_TRIM)
+    val |= VDP_ENTRY_FLAG_ORIGIN;
+
+  G_art_nametable[ART_ENTRY_SIZE * G_art_num_entries + 0] = val;
+
+  /* word 2: number of palettes, cell depth, palette number */
+  /* (the palettes are filled in when the rom is written)    */
+  val =  (S_art_cell_depth << 8) & 0x0300;
+  val |= S_art_pal_index & 0x00FF;
+
+  S_art_entry_pals[ART_MAX_PALS_PER_ENTRY * G_art_num_entries] = S_art_pal_index;
+  S_art_entry_num_pals[G_art_num_entries] = 1;
+
+  G_art_nametable[ART_ENTRY_SIZE * G_art_num_entries + 1] = val;
+
+  /* word 3: cells array address (upper 6 bits), data size (upper 6 bits) */
+  val =  (S_art_cells_addr >> 8) & 0x3F00;
+  val |= (S_art_cells_size >> 16) & 0x003F;
+
+  G_art_nametable[ART_ENTRY_SIZE * G_art_num_entries + 2] = val;
+
+  /* word 4: cells array address (lower 16 bits) */
+  val = S_art_cells_addr & 0xFFFF;
+
+  G_art_nametable[ART_ENTRY_SIZE * G_art_num_entries + 3] = val;
+
+  /* word 5: data size (lower 16 bits) */
+  val = S_art_cells_size & 0xFFFF;
+
+  G_art_nametable[ART_ENTRY_SIZE * G_art_num_entries + 4] = val;
+
+  /* word 6 (trimmed only): origin offset in cells (column, row) */
+  if (G_art_options & ART_OPTION_TRIM)
+  {
+    val =  (S_art_origin_column << 8) & 0xFF00;
+    val |= S_art_origin_row & 0x00FF;
+
+    G_art_nametable[ART_ENTRY_SIZE * G_art_num_entries + 5] = val;
+  }
+
+  G_art_num_entries += 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_add_angle_map()                                                        */
+/******************************************************************************/
+int art_add_angle_map()
+{
+  unsigned short k;
+
+  unsigned short val;
+
+  if (G_art_num_entries >= VDP_MAX_ENTRIES)
+    return 1;
+
+  /* single angle sprites have no map */
+  if (S_art_num_angles < 2)
+  {
+    G_art_angles[G_art_num_entries] = 0xFFFF;
+    return 0;
+  }
+
+  if ((G_art_num_angle_words + (S_art_num_angles / 2)) > ART_ANGLE_MAX_MAP_WORDS)
+    return 1;
+
+  /* the map for this entry starts here */
+  G_art_angles[G_art_num_entries] = G_art_num_angle_words;
+
+  /* each word: 2 angles (flip flags, stored angle index) */
+  for (k = 0; k < S_art_num_angles; k += 2)
+  {
+    val =  (S_art_angle_map[k + 0] << 8) & 0xFF00;
+    val |= S_art_angle_map[k + 1] & 0x00FF;
+
+    G_art_angles[VDP_MAX_ENTRIES + G_art_num_angle_words] = val;
+    G_art_num_angle_words += 1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_add_palette()                                                          */
+/******************************************************************************/
+int art_add_palette()
+{
+  unsigned short k;
+
+  if (G_art_num_pals >= VDP_ROM_MAX_PALS)
+    return 1;
+
+  S_art_pal_index = G_art_num_pals;
+
+  /* add the new palette */
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    G_art_pals[G_art_num_pals * VDP_COLORS_PER_PAL + k] = S_art_gif_colors[k];
+
+  G_art_num_pals += 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_pack_cell_2bpp()                                                       */
+/******************************************************************************/
+int art_pack_cell_2bpp(unsigned long cell_addr, unsigned long pixel_addr)
+{
+  unsigned long n;
+
+  unsigned long  cell_offset;
+  unsigned long  pixel_offset;
+
+  unsigned char shift;
+  unsigned char val;
+
+  for (n = 0; n < VDP_PIXELS_PER_CELL; n++)
+  {
+    /* determine cell & pixel offsets */
+    cell_offset = n / 4;
+
+    pixel_offset = S_art_image_w * (n / VDP_CELL_W_H);
+    pixel_offset += n % VDP_CELL_W_H;
+
+    /* obtain pixel value */
+    val = S_art_pixels_buf[pixel_addr + pixel_offset];
+
+    /* write this pixel value to the cells buffer */
+    shift = 2 * (3 - (n % 4));
+
+    G_art_cells[cell_addr + cell_offset] &= ~(0x03 << shift);
+    G_art_cells[cell_addr + cell_offset] |= (val & 0x03) << shift;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_pack_cell_4bpp()                                                       */
+/******************************************************************************/
+int art_pack_cell_4bpp(unsigned long cell_addr, unsigned long pixel_addr)
+{
+  unsigned long n;
+
+  unsigned long  cell_offset;
+  unsigned long  pixel_offset;
+
+  unsigned char val;
+
+  for (n = 0; n < VDP_PIXELS_PER_CELL; n++)
+  {
+    /* determine cell & pixel offsets */
+    cell_offset = n / 2;
+
+    pixel_offset = S_art_image_w * (n / VDP_CELL_W_H);
+    pixel_offset += n % VDP_CELL_W_H;
+
+    /* obtain pixel value */
+    val = S_art_pixels_buf[pixel_addr + pixel_offset];
+
+    /* write this pixel value to the cells buffer */
+    if (n % 2 == 0)
+    {
+      G_art_cells[cell_addr + cell_offset] &= 0x0F;
+      G_art_cells[cell_addr + cell_offset] |= (val << 4) & 0xF0;
+    }
+    else
+    {
+      G_art_cells[cell_addr + cell_offset] &= 0xF0;
+      G_art_cells[cell_addr + cell_offset] |= val & 0x0F;
+    }
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_pack_cell()                                                            */
+/******************************************************************************/
+int art_pack_cell(unsigned long cell_index, unsigned long pixel_addr)
+{
+  unsigned long cell_addr;
+
+  /* the cell index is relative to this sprite's cells address */
+  cell_addr = VDP_BYTES_PER_CELL * S_art_cells_addr;
+
+  if (S_art_cell_depth == VDP_CELL_DEPTH_2BPP)
+  {
+    cell_addr += VDP_BYTES_PER_CELL_2BPP * cell_index;
+    art_pack_cell_2bpp(cell_addr, pixel_addr);
+  }
+  else
+  {
+    cell_addr += VDP_BYTES_PER_CELL * cell_index;
+    art_pack_cell_4bpp(cell_addr, pixel_addr);
+  }
+
+  STATS_COUNT(STATS_COUNT_CELLS, 1);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_reduce_cell_depth()                                                    */
+/******************************************************************************/
+int art_reduce_cell_depth()
+{
+  unsigned long k;
+
+  unsigned short num_colors;
+  unsigned char  color_map[VDP_COLORS_PER_PAL];
+  unsigned char  used[VDP_COLORS_PER_PAL];
+
+  unsigned short pal_colors[VDP_COLORS_PER_PAL];
+
+  S_art_cell_depth = VDP_CELL_DEPTH_4BPP;
+
+  /* determine which colors are used (color 0 is always kept) */
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    used[k] = 0;
+
+  used[0] = 1;
+
+  for (k = 0; k < S_art_pixels_size; k++)
+  {
+    if (S_art_pixels_buf[k] >= VDP_COLORS_PER_PAL)
+      return 0;
+
+    used[S_art_pixels_buf[k]] = 1;
+  }
+
+  num_colors = 0;
+
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+  {
+    if (used[k])
+    {
+      color_map[k] = num_colors;
+      num_colors += 1;
+    }
+  }
+
+  if (num_colors > VDP_COLORS_PER_PAL_2BPP)
+    return 0;
+
+  /* move the used colors to the front of the palette */
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    pal_colors[k] = 0x0000;
+
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+  {
+    if (used[k])
+      pal_colors[color_map[k]] = S_art_gif_colors[k];
+  }
+
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    S_art_gif_colors[k] = pal_colors[k];
+
+  for (k = 0; k < S_art_pixels_size; k++)
+    S_art_pixels_buf[k] = color_map[S_art_pixels_buf[k]];
+
+  S_art_cell_depth = VDP_CELL_DEPTH_2BPP;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_add_cells()                                                            */
+/******************************************************************************/
+int art_add_cells()
+{
+  unsigned long k;
+  unsigned long m;
+
+  unsigned short frame_cells;
+
+  unsigned long  pixel_addr;
+
+  if (G_art_num_entries >= VDP_MAX_ENTRIES)
+    return 1;
+
+  /* determine how many cells are to be created */
+  frame_cells = S_art_frame_rows * S_art_frame_columns;
+
+  S_art_cells_addr = G_art_num_cells;
+  S_art_cells_size = S_art_num_stored_frames * frame_cells;
+
+  /* no piece list for this entry */
+  G_art_metasprites[G_art_num_entries] = 0xFFFF;
+
+  if (G_art_num_cells + ART_CELL_SLOTS(S_art_cells_size) > S_art_max_cells)
+    return 1;
+
+  rom_mark_used(&G_art_cells[VDP_BYTES_PER_CELL * (G_art_num_cells + ART_CELL_SLOTS(S_art_cells_size))]);
+
+  /* create cells */
+  for (k = 0; k < S_art_num_stored_frames; k++)
+  {
+    for (m = 0; m < frame_cells; m++)
+    {
+      /* determine pixel address */
+      pixel_addr = k * (S_art_image_w * S_art_image_h);
+      pixel_addr += VDP_CELL_W_H * S_art_image_w * (S_art_origin_row + (m / S_art_frame_columns));
+      pixel_addr += VDP_CELL_W_H * (S_art_origin_column + (m % S_art_frame_columns));
+
+      art_pack_cell((k * frame_cells) + m, pixel_addr);
+    }
+  }
+
+  G_art_num_cells += ART_CELL_SLOTS(S_art_cells_size);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_find_opaque_cells()                                                    */
+/******************************************************************************/
+int art_find_opaque_cells(unsigned short frame)
+{
+  unsigned long m;
+  unsigned long n;
+
+  unsigned long  pixel_addr;
+  unsigned long  pixel_offset;
+
+  for (m = 0; m < (unsigned long) (S_art_frame_rows * S_art_frame_columns); m++)
+  {
+    pixel_addr = frame * (S_art_image_w * S_art_image_h);
+    pixel_addr += VDP_CELL_W_H * S_art_image_w * (S_art_origin_row + (m / S_art_frame_columns));
+    pixel_addr += VDP_CELL_W_H * (S_art_origin_column + (m % S_art_frame_columns));
+
+    S_art_opaque_cells[m] = 0;
+
+    /* color 0 is transparent */
+    for (n = 0; n < VDP_PIXELS_PER_CELL; n++)
+    {
+      pixel_offset = S_art_image_w * (n / VDP_CELL_W_H);
+      pixel_offset += n % VDP_CELL_W_H;
+
+      if (S_art_pixels_buf[pixel_addr + pixel_offset] != 0)
+      {
+        S_art_opaque_cells[m] = 1;
+        break;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_cover_opaque_cells()                                                   */
+/******************************************************************************/
+int art_cover_opaque_cells(unsigned char tall_first)
+{
+  unsigned short k;
+  unsigned short m;
+
+  unsigned short row;
+  unsigned short column;
+
+  unsigned short w;
+  unsigned short h;
+
+  unsigned char  covered[ART_MAX_CELLS_PER_FRAME];
+
+  for (m = 0; m < S_art_frame_rows * S_art_frame_columns; m++)
+    covered[m] = 0;
+
+  S_art_num_pieces = 0;
+
+#define ART_CELL_IS_FREE(r, c)                                                 \
+  ( S_art_opaque_cells[(r) * S_art_frame_columns + (c)] &&                     \
+    !covered[(r) * S_art_frame_columns + (c)])
+
+  /* greedily cover the opaque cells with rectangles, */
+  /* starting from the first uncovered cell each time */
+  for (m = 0; m < S_art_frame_rows * S_art_frame_columns; m++)
+  {
+    row = m / S_art_frame_columns;
+    column = m % S_art_frame_columns;
+
+    if (!ART_CELL_IS_FREE(row, column))
+      continue;
+
+    w = 1;
+    h = 1;
+
+    if (tall_first)
+    {
+      while ( (h < ART_MAX_PIECE_ROWS) && 
+              (row + h < S_art_frame_rows) && 
+              ART_CELL_IS_FREE(row + h, column))
+      {
+        h += 1;
+      }
+
+      while ((w < ART_MAX_PIECE_COLUMNS) && (column + w < S_art_frame_columns))
+      {
+        for (k = 0; k < h; k++)
+        {
+          if (!ART_CELL_IS_FREE(row + k, column + w))
+            break;
+        }
+
+        if (k < h)
+          break;
+
+        w += 1;
+      }
+    }
+    else
+    {
+      while ( (w < ART_MAX_PIECE_COLUMNS) && 
+              (column + w < S_art_frame_columns) && 
+              ART_CELL_IS_FREE(row, column + w))
+      {
+        w += 1;
+      }
+
+      while ((h < ART_MAX_PIECE_ROWS) && (row + h < S_art_frame_rows))
+      {
+        for (k = 0; k < w; k++)
+        {
+          if (!ART_CELL_IS_FREE(row + h, column + k))
+            break;
+        }
+
+        if (k < w)
+          break;
+
+        h += 1;
+      }
+    }
+
+    /* add this piece */
+    S_art_piece_rows[S_art_num_pieces] = row;
+    S_art_piece_columns[S_art_num_pieces] = column;
+    S_art_piece_h[S_art_num_pieces] = h;
+    S_art_piece_w[S_art_num_pieces] = w;
+    S_art_num_pieces += 1;
+
+    for (k = 0; k < w * h; k++)
+      covered[(row + (k / w)) * S_art_frame_columns + column + (k % w)] = 1;
+  }
+
+#undef ART_CELL_IS_FREE
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_add_metasprite()                                                       */
+/******************************************************************************/
+int art_add_metasprite()
+{
+  unsigned long k;
+  unsigned long m;
+  unsigned long n;
+
+  unsigned short num_wide_pieces;
+
+  unsigned long  pixel_addr;
+  unsigned long  old_num_meta_words;
+
+  unsigned short val;
+
+  if (G_art_num_entries >= VDP_MAX_ENTRIES)
+    return 1;
+
+  if (G_art_num_meta_words >= ART_META_MAX_PIECE_WORDS)
+    return 1;
+
+  /* the piece list for this entry starts here */
+  old_num_meta_words = G_art_num_meta_words;
+
+  G_art_metasprites[G_art_num_entries] = G_art_num_meta_words & 0xFFFF;
+
+  S_art_cells_addr = G_art_num_cells;
+  S_art_cells_size = 0;
+
+  for (k = 0; k < S_art_num_stored_frames; k++)
+  {
+    art_find_opaque_cells(k);
+
+    /* cover the frame both ways, and keep whichever uses fewer pieces */
+    art_cover_opaque_cells(0);
+    num_wide_pieces = S_art_num_pieces;
+
+    art_cover_opaque_cells(1);
+
+    if (num_wide_pieces <= S_art_num_pieces)
+      art_cover_opaque_cells(0);
+
+    /* make sure there is space for the piece list */
+    if ((G_art_num_meta_words + 1 + (2 * S_art_num_pieces)) > ART_META_MAX_PIECE_WORDS)
+      goto nope;
+
+    /* word 1: number of pieces */
+    G_art_metasprites[VDP_MAX_ENTRIES + G_art_num_meta_words] = S_art_num_pieces;
+    G_art_num_meta_words += 1;
+
+    for (m = 0; m < S_art_num_pieces; m++)
+    {
+      if (G_art_num_cells + ART_CELL_SLOTS(S_art_cells_size + (S_art_piece_w[m] * S_art_piece_h[m])) > S_art_max_cells)
+        goto nope;
+
+      rom_mark_used(&G_art_cells[VDP_BYTES_PER_CELL * (G_art_num_cells + ART_CELL_SLOTS(S_art_cells_size + (S_art_piece_w[m] * S_art_piece_h[m])))]);
+
+      /* piece word 1: dimensions, offset from the origin in cells */
+      val =  ((S_art_piece_w[m] - 1) << 14) & 0xC000;
+      val |= ((S_art_piece_h[m] - 1) << 12) & 0x3000;
+      val |= (S_art_piece_columns[m] << 4) & 0x00F0;
+      val |= S_art_piece_rows[m] & 0x000F;
+
+      G_art_metasprites[VDP_MAX_ENTRIES + G_art_num_meta_words + 0] = val;
+
+      /* piece word 2: cell offset from the entry's cells address */
+      val = S_art_cells_size & 0xFFFF;
+
+      G_art_metasprites[VDP_MAX_ENTRIES + G_art_num_meta_words + 1] = val;
+
+      G_art_num_meta_words += 2;
+
+      /* create cells for this piece */
+      for (n = 0; n < (unsigned long) (S_art_piece_w[m] * S_art_piece_h[m]); n++)
+      {
+        pixel_addr = k * (S_art_image_w * S_art_image_h);
+        pixel_addr += VDP_CELL_W_H * S_art_image_w * (S_art_origin_row + S_art_piece_rows[m] + (n / S_art_piece_w[m]));
+        pixel_addr += VDP_CELL_W_H * (S_art_origin_column + S_art_piece_columns[m] + (n % S_art_piece_w[m]));
+
+        art_pack_cell(S_art_cells_size, pixel_addr);
+
+        S_art_cells_size += 1;
+      }
+    }
+  }
+
+  G_art_num_cells += ART_CELL_SLOTS(S_art_cells_size);
+
+  printf("Metasprite Cells: %lu\n", S_art_cells_size);
+
+  return 0;
+
+  /* take back the piece lists of a sprite that did not fit */
+nope:
+  for (k = old_num_meta_words; k < G_art_num_meta_words; k++)
+    G_art_metasprites[VDP_MAX_ENTRIES + k] = 0;
+
+  G_art_num_meta_words = old_num_meta_words;
+  G_art_metasprites[G_art_num_entries] = 0;
+
+  return 1;
+}
+
+/******************************************************************************/
+/* art_merge_palette_variant()                                                */
+/******************************************************************************/
+int art_merge_palette_variant()
+{
+  unsigned short k;
+  unsigned long  m;
+
+  unsigned short last;
+
+  unsigned short* entry;
+  unsigned short* last_entry;
+
+  unsigned long  cells_addr;
+  unsigned long  cells_size;
+
+  unsigned long  meta_start;
+  unsigned long  meta_end;
+  unsigned long  last_meta_start;
+
+  if (G_art_num_entries < 2)
+    return 0;
+
+  last = G_art_num_entries - 1;
+  last_entry = &G_art_nametable[ART_ENTRY_SIZE * last];
+
+  last_meta_start = G_art_metasprites[last];
+
+  /* look for an earlier entry with the same cells */
+  for (k = 0; k < last; k++)
+  {
+    entry = &G_art_nametable[ART_ENTRY_SIZE * k];
+
+    if (S_art_entry_num_pals[k] >= ART_MAX_PALS_PER_ENTRY)
+      continue;
+
+    /* compare dimensions, animation, depth, cells size and origin */
+    if (entry[0] != last_entry[0])
+      continue;
+
+    if ((entry[1] & 0x0300) != (last_entry[1] & 0x0300))
+      continue;
+
+    if (((entry[2] & 0x003F) != (last_entry[2] & 0x003F)) || (entry[4] != last_entry[4]))
+      continue;
+
+    if ((G_art_options & ART_OPTION_TRIM) && (entry[5] != last_entry[5]))
+      continue;
+
+    /* compare cells */
+    cells_addr = ((entry[2] & 0x3F00) << 8) | entry[3];
+    cells_size = ART_CELL_SLOTS(((entry[2] & 0x003F) << 16) | entry[4]);
+
+    if (memcmp( &G_art_cells[VDP_BYTES_PER_CELL * cells_addr], 
+                &G_art_cells[VDP_BYTES_PER_CELL * S_art_cells_addr], 
+                VDP_BYTES_PER_CELL * cells_size))
+    {
+      continue;
+    }
+
+    /* compare piece lists */
+    if (G_art_options & ART_OPTION_METASPRITES)
+    {
+      meta_start = G_art_metasprites[k];
+      meta_end = G_art_metasprites[k + 1];
+
+      if ((meta_end - meta_start) != (G_art_num_meta_words - last_meta_start))
+        continue;
+
+      for (m = 0; m < (meta_end - meta_start); m++)
+      {
+        if (G_art_metasprites[VDP_MAX_ENTRIES + meta_start + m] != 
+            G_art_metasprites[VDP_MAX_ENTRIES + last_meta_start + m])
+        {
+          break;
+        }
+      }
+
+      if (m < (meta_end - meta_start))
+        continue;
+    }
+
+    /* compare angle maps */
+    if (G_art_angles[k] != 0xFFFF)
+    {
+      for (m = 0; m < (unsigned long) ((1 << ((entry[0] >> 6) & 0x03)) / 2); m++)
+      {
+        if (G_art_angles[VDP_MAX_ENTRIES + G_art_angles[k] + m] != 
+            G_art_angles[VDP_MAX_ENTRIES + G_art_angles[last] + m])
+        {
+          break;
+        }
+      }
+
+      if (m < (unsigned long) ((1 << ((entry[0] >> 6) & 0x03)) / 2))
+        continue;
+    }
+
+    break;
+  }
+
+  if (k == last)
+    return 0;
+
+  printf("Palette Variant Of Entry: %d\n", k);
+
+  S_art_report_variant_of = k;
+
+  /* add this palette to the earlier entry */
+  S_art_entry_pals[ART_MAX_PALS_PER_ENTRY * k + S_art_entry_num_pals[k]] = S_art_pal_index;
+  S_art_entry_num_pals[k] += 1;
+
+  /* remove the cells, piece lists and entry that were just added */
+  for (m = VDP_BYTES_PER_CELL * S_art_cells_addr; m < VDP_BYTES_PER_CELL * G_art_num_cells; m++)
+    G_art_cells[m] = 0;
+
+  G_art_num_cells = S_art_cells_addr;
+
+  if (G_art_options & ART_OPTION_METASPRITES)
+  {
+    for (m = last_meta_start; m < G_art_num_meta_words; m++)
+      G_art_metasprites[VDP_MAX_ENTRIES + m] = 0;
+
+    G_art_num_meta_words = last_meta_start;
+    G_art_metasprites[last] = 0;
+  }
+
+  if (G_art_angles[last] != 0xFFFF)
+  {
+    for (m = G_art_angles[last]; m < G_art_num_angle_words; m++)
+      G_art_angles[VDP_MAX_ENTRIES + m] = 0;
+
+    G_art_num_angle_words = G_art_angles[last];
+  }
+
+  G_art_angles[last] = 0;
+
+  for (m = 0; m < ART_ENTRY_SIZE; m++)
+    last_entry[m] = 0;
+
+  S_art_entry_pals[ART_MAX_PALS_PER_ENTRY * last] = 0;
+  S_art_entry_num_pals[last] = 0;
+
+  G_art_num_entries -= 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_gif_parse_file()                                                       */
+/******************************************************************************/
+int art_gif_parse_file(char* filename)
 {
   unsigned char block_type;
   unsigned char ext_label;
 
+  /* open the file (or the gif in memory, if there is no filename) */
+  if (filename != NULL)
+    S_art_fp = fopen(filename, "rb");
+  else if (S_art_gif_data != NULL)
+    S_art_fp = fmemopen(S_art_gif_data, S_art_gif_data_size, "rb");
+  else
+    return 1;
+
+  if (S_art_fp == NULL)
+    return 1;
+
+  STATS_BEGIN(STATS_PHASE_PARSE);
+
+  /* start parsing the file */
+  if (art_gif_header())
+    goto nope;
+
+  if (art_gif_logical_screen_descriptor())
+    goto nope;
+
+  if ((S_art_gif_flags & ART_GIF_FLAG_GCT_EXISTS) && art_gif_color_table())
+    goto nope;
+
+  while (1)
+  {
+    if (fread(&block_type, sizeof(unsigned char), 1, S_art_fp) < 1)
+      goto nope;
+
+    /* extension */
+    if (block_type == 0x21)
+    {
+      if (fread(&ext_label, sizeof(unsigned char), 1, S_art_fp) < 1)
+        goto nope;
+
+      /* app extension */
+      if (ext_label == 0xFF)
+      {
+        if (art_gif_app_extension())
+          goto nope;
+      }
+      /* comment extension */
+      else if (ext_label == 0xFE)
+      {
+        if (art_gif_comment_extension())
+          goto nope;
+      }
+      /* plain text extension */
+      else if (ext_label == 0x01)
+      {
+        if (art_gif_plain_text_extension())
+          goto nope;
+      }
+      /* graphic control extension */
+      else if (ext_label == 0xF9)
+      {
+        if (art_gif_graphic_control_extension())
+          goto nope;
+      }
+    }
+    /* image descriptor */
+    else if (block_type == 0x2C)
+    {
+      if (art_gif_image_descriptor())
+        goto nope;
+
+      if ((S_art_gif_flags & ART_GIF_FLAG_LCT_EXISTS) && art_gif_color_table())
+        goto nope;
+
+      /* when estimating, just count the frames */
+      if (S_art_gif_flags & ART_GIF_FLAG_HEADER_ONLY)
+      {
+        if (art_gif_skip_image_data())
+          goto nope;
+
+        S_art_num_frames += 1;
+
+        continue;
+      }
+
+      if (art_gif_image_data())
+        goto nope;
+
+      STATS_BEGIN(STATS_PHASE_LZW);
+
+      if (art_gif_decompress_image())
+        goto nope;
+
+      STATS_END(STATS_PHASE_LZW);
+      STATS_BEGIN(STATS_PHASE_COMPOSITE);
+
+      if (art_gif_copy_image_to_pixels())
+        goto nope;
+
+      STATS_END(STATS_PHASE_COMPOSITE);
+    }
+    /* trailer */
+    else if (block_type == 0x3B)
+      break;
+  }
+
+  STATS_COUNT(STATS_COUNT_FILES, 1);
+  STATS_COUNT(STATS_COUNT_BYTES_READ, ftell(S_art_fp));
+
+  /* close the file */
+  fclose(S_art_fp);
+  S_art_fp = NULL;
+
+  STATS_END(STATS_PHASE_PARSE);
+
+  goto ok;
+
+nope:
+  fclose(S_art_fp);
+  S_art_fp = NULL;
+
+  STATS_END(STATS_PHASE_PARSE);
+
+  return 1;
+
+ok:
+  return 0;
+}
+
+/******************************************************************************/
+/* art_cache_save()                                                           */
+/******************************************************************************/
+int art_cache_save()
+{
+  unsigned short k;
+
+  unsigned short header[ART_CACHE_HEADER_WORDS];
+  unsigned long  frames_size;
+
+  /* the decoded frames of the current angle are stored, so that */
+  /* trimming and the other sprite options still apply on a hit  */
+  frames_size = S_art_num_frames * (S_art_image_w * S_art_image_h);
+
+  if (ART_CACHE_HEADER_BYTES + frames_size > ART_CACHE_BUFFER_SIZE)
+    return 1;
+
+  header[0] = S_art_image_w;
+  header[1] = S_art_image_h;
+  header[2] = S_art_num_frames;
+  header[3] = S_art_anim_ticks;
+  header[4] = S_art_anim_flags;
+
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    header[5 + k] = S_art_gif_colors[k];
+
+  memcpy(S_art_cache_buf, header, ART_CACHE_HEADER_BYTES);
+  memcpy(&S_art_cache_buf[ART_CACHE_HEADER_BYTES], &S_art_pixels_buf[S_art_angle_addr], frames_size);
+
+  if (cache_store(S_art_cache_buf, ART_CACHE_HEADER_BYTES + frames_size))
+    return 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_cache_restore()                                                        */
+/******************************************************************************/
+int art_cache_restore()
+{
+  unsigned short k;
+
+  unsigned short header[ART_CACHE_HEADER_WORDS];
+  unsigned long  frames_size;
+
+  if ((G_cache_record == NULL) || (G_cache_record_size < ART_CACHE_HEADER_BYTES))
+    return 1;
+
+  memcpy(header, G_cache_record, ART_CACHE_HEADER_BYTES);
+
+  /* check that image width, height, and frames are valid */
+  if ((header[0] == 0) || ((header[0] % VDP_CELL_W_H) != 0))
+    return 1;
+
+  if ((header[1] == 0) || ((header[1] % VDP_CELL_W_H) != 0))
+    return 1;
+
+  if ((header[0] / VDP_CELL_W_H > ART_MAX_FRAME_COLUMNS) || (header[1] / VDP_CELL_W_H > ART_MAX_FRAME_ROWS))
+    return 1;
+
+  if ((header[2] == 0) || (header[2] > ART_MAX_NUM_FRAMES))
+    return 1;
+
+  frames_size = header[2] * ((unsigned long) header[0] * header[1]);
+
+  if (G_cache_record_size != ART_CACHE_HEADER_BYTES + frames_size)
+    return 1;
+
+  if (S_art_angle_addr + frames_size > S_art_pixels_buf_size)
+    return 1;
+
+  /* restore the image */
+  S_art_image_w = header[0];
+  S_art_image_h = header[1];
+
+  S_art_frame_rows = S_art_image_h / VDP_CELL_W_H;
+  S_art_frame_columns = S_art_image_w / VDP_CELL_W_H;
+
+  S_art_num_frames = header[2];
+  S_art_anim_ticks = header[3];
+  S_art_anim_flags = header[4];
+
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    S_art_gif_colors[k] = header[5 + k];
+
+  memcpy(&S_art_pixels_buf[S_art_angle_addr], &G_cache_record[ART_CACHE_HEADER_BYTES], frames_size);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_decode_gif()                                                           */
+/******************************************************************************/
+int art_decode_gif(char* filename)
+{
+  unsigned short k;
+
+  unsigned short image_w;
+  unsigned short image_h;
+  unsigned short num_frames;
+  unsigned short anim_ticks;
+  unsigned short anim_flags;
+
+  unsigned short pal_colors[VDP_COLORS_PER_PAL];
+
+  /* make sure filename (or data) is valid */
+  if ((filename == NULL) && (S_art_gif_data == NULL))
+    return 1;
+
+  if (S_art_num_angles >= ART_MAX_ANGLES)
+    return 1;
+
+  /* save the settings from the 1st angle */
+  image_w = S_art_image_w;
+  image_h = S_art_image_h;
+  num_frames = S_art_num_frames;
+  anim_ticks = S_art_anim_ticks;
+  anim_flags = S_art_anim_flags;
+
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    pal_colors[k] = S_art_gif_colors[k];
+
+  /* reset file-related variables */
+  art_clear_gif_lzw_vars();
+
+  S_art_angle_addr = S_art_pixels_size;
+  S_art_num_frames = 0;
+  S_art_anim_ticks = 0;
+  S_art_anim_flags = 0x0000;
+
+  /* use the cached decode if this file was seen before */
+  if (!cache_find(filename))
+  {
+    if (art_cache_restore())
+      return 1;
+  }
+  else
+  {
+    if (art_gif_parse_file(filename))
+      return 1;
+
+    /* check for ping-pong animation */
+    STATS_BEGIN(STATS_PHASE_PING_PONG);
+
+    if (art_check_for_ping_pong_animation())
+      return 1;
+
+    STATS_END(STATS_PHASE_PING_PONG);
+
+    if ((S_art_num_frames > 0) && (S_art_num_frames <= ART_MAX_NUM_FRAMES))
+      art_cache_save();
+  }
+
+  /* check number of frames */
+  if ((S_art_num_frames == 0) || (S_art_num_frames > ART_MAX_NUM_FRAMES))
+    return 1;
+
+  S_art_pixels_size = S_art_angle_addr + S_art_num_frames * (S_art_image_w * S_art_image_h);
+
+  /* the other angles must match the 1st angle, and use its palette */
+  if (S_art_num_angles > 0)
+  {
+    if ((S_art_image_w != image_w) || (S_art_image_h != image_h))
+      return 1;
+
+    if ((S_art_num_frames != num_frames) || (S_art_anim_flags != anim_flags))
+      return 1;
+
+    /* the pixels are palette indices, so the colors must be the same */
+    for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    {
+      if (S_art_gif_colors[k] != pal_colors[k])
+      {
+        printf("Angle Palette Mismatch: %s\n", (filename != NULL) ? filename : "(memory)");
+        return 1;
+      }
+    }
+
+    S_art_anim_ticks = anim_ticks;
+  }
+
+  S_art_num_angles += 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_sprite_rom_bytes()                                                     */
+/******************************************************************************/
+unsigned long art_sprite_rom_bytes()
+{
+  unsigned long num_bytes;
+
+  /* the size of the sprite chunks, as written by art_add_chunks_to_rom() */
+  num_bytes = 2 * ART_ENTRY_SIZE * G_art_num_entries;
+  num_bytes += 2 * VDP_COLORS_PER_PAL * G_art_num_pals;
+  num_bytes += VDP_BYTES_PER_CELL * G_art_num_cells;
+
+  if (G_art_num_entries > 0)
+  {
+    num_bytes += 2 * (G_art_num_entries + G_art_num_meta_words);
+    num_bytes += 2 * (G_art_num_entries + G_art_num_angle_words);
+  }
+
+  return num_bytes;
+}
+
+/******************************************************************************/
+/* art_report_begin()                                                         */
+/******************************************************************************/
+int art_report_begin(char* source)
+{
+  /* leave room for a sheet slot number */
+  strncpy(S_art_report_source, source, ART_REPORT_SOURCE_SIZE - 8);
+  S_art_report_source[ART_REPORT_SOURCE_SIZE - 8] = '\0';
+
+  clock_gettime(CLOCK_MONOTONIC, &S_art_report_start);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_report_sprite()                                                        */
+/******************************************************************************/
+int art_report_sprite(unsigned short old_num_entries, unsigned long num_bytes)
+{
+  struct timespec t;
+  struct art_report_entry* r;
+
+  unsigned long decode_ns;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  decode_ns = (t.tv_sec - S_art_report_start.tv_sec) * 1000000000UL;
+  decode_ns += t.tv_nsec - S_art_report_start.tv_nsec;
+
+  /* a palette variant adds to the entry it was merged with */
+  if (G_art_num_entries == old_num_entries)
+  {
+    if (S_art_report_variant_of >= G_art_num_entries)
+      return 1;
+
+    r = &S_art_report[S_art_report_variant_of];
+
+    r->num_variants += 1;
+    r->decode_ns += decode_ns;
+    r->num_bytes += num_bytes;
+
+    return 0;
+  }
+
+  r = &S_art_report[G_art_num_entries - 1];
+
+  strcpy(r->source, S_art_report_source);
+
+  r->image_w = S_art_image_w;
+  r->image_h = S_art_image_h;
+  r->num_frames = S_art_num_frames;
+  r->num_stored_frames = S_art_num_stored_frames;
+  r->num_angles = S_art_num_angles;
+  r->anim_flags = S_art_anim_flags;
+  r->cell_depth = S_art_cell_depth;
+  r->num_variants = 0;
+  r->cells_addr = S_art_cells_addr;
+  r->cells_size = S_art_cells_size;
+  r->decode_ns = decode_ns;
+  r->num_bytes = num_bytes;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_add_sprite()                                                           */
+/******************************************************************************/
+int art_add_sprite()
+{
+  unsigned short num_entries;
+  unsigned long  num_bytes;
+
+  num_entries = G_art_num_entries;
+  num_bytes = art_sprite_rom_bytes();
+
+  S_art_report_variant_of = VDP_MAX_ENTRIES;
+
+  /* for now, we set all animations to looping,     */
+  /* instead of checking the netscape app extension */
+  S_art_anim_flags |= ART_ANIM_FLAG_LOOP;
+
+  /* store angles that are flipped copies of others as references */
+  if (art_find_mirrored_angles())
+    return 1;
+
+  /* trim transparent borders */
+  if ((G_art_options & ART_OPTION_TRIM) && art_trim_frames())
+    return 1;
+
+  /* store the cells at the smallest depth that fits */
+  if (art_reduce_cell_depth())
+    return 1;
+
+  /* add everything to the rom data buffers */
+  if (art_add_palette())
+    return 1;
+
+  STATS_BEGIN(STATS_PHASE_CELLS);
+
+  if (G_art_options & ART_OPTION_METASPRITES)
+  {
+    if (art_add_metasprite())
+      return 1;
+  }
+  else if (art_add_cells())
+    return 1;
+
+  STATS_END(STATS_PHASE_CELLS);
+
+  if (art_add_angle_map())
+    return 1;
+
+  if (art_add_entry())
+    return 1;
+
+  if (art_merge_palette_variant())
+    return 1;
+
+  art_report_sprite(num_entries, art_sprite_rom_bytes() - num_bytes);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_select_pixels_buf()                                                    */
+/******************************************************************************/
+int art_select_pixels_buf(unsigned char* buf, unsigned long size)
+{
+  unsigned long k;
+
+  /* clear the part of the current buffer that was used */
+  for (k = 0; k < S_art_pixels_size; k++)
+    S_art_pixels_buf[k] = 0;
+
+  S_art_pixels_size = 0;
+
+  S_art_pixels_buf = buf;
+  S_art_pixels_buf_size = size;
+
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_load_gif_angles()                                                      */
+/******************************************************************************/
+int art_load_gif_angles(char** filenames, unsigned short num_angles)
+{
+  unsigned short k;
+
+  /* make sure filenames are valid */
+  if (filenames == NULL)
+    return 1;
+
+  if ((num_angles != 1) && (num_angles != 2) && (num_angles != 4) && (num_angles != 8))
+    return 1;
+
+  /* reset image variables */
+  art_clear_image_vars();
+  art_report_begin(filenames[0]);
+
+  /* an angle set is decoded to the sheet buffer, which is idle here */
+  if (num_angles > 1)
+    art_select_pixels_buf(S_art_sheet_buf, ART_ANGLE_SET_BUFFER_SIZE);
+
+  /* decode each angle, then add the sprite */
+  for (k = 0; k < num_angles; k++)
+  {
+    if (art_decode_gif(filenames[k]))
+      goto nope;
+  }
+
+  if (art_add_sprite())
+    goto nope;
+
+  art_select_pixels_buf(S_art_angle_buf, ART_PIXELS_BUFFER_SIZE);
+
+  return 0;
+
+nope:
+  art_select_pixels_buf(S_art_angle_buf, ART_PIXELS_BUFFER_SIZE);
+  return 1;
+}
+
+/******************************************************************************/
+/* art_load_gif()                                                             */
+/******************************************************************************/
+int art_load_gif(char* filename)
+{
+  return art_load_gif_angles(&filename, 1);
+}
+
+/******************************************************************************/
+/* art_load_gif_memory()                                                      */
+/******************************************************************************/
+int art_load_gif_memory(unsigned char* data, unsigned long size)
+{
+  /* make sure data is valid */
+  if ((data == NULL) || (size == 0))
+    return 1;
+
+  S_art_gif_data = data;
+  S_art_gif_data_size = size;
+
+  /* reset image variables */
+  art_clear_image_vars();
+  art_report_begin("(memory)");
+
+  if (art_decode_gif(NULL))
+    goto nope;
+
+  if (art_add_sprite())
+    goto nope;
+
+  S_art_gif_data = NULL;
+  S_art_gif_data_size = 0;
+
+  return 0;
+
+nope:
+  S_art_gif_data = NULL;
+  S_art_gif_data_size = 0;
+
+  return 1;
+}
+
+/******************************************************************************/
+/* art_load_sheet()                                                           */
+/******************************************************************************/
+int art_load_sheet(char* filename, unsigned short cell_w, unsigned short cell_h)
+{
+  unsigned short k;
+
+  /* make sure filename and grid are valid */
+  if (filename == NULL)
+    return 1;
+
+  if ((cell_w == 0) || ((cell_w % VDP_CELL_W_H) != 0))
+    return 1;
+
+  if ((cell_h == 0) || ((cell_h % VDP_CELL_W_H) != 0))
+    return 1;
+
+  if ((cell_w / VDP_CELL_W_H > ART_MAX_FRAME_COLUMNS) || (cell_h / VDP_CELL_W_H > ART_MAX_FRAME_ROWS))
+    return 1;
+
+  /* reset image variables */
+  art_clear_image_vars();
+  art_clear_gif_lzw_vars();
+
+  strncpy(S_art_report_sheet, filename, ART_REPORT_SOURCE_SIZE - 1);
+  S_art_report_sheet[ART_REPORT_SOURCE_SIZE - 1] = '\0';
+
+  S_art_sheet_w = 0;
+  S_art_sheet_h = 0;
+  S_art_sheet_num_frames = 0;
+
+  /* decode the whole sheet */
+  S_art_frames_buf = S_art_sheet_buf;
+  S_art_frames_buf_size = ART_SHEET_BUFFER_SIZE;
+
+  if (art_gif_parse_file(filename))
+    goto nope;
+
+  /* make sure the sheet covers a whole number of grid cells */
+  if ((S_art_image_w % cell_w) || (S_art_image_h % cell_h))
+    goto nope;
+
+  if ((S_art_num_frames == 0) || (S_art_num_frames > 2 * (ART_MAX_NUM_FRAMES - 1)))
+    goto nope;
+
+  S_art_sheet_w = S_art_image_w;
+  S_art_sheet_h = S_art_image_h;
+  S_art_sheet_cell_w = cell_w;
+  S_art_sheet_cell_h = cell_h;
+  S_art_sheet_num_frames = S_art_num_frames;
+  S_art_sheet_anim_ticks = S_art_anim_ticks;
+
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    S_art_sheet_colors[k] = S_art_gif_colors[k];
+
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
+
+  return 0;
+
+nope:
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
+  return 1;
+}
+
+/******************************************************************************/
+/* art_add_sheet_sprite()                                                     */
+/******************************************************************************/
+int art_add_sheet_sprite(unsigned short slot, char* name)
+{
+  unsigned long k;
+  unsigned long m;
+
+  unsigned long  length;
+
+  unsigned short sheet_columns;
+
+  unsigned long  sheet_addr;
+  unsigned long  pixel_addr;
+
+  if (S_art_sheet_num_frames == 0)
+    return 1;
+
+  /* make sure this slot is on the sheet */
+  sheet_columns = S_art_sheet_w / S_art_sheet_cell_w;
+
+  if (slot >= sheet_columns * (S_art_sheet_h / S_art_sheet_cell_h))
+    return 1;
+
+  /* set up the image variables for this slot */
+  art_clear_image_vars();
+  art_report_begin(S_art_report_sheet);
+
+  /* the sprite is reported by its name on the sheet (or its slot) */
+  length = strlen(S_art_report_source);
+
+  if (name != NULL)
+  {
+    S_art_report_source[length] = '#';
+    strncpy(&S_art_report_source[length + 1], name, ART_REPORT_SOURCE_SIZE - length - 2);
+    S_art_report_source[ART_REPORT_SOURCE_SIZE - 1] = '\0';
+  }
+  else
+    sprintf(&S_art_report_source[length], "#%d", slot);
+
+  S_art_image_w = S_art_sheet_cell_w;
+  S_art_image_h = S_art_sheet_cell_h;
+
+  S_art_frame_rows = S_art_image_h / VDP_CELL_W_H;
+  S_art_frame_columns = S_art_image_w / VDP_CELL_W_H;
+
+  S_art_num_frames = S_art_sheet_num_frames;
+  S_art_anim_ticks = S_art_sheet_anim_ticks;
+
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    S_art_gif_colors[k] = S_art_sheet_colors[k];
+
+  /* copy this slot out of each frame of the sheet */
+  for (k = 0; k < S_art_num_frames; k++)
+  {
+    for (m = 0; m < S_art_image_h; m++)
+    {
+      sheet_addr = k * ((unsigned long) S_art_sheet_w * S_art_sheet_h);
+      sheet_addr += ((slot / sheet_columns) * S_art_sheet_cell_h + m) * S_art_sheet_w;
+      sheet_addr += (slot % sheet_columns) * S_art_sheet_cell_w;
+
+      pixel_addr = k * (S_art_image_w * S_art_image_h);
+      pixel_addr += m * S_art_image_w;
+
+      memcpy(&S_art_pixels_buf[pixel_addr], &S_art_sheet_buf[sheet_addr], S_art_image_w);
+    }
+  }
+
+  S_art_pixels_size = S_art_num_frames * (S_art_image_w * S_art_image_h);
+
+  /* check for ping-pong animation and number of frames */
+  STATS_BEGIN(STATS_PHASE_PING_PONG);
+
+  if (art_check_for_ping_pong_animation())
+    return 1;
+
+  STATS_END(STATS_PHASE_PING_PONG);
+
+  if ((S_art_num_frames == 0) || (S_art_num_frames > ART_MAX_NUM_FRAMES))
+    return 1;
+
+  S_art_pixels_size = S_art_num_frames * (S_art_image_w * S_art_image_h);
+  S_art_num_angles = 1;
+
+  if (art_add_sprite())
+    return 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_find_tile()                                                            */
+/******************************************************************************/
+int art_find_tile(unsigned char* tile, unsigned long* hash_index)
+{
+  unsigned long k;
+
+  unsigned long hash;
+  unsigned long tile_index;
+
+  /* fnv-1a hash of the tile */
+  hash = 2166136261UL;
+
+  for (k = 0; k < VDP_BYTES_PER_CELL; k++)
+  {
+    hash ^= tile[k];
+    hash = (hash * 16777619UL) & 0xFFFFFFFF;
+  }
+
+  /* returns 0 if the tile was found, and 1 otherwise;  */
+  /* either way, the hash index is where it is (or goes) */
+  k = hash % ART_TILE_HASH_SIZE;
+
+  while (S_art_tile_hash[k] != 0)
+  {
+    tile_index = S_art_tile_hash[k] - 1;
+
+    if (!memcmp(&G_art_tiles[VDP_BYTES_PER_CELL * tile_index], tile, VDP_BYTES_PER_CELL))
+    {
+      *hash_index = k;
+      return 0;
+    }
+
+    k = (k + 1) % ART_TILE_HASH_SIZE;
+  }
+
+  *hash_index = k;
+
+  return 1;
+}
+
+/******************************************************************************/
+/* art_add_tile()                                                             */
+/******************************************************************************/
+int art_add_tile(unsigned long pixel_addr, unsigned short* map_val)
+{
+  unsigned long k;
+  unsigned long m;
+
+  unsigned short x;
+  unsigned short y;
+
+  unsigned long  hash_index;
+  unsigned short flips[4];
+
+  unsigned char  pixels[VDP_PIXELS_PER_CELL];
+  unsigned char  tile[VDP_BYTES_PER_CELL];
+
+  flips[0] = 0x0000;
+  flips[1] = ART_TILE_FLIP_H;
+  flips[2] = ART_TILE_FLIP_V;
+  flips[3] = ART_TILE_FLIP_H | ART_TILE_FLIP_V;
+
+  for (k = 0; k < VDP_PIXELS_PER_CELL; k++)
+  {
+    pixels[k] = S_art_sheet_buf[pixel_addr + (k / VDP_CELL_W_H) * S_art_image_w + (k % VDP_CELL_W_H)];
+  }
+
+  /* look for this tile (or a flipped version of it) in the tileset */
+  for (k = 0; k < 4; k++)
+  {
+    for (m = 0; m < VDP_BYTES_PER_CELL; m++)
+      tile[m] = 0;
+
+    for (m = 0; m < VDP_PIXELS_PER_CELL; m++)
+    {
+      x = m % VDP_CELL_W_H;
+      y = m / VDP_CELL_W_H;
+
+      if (flips[k] & ART_TILE_FLIP_H)
+        x = VDP_CELL_W_H - 1 - x;
+
+      if (flips[k] & ART_TILE_FLIP_V)
+        y = VDP_CELL_W_H - 1 - y;
+
+      if (m % 2 == 0)
+        tile[m / 2] |= (pixels[y * VDP_CELL_W_H + x] << 4) & 0xF0;
+      else
+        tile[m / 2] |= pixels[y * VDP_CELL_W_H + x] & 0x0F;
+    }
+
+    if (!art_find_tile(tile, &hash_index))
+    {
+      *map_val = flips[k] | ((S_art_tile_hash[hash_index] - 1) & 0x3FFF);
+      return 0;
+    }
+  }
+
+  /* add the new tile, unflipped */
+  if (G_art_num_tiles >= VDP_MAX_TILES)
+    return 1;
+
+  *map_val = G_art_num_tiles & 0x3FFF;
+
+  for (m = 0; m < VDP_BYTES_PER_CELL; m++)
+    tile[m] = 0;
+
+  for (m = 0; m < VDP_PIXELS_PER_CELL; m++)
+  {
+    if (m % 2 == 0)
+      tile[m / 2] |= (pixels[m] << 4) & 0xF0;
+    else
+      tile[m / 2] |= pixels[m] & 0x0F;
+  }
+
+  art_find_tile(tile, &hash_index);
+
+  memcpy(&G_art_tiles[VDP_BYTES_PER_CELL * G_art_num_tiles], tile, VDP_BYTES_PER_CELL);
+
+  S_art_tile_hash[hash_index] = G_art_num_tiles + 1;
+  G_art_num_tiles += 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_remove_tiles()                                                         */
+/******************************************************************************/
+int art_remove_tiles(unsigned long old_num_tiles)
+{
+  unsigned long k;
+
+  unsigned long hash_index;
+
+  /* the newest tiles are taken out first, so each one is still */
+  /* at the end of its hash chain (and the chains stay intact)  */
+  while (G_art_num_tiles > old_num_tiles)
+  {
+    G_art_num_tiles -= 1;
+
+    if (!art_find_tile(&G_art_tiles[VDP_BYTES_PER_CELL * G_art_num_tiles], &hash_index))
+      S_art_tile_hash[hash_index] = 0;
+
+    for (k = 0; k < VDP_BYTES_PER_CELL; k++)
+      G_art_tiles[VDP_BYTES_PER_CELL * G_art_num_tiles + k] = 0;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_load_background()                                                      */
+/******************************************************************************/
+int art_load_background(char* filename)
+{
+  unsigned long k;
+
+  unsigned short columns;
+  unsigned short rows;
+
+  unsigned long  header_addr;
+  unsigned long  map_addr;
+  unsigned long  pixel_addr;
+
+  unsigned long  old_num_tiles;
+  unsigned short map_val;
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+    return 1;
+
+  if (G_art_num_backgrounds >= ART_MAX_BACKGROUNDS)
+    return 1;
+
+  if (G_art_bg_num_pals >= VDP_ROM_MAX_PALS)
+    return 1;
+
+  /* reset image variables */
+  art_clear_image_vars();
+  art_clear_gif_lzw_vars();
+
+  S_art_gif_flags |= ART_GIF_FLAG_BACKGROUND;
+
+  /* decode the background (only the 1st frame is used) */
+  S_art_frames_buf = S_art_sheet_buf;
+  S_art_frames_buf_size = ART_SHEET_BUFFER_SIZE;
+
+  if (art_gif_parse_file(filename))
+    goto nope;
+
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
+
+  if ((S_art_image_w % VDP_CELL_W_H) || (S_art_image_h % VDP_CELL_W_H))
+    return 1;
+
+  if (S_art_num_frames == 0)
+    return 1;
+
+  columns = S_art_image_w / VDP_CELL_W_H;
+  rows = S_art_image_h / VDP_CELL_W_H;
+
+  if ((G_art_num_tilemap_words + (unsigned long) columns * rows) > ART_TILEMAP_MAX_WORDS)
+    return 1;
+
+  /* tilemap header: dimensions, palette number, tilemap address */
+  header_addr = ART_TILEMAP_HEADER_SIZE * G_art_num_backgrounds;
+  map_addr = ART_MAX_BACKGROUNDS * ART_TILEMAP_HEADER_SIZE + G_art_num_tilemap_words;
+
+  G_art_tilemaps[header_addr + 0] = columns;
+  G_art_tilemaps[header_addr + 1] = rows;
+  G_art_tilemaps[header_addr + 2] = ((G_art_num_tilemap_words >> 8) & 0xFF00) | (G_art_bg_num_pals & 0x00FF);
+  G_art_tilemaps[header_addr + 3] = G_art_num_tilemap_words & 0xFFFF;
+
+  /* add the palette */
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    G_art_bg_pals[G_art_bg_num_pals * VDP_COLORS_PER_PAL + k] = S_art_gif_colors[k];
+
+  G_art_bg_num_pals += 1;
+
+  /* split the background into tiles, and add them to the tileset */
+  old_num_tiles = G_art_num_tiles;
+
+  STATS_BEGIN(STATS_PHASE_CELLS);
+
+  for (k = 0; k < (unsigned long) columns * rows; k++)
+  {
+    pixel_addr = (k / columns) * VDP_CELL_W_H * S_art_image_w;
+    pixel_addr += (k % columns) * VDP_CELL_W_H;
+
+    if (art_add_tile(pixel_addr, &map_val))
+      goto undo;
+
+    G_art_tilemaps[map_addr + k] = map_val;
+  }
+
+  G_art_num_tilemap_words += (unsigned long) columns * rows;
+  G_art_num_backgrounds += 1;
+
+  STATS_END(STATS_PHASE_CELLS);
+  STATS_COUNT(STATS_COUNT_CELLS, G_art_num_tiles - old_num_tiles);
+
+  printf("Background Tiles: %lu new, %lu total\n", 
+         G_art_num_tiles - old_num_tiles, (unsigned long) columns * rows);
+
+  return 0;
+
+  /* take back the palette, tiles, and tilemap of a background */
+  /* that did not fit, so the earlier ones are left as they were */
+undo:
+  STATS_END(STATS_PHASE_CELLS);
+
+  art_remove_tiles(old_num_tiles);
+
+  for (k = 0; k < (unsigned long) columns * rows; k++)
+    G_art_tilemaps[map_addr + k] = 0;
+
+  for (k = 0; k < ART_TILEMAP_HEADER_SIZE; k++)
+    G_art_tilemaps[header_addr + k] = 0;
+
+  G_art_bg_num_pals -= 1;
+
+  for (k = 0; k < VDP_COLORS_PER_PAL; k++)
+    G_art_bg_pals[G_art_bg_num_pals * VDP_COLORS_PER_PAL + k] = 0;
+
+  return 1;
+
+nope:
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
+  return 1;
+}
+
+/******************************************************************************/
+/* art_sort_palettes()                                                        */
+/******************************************************************************/
+int art_sort_palettes()
+{
+  unsigned long k;
+  unsigned long m;
+  unsigned long n;
+
+  unsigned short num_pals;
+  unsigned short pal_index;
+
+  unsigned short val;
+
+  /* place the palettes of each entry next to each other */
+  num_pals = 0;
+
+  for (k = 0; k < G_art_num_entries; k++)
+  {
+    /* word 2: number of palettes, cell depth, palette number */
+    val =  ((S_art_entry_num_pals[k] - 1) << 12) & 0x7000;
+    val |= G_art_nametable[ART_ENTRY_SIZE * k + 1] & 0x0300;
+    val |= num_pals & 0x00FF;
+
+    G_art_nametable[ART_ENTRY_SIZE * k + 1] = val;
+
+    for (m = 0; m < S_art_entry_num_pals[k]; m++)
+    {
+      pal_index = S_art_entry_pals[ART_MAX_PALS_PER_ENTRY * k + m];
+
+      for (n = 0; n < VDP_COLORS_PER_PAL; n++)
+      {
+        S_art_sorted_pals[num_pals * VDP_COLORS_PER_PAL + n] = 
+          G_art_pals[pal_index * VDP_COLORS_PER_PAL + n];
+      }
+
+      num_pals += 1;
+    }
+  }
+
+  for (k = 0; k < (unsigned long) (num_pals * VDP_COLORS_PER_PAL); k++)
+    G_art_pals[k] = S_art_sorted_pals[k];
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_add_chunks_to_rom()                                                    */
+/******************************************************************************/
+int art_add_chunks_to_rom()
+{
+  if (art_sort_palettes())
+    return 1;
+
+  rom_set_chunk_name("nametable");
+
+  if (rom_add_chunk_words(G_art_nametable, G_art_num_entries * ART_ENTRY_SIZE))
+    return 1;
+
+  rom_set_chunk_name("palettes");
+
+  if (rom_add_chunk_words(G_art_pals, G_art_num_pals * VDP_COLORS_PER_PAL))
+    return 1;
+
+  rom_set_chunk_name("cells");
+
+  if (rom_add_chunk_bytes(G_art_cells, G_art_num_cells * VDP_BYTES_PER_CELL))
+    return 1;
+
+  /* metasprite chunk: the piece list offsets for each entry, */
+  /* followed by the piece lists (relative to the table end)  */
+  /* (this is always added, so the chunk order stays fixed)   */
+  if (G_art_num_entries > 0)
+  {
+    memmove(&G_art_metasprites[G_art_num_entries], 
+            &G_art_metasprites[VDP_MAX_ENTRIES], 
+            G_art_num_meta_words * sizeof(unsigned short));
+
+    rom_set_chunk_name("metasprites");
+
+    if (rom_add_chunk_words(G_art_metasprites, G_art_num_entries + G_art_num_meta_words))
+      return 1;
+  }
+
+  /* angle chunk: the angle map offsets for each entry, */
+  /* followed by the maps (relative to the table end)   */
+  if (G_art_num_entries > 0)
+  {
+    memmove(&G_art_angles[G_art_num_entries], 
+            &G_art_angles[VDP_MAX_ENTRIES], 
+            G_art_num_angle_words * sizeof(unsigned short));
+
+    rom_set_chunk_name("angles");
+
+    if (rom_add_chunk_words(G_art_angles, G_art_num_entries + G_art_num_angle_words))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/******************************************************************************/
+/* art_add_bg_chunks_to_rom()                                                 */
+/******************************************************************************/
+int art_add_bg_chunks_to_rom()
+{
+  rom_set_chunk_name("bg_palettes");
+
+  if (rom_add_chunk_words(G_art_bg_pals, G_art_bg_num_pals * VDP_COLORS_PER_PAL))
+    return 1;
+
+  rom_set_chunk_name("bg_tiles");
+
+  if (rom_add_chunk_bytes(G_art_tiles, G_art_num_tiles * VDP_BYTES_PER_CELL))
+    return 1;
+
+  /* tilemap chunk: the header for each background, followed */
+  /* by the tilemaps (addressed relative to the headers end) */
+  if (G_art_num_backgrounds > 0)
+  {
+    memmove(&G_art_tilemaps[ART_TILEMAP_HEADER_SIZE * G_art_num_backgrounds], 
+            &G_art_tilemaps[ART_TILEMAP_HEADER_SIZE * ART_MAX_BACKGROUNDS], 
+            G_art_num_tilemap_words * sizeof(unsigned short));
+
+    rom_set_chunk_name("bg_tilemaps");
+
+    if (rom_add_chunk_words(G_art_tilemaps, ART_TILEMAP_HEADER_SIZE * G_art_num_backgrounds + G_art_num_tilemap_words))
+      return 1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_clear_estimate_vars()                                                  */
+/******************************************************************************/
+int art_clear_estimate_vars()
+{
+  S_art_est_num_entries = 0;
+  S_art_est_num_pals = 0;
+  S_art_est_num_cells = 0;
+  S_art_est_num_meta_words = 0;
+  S_art_est_num_backgrounds = 0;
+  S_art_est_num_tiles = 0;
+  S_art_est_num_tilemap_words = 0;
+  S_art_est_num_failed = 0;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_estimate_add_sprite()                                                  */
+/******************************************************************************/
+int art_estimate_add_sprite()
+{
+  unsigned long cells_per_frame;
+
+  /* each sprite is counted as its own entry with its own palette, */
+  /* and every frame as fully opaque 4bpp cells. angle sets,       */
+  /* palette variants, ping-pong animations, trimming, and 2bpp    */
+  /* cells can only make the real numbers smaller.                 */
+  cells_per_frame = S_art_frame_rows * S_art_frame_columns;
+
+  S_art_est_num_entries += 1;
+  S_art_est_num_pals += 1;
+  S_art_est_num_cells += S_art_num_frames * cells_per_frame;
+
+  if (G_art_options & ART_OPTION_METASPRITES)
+    S_art_est_num_meta_words += S_art_num_frames * (1 + 2 * cells_per_frame);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_estimate_gif()                                                         */
+/******************************************************************************/
+int art_estimate_gif(char* filename)
+{
   /* make sure filename is valid */
   if (filename == NULL)
     return 1;
 
-  /* reset file-related variables */
+  /* read the headers and count the frames, without decoding */
   art_clear_image_vars();
   art_clear_gif_lzw_vars();
 
-  /* open the file */
-  S_art_fp = fopen(filename, "rb");
+  S_art_gif_flags |= ART_GIF_FLAG_HEADER_ONLY;
 
-  if (S_art_fp == NULL)
+  if (art_gif_parse_file(filename) || (S_art_num_frames == 0))
+  {
+    S_art_est_num_failed += 1;
     return 1;
+  }
 
-  /* start parsing the file */
-  if (art_gif_header())
-    goto nope;
+  art_estimate_add_sprite();
 
-  if (art_gif_logical_screen_descriptor())
-    goto nope;
+  return 0;
+}
 
-  if ((S_art_gif_flags & ART_GIF_FLAG_GCT_EXISTS) && art_gif_color_table())
-    goto nope;
+/******************************************************************************/
+/* art_estimate_sheet()                                                       */
+/******************************************************************************/
+int art_estimate_sheet(char* filename, unsigned short cell_w, unsigned short cell_h)
+{
+  /* make sure filename and grid are valid */
+  if (filename == NULL)
+    return 1;
 
-  while (1)
+  S_art_sheet_num_frames = 0;
+
+  if ((cell_w == 0) || ((cell_w % VDP_CELL_W_H) != 0) ||
+      (cell_h == 0) || ((cell_h % VDP_CELL_W_H) != 0) ||
+      (cell_w / VDP_CELL_W_H > ART_MAX_FRAME_COLUMNS) || 
+      (cell_h / VDP_CELL_W_H > ART_MAX_FRAME_ROWS))
   {
-    if (fread(&block_type, sizeof(unsigned char), 1, S_art_fp) < 1)
-      goto nope;
+    S_art_est_num_failed += 1;
+    return 1;
+  }
 
-    /* extension */
-    if (block_type == 0x21)
-    {
-      if (fread(&ext_label, sizeof(unsigned char), 1, S_art_fp) < 1)
-        goto nope;
+  /* read the headers (the sheet is checked against the sheet limits) */
+  art_clear_image_vars();
+  art_clear_gif_lzw_vars();
 
-      /* app extension */
-      if (ext_label == 0xFF)
-      {
-        if (art_gif_app_extension())
-          goto nope;
-      }
-      /* comment extension */
-      else if (ext_label == 0xFE)
-      {
-        if (art_gif_comment_extension())
-          goto nope;
-      }
-      /* plain text extension */
-      else if (ext_label == 0x01)
-      {
-        if (art_gif_plain_text_extension())
-          goto nope;
-      }
-      /* graphic control extension */
-      else if (ext_label == 0xF9)
-      {
-        if (art_gif_graphic_control_extension())
-          goto nope;
-      }
-    }
-    /* image descriptor */
-    else if (block_type == 0x2C)
-    {
-      if (art_gif_image_descriptor())
-        goto nope;
+  S_art_gif_flags |= ART_GIF_FLAG_HEADER_ONLY;
 
-      if ((S_art_gif_flags & ART_GIF_FLAG_LCT_EXISTS) && art_gif_color_table())
-        goto nope;
+  S_art_frames_buf = S_art_sheet_buf;
+  S_art_frames_buf_size = ART_SHEET_BUFFER_SIZE;
 
-      if (art_gif_image_data())
-        goto nope;
+  if (art_gif_parse_file(filename))
+    goto nope;
 
-      if (art_gif_decompress_image())
-        goto nope;
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
 
-      if (art_gif_copy_image_to_pixels())
-        goto nope;
-    }
-    /* trailer */
-    else if (block_type == 0x3B)
-      break;
+  if ((S_art_image_w % cell_w) || (S_art_image_h % cell_h) || (S_art_num_frames == 0))
+  {
+    S_art_est_num_failed += 1;
+    return 1;
   }
 
-  /* close the file */
-  fclose(S_art_fp);
+  /* the slices are counted as the con file names them */
+  S_art_sheet_w = S_art_image_w;
+  S_art_sheet_h = S_art_image_h;
+  S_art_sheet_cell_w = cell_w;
+  S_art_sheet_cell_h = cell_h;
+  S_art_sheet_num_frames = S_art_num_frames;
 
-  /* check for ping-pong animation and number of frames */
-  if (art_check_for_ping_pong_animation())
-    return 1;
+  return 0;
 
-  if ((S_art_num_frames == 0) || (S_art_num_frames > ART_MAX_NUM_FRAMES))
+nope:
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
+
+  S_art_est_num_failed += 1;
+  return 1;
+}
+
+/******************************************************************************/
+/* art_estimate_sheet_sprite()                                                */
+/******************************************************************************/
+int art_estimate_sheet_sprite(unsigned short slot)
+{
+  unsigned short num_slots;
+
+  if (S_art_sheet_num_frames == 0)
     return 1;
 
-  /* for now, we set all animations to looping,     */
-  /* instead of checking the netscape app extension */
-  S_art_anim_flags |= ART_ANIM_FLAG_LOOP;
+  /* make sure this slot is on the sheet */
+  num_slots = (S_art_sheet_w / S_art_sheet_cell_w) * (S_art_sheet_h / S_art_sheet_cell_h);
 
-  /* add everything to the rom data buffers */
-  if (art_add_palette())
+  if (slot >= num_slots)
+  {
+    S_art_est_num_failed += 1;
     return 1;
+  }
+
+  S_art_frame_rows = S_art_sheet_cell_h / VDP_CELL_W_H;
+  S_art_frame_columns = S_art_sheet_cell_w / VDP_CELL_W_H;
+  S_art_num_frames = S_art_sheet_num_frames;
+
+  art_estimate_add_sprite();
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_estimate_background()                                                  */
+/******************************************************************************/
+int art_estimate_background(char* filename)
+{
+  unsigned long num_cells;
 
-  if (art_add_cells())
+  /* make sure filename is valid */
+  if (filename == NULL)
     return 1;
 
-  if (art_add_entry())
+  /* read the headers (backgrounds are checked like sheets) */
+  art_clear_image_vars();
+  art_clear_gif_lzw_vars();
+
+  S_art_gif_flags |= ART_GIF_FLAG_HEADER_ONLY | ART_GIF_FLAG_BACKGROUND;
+
+  S_art_frames_buf = S_art_sheet_buf;
+  S_art_frames_buf_size = ART_SHEET_BUFFER_SIZE;
+
+  if (art_gif_parse_file(filename))
+    goto nope;
+
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
+
+  if ((S_art_image_w % VDP_CELL_W_H) || (S_art_image_h % VDP_CELL_W_H) || (S_art_num_frames == 0))
+  {
+    S_art_est_num_failed += 1;
     return 1;
+  }
 
-  goto ok;
+  /* every tile is counted as unique */
+  num_cells = (S_art_image_w / VDP_CELL_W_H) * (S_art_image_h / VDP_CELL_W_H);
 
-nope:
-  fclose(S_art_fp);
-  return 1;
+  S_art_est_num_backgrounds += 1;
+  S_art_est_num_pals += 1;
+  S_art_est_num_tiles += num_cells;
+  S_art_est_num_tilemap_words += num_cells;
 
-ok:
   return 0;
+
+nope:
+  S_art_frames_buf = S_art_pixels_buf;
+  S_art_frames_buf_size = S_art_pixels_buf_size;
+
+  S_art_est_num_failed += 1;
+  return 1;
 }
 
 /******************************************************************************/
-/* art_add_chunks_to_rom()                                                    */
+/* art_report_estimate()                                                      */
 /******************************************************************************/
-int art_add_chunks_to_rom()
+int art_report_estimate(unsigned long* num_bytes)
 {
-  if (rom_add_chunk_words(G_art_nametable, G_art_num_entries * VDP_ENTRY_SIZE))
+  int exceeded;
+
+  if (num_bytes == NULL)
     return 1;
 
-  if (rom_add_chunk_words(G_art_pals, G_art_num_pals * VDP_COLORS_PER_PAL))
+  /* nametable, palette, cell, metasprite, and angle chunks */
+  *num_bytes = 5 * ART_ROM_CHUNK_ENTRY_BYTES;
+
+  *num_bytes += 2 * ART_ENTRY_SIZE * S_art_est_num_entries;
+  *num_bytes += 2 * VDP_COLORS_PER_PAL * S_art_est_num_pals;
+  *num_bytes += VDP_BYTES_PER_CELL * S_art_est_num_cells;
+  *num_bytes += 2 * (S_art_est_num_entries + S_art_est_num_meta_words);
+  *num_bytes += 2 * S_art_est_num_entries;
+
+  printf("Estimated Entries: %lu (max %d)\n", S_art_est_num_entries, VDP_MAX_ENTRIES);
+  printf("Estimated Palettes: %lu (max %d)\n", S_art_est_num_pals, VDP_ROM_MAX_PALS);
+  printf("Estimated Cells: %lu (max %d)\n", S_art_est_num_cells, VDP_ROM_MAX_CELLS);
+  printf("Estimated Bytes: %lu\n", *num_bytes);
+
+  if (S_art_est_num_failed > 0)
+    printf("Files Not Estimated: %lu\n", S_art_est_num_failed);
+
+  /* check the limits */
+  exceeded = 0;
+
+  if (S_art_est_num_entries > VDP_MAX_ENTRIES)
+  {
+    printf("Limit May Be Exceeded: VDP_MAX_ENTRIES\n");
+    exceeded = 1;
+  }
+
+  if (S_art_est_num_pals > VDP_ROM_MAX_PALS)
+  {
+    printf("Limit May Be Exceeded: VDP_ROM_MAX_PALS\n");
+    exceeded = 1;
+  }
+
+  if (S_art_est_num_cells > VDP_ROM_MAX_CELLS)
+  {
+    printf("Limit May Be Exceeded: VDP_ROM_MAX_CELLS\n");
+    exceeded = 1;
+  }
+
+  if (S_art_est_num_meta_words > ART_META_MAX_PIECE_WORDS)
+  {
+    printf("Limit May Be Exceeded: ART_META_MAX_PIECE_WORDS\n");
+    exceeded = 1;
+  }
+
+  return exceeded;
+}
+
+/******************************************************************************/
+/* art_report_bg_estimate()                                                   */
+/******************************************************************************/
+int art_report_bg_estimate(unsigned long* num_bytes)
+{
+  int exceeded;
+
+  if (num_bytes == NULL)
     return 1;
 
-  if (rom_add_chunk_bytes(G_art_cells, G_art_num_cells * VDP_BYTES_PER_CELL))
+  /* palette, tile, and tilemap chunks */
+  *num_bytes = 3 * ART_ROM_CHUNK_ENTRY_BYTES;
+
+  *num_bytes += 2 * VDP_COLORS_PER_PAL * S_art_est_num_pals;
+  *num_bytes += VDP_BYTES_PER_CELL * S_art_est_num_tiles;
+  *num_bytes += 2 * ART_TILEMAP_HEADER_SIZE * S_art_est_num_backgrounds;
+  *num_bytes += 2 * S_art_est_num_tilemap_words;
+
+  printf("Estimated Backgrounds: %lu (max %d)\n", S_art_est_num_backgrounds, ART_MAX_BACKGROUNDS);
+  printf("Estimated Palettes: %lu (max %d)\n", S_art_est_num_pals, VDP_ROM_MAX_PALS);
+  printf("Estimated Tiles: %lu (max %d)\n", S_art_est_num_tiles, VDP_MAX_TILES);
+  printf("Estimated Bytes: %lu\n", *num_bytes);
+
+  if (S_art_est_num_failed > 0)
+    printf("Files Not Estimated: %lu\n", S_art_est_num_failed);
+
+  /* check the limits (the tile count is before duplicates are removed) */
+  exceeded = 0;
+
+  if (S_art_est_num_backgrounds > ART_MAX_BACKGROUNDS)
+  {
+    printf("Limit May Be Exceeded: ART_MAX_BACKGROUNDS\n");
+    exceeded = 1;
+  }
+
+  if (S_art_est_num_pals > VDP_ROM_MAX_PALS)
+  {
+    printf("Limit May Be Exceeded: VDP_ROM_MAX_PALS\n");
+    exceeded = 1;
+  }
+
+  if (S_art_est_num_tiles > VDP_MAX_TILES)
+  {
+    printf("Limit May Be Exceeded: VDP_MAX_TILES (before removing duplicates)\n");
+    exceeded = 1;
+  }
+
+  if (S_art_est_num_tilemap_words > ART_TILEMAP_MAX_WORDS)
+  {
+    printf("Limit May Be Exceeded: ART_TILEMAP_MAX_WORDS\n");
+    exceeded = 1;
+  }
+
+  return exceeded;
+}
+
+/******************************************************************************/
+/* art_write_report_string()                                                  */
+/******************************************************************************/
+int art_write_report_string(FILE* fp, char* str)
+{
+  fputc('"', fp);
+
+  for (; *str != '\0'; str++)
+  {
+    if ((*str == '"') || (*str == '\\'))
+      fprintf(fp, "\\%c", *str);
+    else if ((unsigned char) *str < 0x20)
+      fprintf(fp, "\\u%04x", (unsigned char) *str);
+    else
+      fputc(*str, fp);
+  }
+
+  fputc('"', fp);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* art_compare_map_entries()                                                  */
+/******************************************************************************/
+int art_compare_map_entries(const void* a, const void* b)
+{
+  unsigned short k;
+  unsigned short m;
+
+  k = *((const unsigned short*) a);
+  m = *((const unsigned short*) b);
+
+  /* by cell address, then by entry (sheet slots can share cells) */
+  if (S_art_report[k].cells_addr != S_art_report[m].cells_addr)
+    return (S_art_report[k].cells_addr < S_art_report[m].cells_addr) ? -1 : 1;
+
+  return (k < m) ? -1 : (k > m) ? 1 : 0;
+}
+
+/******************************************************************************/
+/* art_write_map()                                                            */
+/******************************************************************************/
+int art_write_map(FILE* fp)
+{
+  unsigned short k;
+  unsigned short m;
+
+  unsigned short* order;
+  struct art_report_entry* r;
+
+  unsigned long  cells_file_addr;
+  unsigned long  cell_bytes;
+
+  if (fp == NULL)
     return 1;
 
+  if (G_art_num_entries == 0)
+    return 0;
+
+  /* sprites are only mapped if their cells made it into the rom */
+  if (rom_find_chunk("cells", &cells_file_addr))
+    return 0;
+
+  /* the sorted palettes were copied back when the chunks */
+  /* were added, so that buffer holds the sort order here */
+  order = S_art_sorted_pals;
+
+  for (k = 0; k < G_art_num_entries; k++)
+    order[k] = k;
+
+  qsort(order, G_art_num_entries, sizeof(unsigned short), art_compare_map_entries);
+
+  fprintf(fp, "\n[sprites]\n");
+  fprintf(fp, "# address size     entry cells       palette source\n");
+
+  for (k = 0; k < G_art_num_entries; k++)
+  {
+    m = order[k];
+    r = &S_art_report[m];
+
+    cell_bytes = (r->cell_depth == VDP_CELL_DEPTH_2BPP) ? 
+                 VDP_BYTES_PER_CELL_2BPP * r->cells_size : VDP_BYTES_PER_CELL * r->cells_size;
+
+    /* cells are in 4bpp cell units (two 2bpp cells share one), and */
+    /* palette is the first slot, and how many the entry uses       */
+    fprintf(fp, "%08lX %08lX %5d %5lu-%-5lu %3d+%-3d %s\n",
+            cells_file_addr + VDP_BYTES_PER_CELL * r->cells_addr,
+            cell_bytes, m,
+            r->cells_addr, 
+            r->cells_addr + ((cell_bytes > 0) ? (cell_bytes - 1) / VDP_BYTES_PER_CELL : 0),
+            G_art_nametable[ART_ENTRY_SIZE * m + 1] & 0x00FF, 
+            S_art_entry_num_pals[m],
+            r->source);
+  }
+
   return 0;
 }
 
+/******************************************************************************/
+/* art_write_report()                                                         */
+/******************************************************************************/
+int art_write_report(FILE* fp)
+{
+  unsigned short k;
+
+  unsigned short* entry;
+  struct art_report_entry* r;
+
+  if (fp == NULL)
+    return 1;
+
+  /* entries (the palettes were sorted when the chunks were added) */
+  fprintf(fp, "  \"entries\": [\n");
+
+  for (k = 0; k < G_art_num_entries; k++)
+  {
+    entry = &G_art_nametable[ART_ENTRY_SIZE * k];
+    r = &S_art_report[k];
+
+    fprintf(fp, "    {\"index\": %d, \"source\": ", k);
+    art_write_report_string(fp, r->source);
+
+    fprintf(fp, ", \"width\": %d, \"height\": %d", r->image_w, r->image_h);
+    fprintf(fp, ", \"frames\": %d, \"stored_frames\": %d", r->num_frames, r->num_stored_frames);
+    fprintf(fp, ", \"angles\": %d", r->num_angles);
+    fprintf(fp, ", \"ping_pong\": %s", (r->anim_flags & ART_ANIM_FLAG_PING_PONG) ? "true" : "false");
+    fprintf(fp, ", \"bpp\": %d", (r->cell_depth == VDP_CELL_DEPTH_2BPP) ? 2 : 4);
+    fprintf(fp, ", \"palette\": %d, \"palettes\": %d", entry[1] & 0x00FF, S_art_entry_num_pals[k]);
+    fprintf(fp, ", \"cells_addr\": %lu, \"cells\": %lu", r->cells_addr, r->cells_size);
+    fprintf(fp, ", \"cell_bytes\": %lu", (r->cell_depth == VDP_CELL_DEPTH_2BPP) ? 
+            VDP_BYTES_PER_CELL_2BPP * r->cells_size : VDP_BYTES_PER_CELL * r->cells_size);
+    fprintf(fp, ", \"decode_us\": %lu", r->decode_ns / 1000);
+    fprintf(fp, ", \"bytes\": %lu}", r->num_bytes);
+
+    fprintf(fp, "%s\n", (k + 1 < G_art_num_entries) ? "," : "");
+  }
+
+  fprintf(fp, "  ],\n");
+
+  /* sprite chunks */
+  fprintf(fp, "  \"sprites\": {\n");
+  fprintf(fp, "    \"nametable_bytes\": %lu,\n", 2UL * ART_ENTRY_SIZE * G_art_num_entries);
+  fprintf(fp, "    \"palette_bytes\": %lu,\n", 2UL * VDP_COLORS_PER_PAL * G_art_num_pals);
+  fprintf(fp, "    \"cell_bytes\": %lu,\n", VDP_BYTES_PER_CELL * G_art_num_cells);
+  fprintf(fp, "    \"metasprite_bytes\": %lu,\n", (G_art_num_entries > 0) ? 2 * (G_art_num_entries + G_art_num_meta_words) : 0);
+  fprintf(fp, "    \"angle_bytes\": %lu,\n", (G_art_num_entries > 0) ? 2 * (G_art_num_entries + G_art_num_angle_words) : 0);
+  fprintf(fp, "    \"entries\": %d, \"max_entries\": %d, \"entries_headroom\": %d,\n", 
+          G_art_num_entries, VDP_MAX_ENTRIES, VDP_MAX_ENTRIES - G_art_num_entries);
+  fprintf(fp, "    \"palettes\": %d, \"max_palettes\": %d, \"palettes_headroom\": %d,\n", 
+          G_art_num_pals, VDP_ROM_MAX_PALS, VDP_ROM_MAX_PALS - G_art_num_pals);
+  fprintf(fp, "    \"cells\": %lu, \"max_cells\": %d, \"cells_headroom\": %lu\n", 
+          G_art_num_cells, VDP_ROM_MAX_CELLS, VDP_ROM_MAX_CELLS - G_art_num_cells);
+  fprintf(fp, "  },\n");
+
+  /* background chunks */
+  fprintf(fp, "  \"backgrounds\": {\n");
+  fprintf(fp, "    \"palette_bytes\": %lu,\n", 2UL * VDP_COLORS_PER_PAL * G_art_bg_num_pals);
+  fprintf(fp, "    \"tile_bytes\": %lu,\n", VDP_BYTES_PER_CELL * G_art_num_tiles);
+  fprintf(fp, "    \"tilemap_bytes\": %lu,\n", 2 * (ART_TILEMAP_HEADER_SIZE * G_art_num_backgrounds + G_art_num_tilemap_words));
+  fprintf(fp, "    \"backgrounds\": %d, \"max_backgrounds\": %d,\n", G_art_num_backgrounds, ART_MAX_BACKGROUNDS);
+  fprintf(fp, "    \"palettes\": %d, \"max_palettes\": %d,\n", G_art_bg_num_pals, VDP_ROM_MAX_PALS);
+  fprintf(fp, "    \"tiles\": %lu, \"max_tiles\": %d, \"tiles_headroom\": %lu\n", 
+          G_art_num_tiles, VDP_MAX_TILES, VDP_MAX_TILES - G_art_num_tiles);
+  fprintf(fp, "  },\n");
+
+  return 0;
+}
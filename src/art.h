@@ -6,21 +6,69 @@
 #define ART_H
 
 /* rom data buffers */
-extern unsigned short G_art_nametable[];
-extern unsigned short G_art_num_entries;
+extern __thread unsigned short* G_art_nametable;
+extern __thread unsigned short G_art_num_entries;
 
-extern unsigned short G_art_pals[];
-extern unsigned short G_art_num_pals;
+extern __thread unsigned short* G_art_pals;
+extern __thread unsigned short G_art_num_pals;
 
-extern unsigned char  G_art_cells[];
-extern unsigned long  G_art_num_cells;
+extern __thread unsigned char* G_art_cells;
+extern __thread unsigned long  G_art_num_cells;
+
+extern __thread unsigned short* G_art_metasprites;
+extern __thread unsigned long  G_art_num_meta_words;
+
+extern __thread unsigned short* G_art_angles;
+extern __thread unsigned long  G_art_num_angle_words;
+
+extern __thread unsigned short* G_art_bg_pals;
+extern __thread unsigned short G_art_bg_num_pals;
+
+extern __thread unsigned char* G_art_tiles;
+extern __thread unsigned long  G_art_num_tiles;
+
+extern __thread unsigned short* G_art_tilemaps;
+extern __thread unsigned short G_art_num_backgrounds;
+extern __thread unsigned long  G_art_num_tilemap_words;
+
+/* options */
+#define ART_OPTION_TRIM         0x0001
+#define ART_OPTION_METASPRITES  0x0002
+
+extern __thread unsigned short G_art_options;
 
 /* function declarations */
+unsigned long art_buffers_size();
+int art_bind_buffers(unsigned char* buf);
+int art_save_state();
+int art_restore_state();
+int art_print_memory();
+
 int art_clear_rom_data_vars();
+int art_clear_bg_data_vars();
 
 int art_load_gif(char* filename);
+int art_load_gif_angles(char** filenames, unsigned short num_angles);
+int art_load_gif_memory(unsigned char* data, unsigned long size);
+
+int art_load_sheet(char* filename, unsigned short cell_w, unsigned short cell_h);
+int art_add_sheet_sprite(unsigned short slot, char* name);
+
+int art_load_background(char* filename);
 
 int art_add_chunks_to_rom();
+int art_add_bg_chunks_to_rom();
+
+int art_clear_estimate_vars();
+int art_estimate_gif(char* filename);
+int art_estimate_sheet(char* filename, unsigned short cell_w, unsigned short cell_h);
+int art_estimate_sheet_sprite(unsigned short slot);
+int art_estimate_background(char* filename);
+int art_report_estimate(unsigned long* num_bytes);
+int art_report_bg_estimate(unsigned long* num_bytes);
+
+int art_write_report(FILE* fp);
+int art_write_map(FILE* fp);
 
 #endif
 
@@ -0,0 +1,689 @@
+/******************************************************************************/
+/* cache.c (decoded asset cache)                                              */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+
+/* the cache is a memory mapped file that is shared by any number */
+/* of packer processes. decoded files are keyed by a hash of their */
+/* contents, and slots are claimed and published with atomics, so */
+/* no locking is needed (records are never removed or replaced).  */
+/* the hash only picks the slot: a copy of the file is kept with  */
+/* its record, and a hit is only trusted if the contents match.   */
+/* files are also indexed by their stat fields, so a file that    */
+/* has not changed since it was seen is found without reading it  */
+
+/* cache file format (all fields are unsigned longs)     */
+/* 1) header (8 words)                                   */
+/*    a) magic                                           */
+/*    b) bytes used in the data block                    */
+/* 2) record slot table (5 words each)                   */
+/*    a) key (content hash, 0 if the slot is free)       */
+/*    b) file size                                       */
+/*    c) address of the file copy in the data block      */
+/*       (the record follows it, 8 byte aligned)         */
+/*    d) record size (0 until the record is ready)       */
+/*    e) pid of the process writing the record           */
+/* 3) file slot table (9 words each)                     */
+/*    a) key (stat hash, 0 if the slot is free)          */
+/*    b) device, inode, size, mtime & ctime (s, ns)      */
+/*    c) record slot number + 1 (0 until it is ready)    */
+/* 4) data block                                         */
+
+#define CACHE_FILENAME          "kunopack.cache"
+
+#define CACHE_MAGIC             0x4B50434143484532UL /* "KPCACHE2" */
+
+#define CACHE_HEADER_WORDS      8
+#define CACHE_HEADER_MAGIC      0
+#define CACHE_HEADER_DATA_USED  1
+
+#define CACHE_NUM_SLOTS         (1 << 16)
+#define CACHE_SLOT_WORDS        5
+
+#define CACHE_SLOT_KEY          0
+#define CACHE_SLOT_FILE_SIZE    1
+#define CACHE_SLOT_ADDR         2
+#define CACHE_SLOT_SIZE         3
+#define CACHE_SLOT_OWNER        4
+
+#define CACHE_NUM_FILE_SLOTS    (1 << 16)
+#define CACHE_FILE_ID_WORDS     7
+#define CACHE_FILE_SLOT_WORDS   (CACHE_FILE_ID_WORDS + 2)
+
+#define CACHE_FILE_SLOT_KEY     0
+#define CACHE_FILE_SLOT_ID      1
+#define CACHE_FILE_SLOT_RECORD  (CACHE_FILE_ID_WORDS + 1)
+
+#define CACHE_TABLE_BYTES                                                      \
+  (sizeof(unsigned long) * (CACHE_HEADER_WORDS +                               \
+                            CACHE_NUM_SLOTS * CACHE_SLOT_WORDS +               \
+                            CACHE_NUM_FILE_SLOTS * CACHE_FILE_SLOT_WORDS))
+
+#define CACHE_ALIGN(num_bytes)  (((num_bytes) + 7) & ~7UL)
+
+#define CACHE_FNV_OFFSET        14695981039346656037UL
+#define CACHE_FNV_PRIME         1099511628211UL
+
+#define CACHE_FILE_SIZE         (256UL * 1024 * 1024) /* 256 MB (sparse) */
+#define CACHE_DATA_SIZE         (CACHE_FILE_SIZE - CACHE_TABLE_BYTES)
+
+#define CACHE_PATH_MAX_SIZE     1024
+
+/* the files are read in pieces to be hashed */
+#define CACHE_READ_BUFFER_SIZE  (16 * 1024) /* 16 KB */
+
+/* the mapping is shared by every thread in the process */
+static unsigned char* S_cache_map;
+static unsigned char  S_cache_is_file;
+
+static unsigned long* S_cache_header;
+static unsigned long* S_cache_slots;
+static unsigned long* S_cache_file_slots;
+static unsigned char* S_cache_data;
+
+static __thread unsigned char S_cache_read_buf[CACHE_READ_BUFFER_SIZE];
+
+/* the file from the last find (a store adds the record for it) */
+static __thread char           S_cache_filename[CACHE_PATH_MAX_SIZE];
+
+static __thread unsigned long  S_cache_key;
+static __thread unsigned long  S_cache_file_size;
+
+static __thread unsigned long  S_cache_file_key;
+static __thread unsigned long  S_cache_file_id[CACHE_FILE_ID_WORDS];
+
+__thread unsigned char* G_cache_record;
+__thread unsigned long  G_cache_record_size;
+
+/******************************************************************************/
+/* cache_open()                                                               */
+/******************************************************************************/
+int cache_open(char* folder)
+{
+  int fd;
+  struct stat st;
+
+  char path[CACHE_PATH_MAX_SIZE];
+
+  void* map;
+
+  cache_close();
+
+  /* without a folder, the cache is only kept in memory */
+  /* (the pages are not touched until they are used)    */
+  if (folder == NULL)
+  {
+    map = calloc(CACHE_FILE_SIZE, sizeof(unsigned char));
+
+    if (map == NULL)
+      return 1;
+
+    S_cache_is_file = 0;
+
+    goto found;
+  }
+
+  if ((strlen(folder) + strlen(CACHE_FILENAME) + 2) > CACHE_PATH_MAX_SIZE)
+    return 1;
+
+  strcpy(path, folder);
+  strcat(path, "/");
+  strcat(path, CACHE_FILENAME);
+
+  /* open the cache file, creating it if needed */
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+
+  if (fd < 0)
+    return 1;
+
+  if (fstat(fd, &st))
+    goto nope;
+
+  if ((unsigned long) st.st_size < CACHE_FILE_SIZE)
+  {
+    if (ftruncate(fd, CACHE_FILE_SIZE))
+      goto nope;
+  }
+
+  /* map it */
+  map = mmap(NULL, CACHE_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (map == MAP_FAILED)
+    goto nope;
+
+  close(fd);
+
+  S_cache_is_file = 1;
+
+found:
+  S_cache_map = (unsigned char*) map;
+
+  S_cache_header = (unsigned long*) S_cache_map;
+  S_cache_slots = S_cache_header + CACHE_HEADER_WORDS;
+  S_cache_file_slots = S_cache_slots + CACHE_NUM_SLOTS * CACHE_SLOT_WORDS;
+  S_cache_data = S_cache_map + CACHE_TABLE_BYTES;
+
+  /* a new cache file is all zeroes, so just stamp it; */
+  /* if it was written by a different version, skip it */
+  __sync_bool_compare_and_swap(&S_cache_header[CACHE_HEADER_MAGIC], 0UL, CACHE_MAGIC);
+
+  if (S_cache_header[CACHE_HEADER_MAGIC] != CACHE_MAGIC)
+  {
+    cache_close();
+    return 1;
+  }
+
+  return 0;
+
+nope:
+  close(fd);
+  return 1;
+}
+
+/******************************************************************************/
+/* cache_close()                                                              */
+/******************************************************************************/
+int cache_close()
+{
+  if ((S_cache_map != NULL) && S_cache_is_file)
+    munmap(S_cache_map, CACHE_FILE_SIZE);
+  else if (S_cache_map != NULL)
+    free(S_cache_map);
+
+  S_cache_map = NULL;
+  S_cache_is_file = 0;
+
+  S_cache_header = NULL;
+  S_cache_slots = NULL;
+  S_cache_file_slots = NULL;
+  S_cache_data = NULL;
+
+  S_cache_filename[0] = '\0';
+
+  S_cache_key = 0;
+  S_cache_file_size = 0;
+  S_cache_file_key = 0;
+
+  G_cache_record = NULL;
+  G_cache_record_size = 0;
+
+  return 0;
+}
+
+
+/******************************************************************************/
+/* cache_hash_bytes()                                                         */
+/******************************************************************************/
+unsigned long cache_hash_bytes(unsigned long hash, unsigned char* data, unsigned long num_bytes)
+{
+  unsigned long k;
+
+  /* fnv-1a, continued from the given hash */
+  for (k = 0; k < num_bytes; k++)
+  {
+    hash ^= data[k];
+    hash *= CACHE_FNV_PRIME;
+  }
+
+  return hash;
+}
+
+/******************************************************************************/
+/* cache_hash_file()                                                          */
+/******************************************************************************/
+int cache_hash_file(char* filename, unsigned long* hash)
+{
+  FILE* fp;
+
+  unsigned long num_bytes;
+  unsigned long total_bytes;
+
+  fp = fopen(filename, "rb");
+
+  if (fp == NULL)
+    return 1;
+
+  *hash = CACHE_FNV_OFFSET;
+  total_bytes = 0;
+
+  do
+  {
+    num_bytes = fread(S_cache_read_buf, sizeof(unsigned char), CACHE_READ_BUFFER_SIZE, fp);
+
+    *hash = cache_hash_bytes(*hash, S_cache_read_buf, num_bytes);
+    total_bytes += num_bytes;
+  } while (num_bytes == CACHE_READ_BUFFER_SIZE);
+
+  if (ferror(fp))
+  {
+    fclose(fp);
+    return 1;
+  }
+
+  fclose(fp);
+
+  /* the file may have changed since it was stat'd */
+  if (total_bytes != S_cache_file_size)
+    return 1;
+
+  /* 0 marks a free slot, so it is not used */
+  if (*hash == 0)
+    *hash = 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* cache_compare_file()                                                       */
+/******************************************************************************/
+int cache_compare_file(char* filename, unsigned char* data, unsigned long num_bytes)
+{
+  FILE* fp;
+
+  unsigned long count;
+  unsigned long total_bytes;
+
+  /* returns 0 if the file holds exactly these bytes */
+  fp = fopen(filename, "rb");
+
+  if (fp == NULL)
+    return 1;
+
+  total_bytes = 0;
+
+  do
+  {
+    count = fread(S_cache_read_buf, sizeof(unsigned char), CACHE_READ_BUFFER_SIZE, fp);
+
+    if ((total_bytes + count > num_bytes) || memcmp(S_cache_read_buf, &data[total_bytes], count))
+    {
+      fclose(fp);
+      return 1;
+    }
+
+    total_bytes += count;
+  } while (count == CACHE_READ_BUFFER_SIZE);
+
+  if (ferror(fp) || (total_bytes != num_bytes))
+  {
+    fclose(fp);
+    return 1;
+  }
+
+  fclose(fp);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* cache_copy_file()                                                          */
+/******************************************************************************/
+int cache_copy_file(char* filename, unsigned char* data, unsigned long num_bytes)
+{
+  FILE* fp;
+
+  unsigned long hash;
+
+  /* the copy must match the hash from the last find */
+  fp = fopen(filename, "rb");
+
+  if (fp == NULL)
+    return 1;
+
+  if ((fread(data, sizeof(unsigned char), num_bytes, fp) != num_bytes) || (fgetc(fp) != EOF))
+  {
+    fclose(fp);
+    return 1;
+  }
+
+  fclose(fp);
+
+  hash = cache_hash_bytes(CACHE_FNV_OFFSET, data, num_bytes);
+
+  if (hash == 0)
+    hash = 1;
+
+  if (hash != S_cache_key)
+    return 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* cache_owner_alive()                                                        */
+/******************************************************************************/
+int cache_owner_alive(unsigned long owner)
+{
+  /* returns 0 if the process that claimed a slot has exited */
+  /* (an owner of 0 has claimed the slot, but not yet said so) */
+  if ((owner == 0) || (owner == (unsigned long) getpid()))
+    return 1;
+
+  if ((kill((pid_t) owner, 0) == 0) || (errno != ESRCH))
+    return 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* cache_stat_file()                                                          */
+/******************************************************************************/
+int cache_stat_file(char* filename)
+{
+  struct stat st;
+
+  unsigned long k;
+  unsigned long m;
+
+  unsigned long hash;
+
+  if (stat(filename, &st) || !S_ISREG(st.st_mode))
+    return 1;
+
+  /* a file with the same stat fields is taken to be unchanged */
+  S_cache_file_id[0] = st.st_dev;
+  S_cache_file_id[1] = st.st_ino;
+  S_cache_file_id[2] = st.st_size;
+  S_cache_file_id[3] = st.st_mtim.tv_sec;
+  S_cache_file_id[4] = st.st_mtim.tv_nsec;
+  S_cache_file_id[5] = st.st_ctim.tv_sec;
+  S_cache_file_id[6] = st.st_ctim.tv_nsec;
+
+  S_cache_file_size = st.st_size;
+
+  hash = CACHE_FNV_OFFSET;
+
+  for (k = 0; k < CACHE_FILE_ID_WORDS; k++)
+  {
+    for (m = 0; m < 8; m++)
+    {
+      hash ^= (S_cache_file_id[k] >> (8 * m)) & 0xFF;
+      hash *= CACHE_FNV_PRIME;
+    }
+  }
+
+  if (hash == 0)
+    hash = 1;
+
+  S_cache_file_key = hash;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* cache_find_file_slot()                                                     */
+/******************************************************************************/
+unsigned long cache_find_file_slot()
+{
+  unsigned long k;
+  unsigned long m;
+
+  unsigned long  record;
+  unsigned long* file_slot;
+
+  /* returns the record slot number + 1 for the file */
+  /* from the last stat, or 0 if it was not found    */
+  for (k = 0; k < CACHE_NUM_FILE_SLOTS; k++)
+  {
+    m = (S_cache_file_key + k) % CACHE_NUM_FILE_SLOTS;
+    file_slot = &S_cache_file_slots[CACHE_FILE_SLOT_WORDS * m];
+
+    if (file_slot[CACHE_FILE_SLOT_KEY] == 0)
+      return 0;
+
+    if (file_slot[CACHE_FILE_SLOT_KEY] != S_cache_file_key)
+      continue;
+
+    /* a slot that is not ready is skipped (its writer may be gone) */
+    record = file_slot[CACHE_FILE_SLOT_RECORD];
+
+    if (record == 0)
+      continue;
+
+    __sync_synchronize();
+
+    if (memcmp(&file_slot[CACHE_FILE_SLOT_ID], S_cache_file_id, sizeof(S_cache_file_id)))
+      continue;
+
+    return record;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* cache_add_file_slot()                                                      */
+/******************************************************************************/
+int cache_add_file_slot(unsigned long record)
+{
+  unsigned long k;
+  unsigned long m;
+
+  unsigned long* file_slot;
+
+  if (S_cache_file_key == 0)
+    return 1;
+
+  if (cache_find_file_slot() != 0)
+    return 0;
+
+  /* claim a free slot, and publish it (the record is written last) */
+  for (k = 0; k < CACHE_NUM_FILE_SLOTS; k++)
+  {
+    m = (S_cache_file_key + k) % CACHE_NUM_FILE_SLOTS;
+    file_slot = &S_cache_file_slots[CACHE_FILE_SLOT_WORDS * m];
+
+    if (!__sync_bool_compare_and_swap(&file_slot[CACHE_FILE_SLOT_KEY], 0UL, S_cache_file_key))
+      continue;
+
+    memcpy(&file_slot[CACHE_FILE_SLOT_ID], S_cache_file_id, sizeof(S_cache_file_id));
+
+    __sync_synchronize();
+
+    file_slot[CACHE_FILE_SLOT_RECORD] = record;
+
+    return 0;
+  }
+
+  return 1;
+}
+
+/******************************************************************************/
+/* cache_find()                                                               */
+/******************************************************************************/
+int cache_find(char* filename)
+{
+  unsigned long k;
+  unsigned long m;
+
+  unsigned long  hash;
+  unsigned long  record;
+  unsigned long* slot;
+
+  G_cache_record = NULL;
+  G_cache_record_size = 0;
+
+  S_cache_key = 0;
+  S_cache_file_size = 0;
+  S_cache_file_key = 0;
+
+  if ((S_cache_map == NULL) || (filename == NULL))
+    return 1;
+
+  if (strlen(filename) >= CACHE_PATH_MAX_SIZE)
+    return 1;
+
+  strcpy(S_cache_filename, filename);
+
+  if (cache_stat_file(filename))
+    return 1;
+
+  /* a file that was seen unchanged is found without reading it */
+  record = cache_find_file_slot();
+
+  if (record != 0)
+  {
+    slot = &S_cache_slots[CACHE_SLOT_WORDS * (record - 1)];
+
+    if (slot[CACHE_SLOT_FILE_SIZE] == S_cache_file_size)
+    {
+      S_cache_key = slot[CACHE_SLOT_KEY];
+
+      G_cache_record = &S_cache_data[slot[CACHE_SLOT_ADDR] + CACHE_ALIGN(S_cache_file_size)];
+      G_cache_record_size = slot[CACHE_SLOT_SIZE];
+
+      return 0;
+    }
+  }
+
+  /* otherwise, hash the file, and look for the key */
+  if (cache_hash_file(filename, &hash))
+    return 1;
+
+  S_cache_key = hash;
+
+  for (k = 0; k < CACHE_NUM_SLOTS; k++)
+  {
+    m = (hash + k) % CACHE_NUM_SLOTS;
+    slot = &S_cache_slots[CACHE_SLOT_WORDS * m];
+
+    if (slot[CACHE_SLOT_KEY] == 0)
+      return 1;
+
+    if (slot[CACHE_SLOT_KEY] != hash)
+      continue;
+
+    /* the record may still be getting written by another process */
+    if (slot[CACHE_SLOT_SIZE] == 0)
+      continue;
+
+    __sync_synchronize();
+
+    /* the hash can collide, so the contents are checked too */
+    if (slot[CACHE_SLOT_FILE_SIZE] != S_cache_file_size)
+      continue;
+
+    if (cache_compare_file(filename, &S_cache_data[slot[CACHE_SLOT_ADDR]], S_cache_file_size))
+      continue;
+
+    G_cache_record = &S_cache_data[slot[CACHE_SLOT_ADDR] + CACHE_ALIGN(S_cache_file_size)];
+    G_cache_record_size = slot[CACHE_SLOT_SIZE];
+
+    cache_add_file_slot(m + 1);
+
+    return 0;
+  }
+
+  return 1;
+}
+
+/******************************************************************************/
+/* cache_store()                                                              */
+/******************************************************************************/
+int cache_store(unsigned char* record, unsigned long record_size)
+{
+  unsigned long k;
+  unsigned long m;
+
+  unsigned long  pid;
+  unsigned long  owner;
+  unsigned long  addr;
+  unsigned long  aligned_size;
+  unsigned long* slot;
+
+  /* this stores the record for the file from the last find */
+  if ((S_cache_map == NULL) || (S_cache_key == 0))
+    return 1;
+
+  if ((record == NULL) || (record_size == 0))
+    return 1;
+
+  pid = getpid();
+
+  /* claim a slot for the key */
+  for (k = 0; k < CACHE_NUM_SLOTS; k++)
+  {
+    m = (S_cache_key + k) % CACHE_NUM_SLOTS;
+    slot = &S_cache_slots[CACHE_SLOT_WORDS * m];
+
+    if (__sync_bool_compare_and_swap(&slot[CACHE_SLOT_KEY], 0UL, S_cache_key))
+    {
+      slot[CACHE_SLOT_OWNER] = pid;
+      break;
+    }
+
+    if (slot[CACHE_SLOT_KEY] != S_cache_key)
+      continue;
+
+    /* a ready record is this file's, unless the hash collided */
+    if (slot[CACHE_SLOT_SIZE] != 0)
+    {
+      __sync_synchronize();
+
+      if ((slot[CACHE_SLOT_FILE_SIZE] == S_cache_file_size) &&
+          !cache_compare_file(S_cache_filename, &S_cache_data[slot[CACHE_SLOT_ADDR]], S_cache_file_size))
+      {
+        cache_add_file_slot(m + 1);
+        return 0;
+      }
+
+      continue;
+    }
+
+    /* another process is writing this record, */
+    /* so take it over only if that process exited */
+    owner = slot[CACHE_SLOT_OWNER];
+
+    if (cache_owner_alive(owner))
+      return 0;
+
+    if (__sync_bool_compare_and_swap(&slot[CACHE_SLOT_OWNER], owner, pid))
+      break;
+
+    return 0;
+  }
+
+  if (k == CACHE_NUM_SLOTS)
+    return 1;
+
+  /* reserve space in the data block for the file and the record */
+  aligned_size = CACHE_ALIGN(S_cache_file_size) + CACHE_ALIGN(record_size);
+
+  addr = __sync_fetch_and_add(&S_cache_header[CACHE_HEADER_DATA_USED], aligned_size);
+
+  /* if the cache is full (or the file changed since it was hashed), */
+  /* the slot is left claimed, until this process exits              */
+  if (addr + aligned_size > CACHE_DATA_SIZE)
+    return 1;
+
+  if (cache_copy_file(S_cache_filename, &S_cache_data[addr], S_cache_file_size))
+    return 1;
+
+  memcpy(&S_cache_data[addr + CACHE_ALIGN(S_cache_file_size)], record, record_size);
+
+  /* publish the record (the size is written last) */
+  slot[CACHE_SLOT_FILE_SIZE] = S_cache_file_size;
+  slot[CACHE_SLOT_ADDR] = addr;
+
+  __sync_synchronize();
+
+  slot[CACHE_SLOT_SIZE] = record_size;
+
+  cache_add_file_slot(m + 1);
+
+  return 0;
+}
@@ -0,0 +1,18 @@
+/******************************************************************************/
+/* cache.h (decoded asset cache)                                              */
+/******************************************************************************/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+extern __thread unsigned char* G_cache_record;
+extern __thread unsigned long  G_cache_record_size;
+
+/* function declarations */
+int cache_open(char* folder);
+int cache_close();
+
+int cache_find(char* filename);
+int cache_store(unsigned char* record, unsigned long record_size);
+
+#endif
@@ -2,14 +2,25 @@
 /* comp.c (compile the rom folder)                                            */
 /******************************************************************************/
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
 #include "comp.h"
 
 #include "art.h"
+#include "con.h"
+#include "mem.h"
+#include "rom.h"
+#include "stats.h"
+#include "trace.h"
 
 /* character macros */
 #define COMP_CHARACTER_IS_UPPERCASE(c)                                         \
@@ -37,20 +48,121 @@
 enum
 {
   COMP_FOLDER_SPRITES = 0, 
+  COMP_FOLDER_BACKGROUNDS, 
   COMP_NUM_FOLDERS 
 };
 
 static const char* S_comp_folder_names[COMP_NUM_FOLDERS] = 
-  { "Sprites" 
+  { "Sprites", 
+    "Backgrounds" 
+  };
+
+static const unsigned char S_comp_folder_required[COMP_NUM_FOLDERS] = 
+  { 1, 
+    0 
   };
 
 /* paths */
 #define COMP_PATH_MAX_SIZE 1024
 
-static char S_comp_root_path_buf[COMP_PATH_MAX_SIZE];
-static char S_comp_folder_path_buf[COMP_PATH_MAX_SIZE];
-static char S_comp_subfolder_path_buf[COMP_PATH_MAX_SIZE];
-static char S_comp_file_path_buf[COMP_PATH_MAX_SIZE];
+static __thread char S_comp_root_path_buf[COMP_PATH_MAX_SIZE];
+static __thread char S_comp_folder_path_buf[COMP_PATH_MAX_SIZE];
+static __thread char S_comp_subfolder_path_buf[COMP_PATH_MAX_SIZE];
+static __thread char S_comp_file_path_buf[COMP_PATH_MAX_SIZE];
+
+/* angle sets (files named <sprite>_<direction>.gif) */
+#define COMP_MAX_ANGLES 8
+
+static const char* S_comp_angle_names[COMP_MAX_ANGLES] = 
+  { "e", "ne", "n", "nw", "w", "sw", "s", "se" 
+  };
+
+static __thread char  S_comp_angle_path_bufs[COMP_MAX_ANGLES][COMP_PATH_MAX_SIZE];
+static __thread char* S_comp_angle_paths[COMP_MAX_ANGLES];
+
+/* file names in the current subfolder */
+#define COMP_MAX_FILES      4096
+#define COMP_NAME_BUF_SIZE  (COMP_MAX_FILES * 64)
+
+static __thread char*          S_comp_name_buf;
+static __thread unsigned long  S_comp_name_buf_size;
+
+static __thread unsigned long* S_comp_name_offsets;
+static __thread unsigned char  S_comp_name_used[COMP_MAX_FILES];
+static __thread unsigned short S_comp_num_names;
+
+/* subfolder names in the current folder (sorted, and kept */
+/* apart, since each subfolder gathers its own file names) */
+static __thread char*          S_comp_subfolder_name_buf;
+
+/* while a subfolder is being decoded, a helper thread asks the */
+/* kernel to read ahead all of its files, so that file reads     */
+/* (on slow or network volumes) overlap with the decoding        */
+struct comp_prefetch
+{
+  char*          folder_path;
+  char*          name_buf;
+  unsigned long* name_offsets;
+  unsigned short num_names;
+};
+
+static __thread struct comp_prefetch S_comp_prefetch;
+static __thread pthread_t            S_comp_prefetch_thread;
+static __thread unsigned char        S_comp_prefetch_active;
+
+/* estimate mode (gif headers only) */
+static __thread unsigned char  S_comp_estimate_flag;
+static __thread unsigned long  S_comp_estimate_bytes;
+static __thread unsigned char  S_comp_estimate_exceeded;
+static __thread unsigned char  S_comp_estimate_failed;
+
+/* the large buffers are owned by the packer context, */
+/* which binds them to the thread that is using it    */
+#define COMP_BUFFER_BYTES(num, type)                                           \
+  ((((num) * sizeof(type)) + 7) & ~7UL)
+
+/******************************************************************************/
+/* comp_buffers_size()                                                        */
+/******************************************************************************/
+unsigned long comp_buffers_size()
+{
+  return
+    COMP_BUFFER_BYTES(COMP_NAME_BUF_SIZE, char) +
+    COMP_BUFFER_BYTES(COMP_MAX_FILES, unsigned long) +
+    COMP_BUFFER_BYTES(COMP_NAME_BUF_SIZE, char);
+}
+
+/******************************************************************************/
+/* comp_bind_buffers()                                                        */
+/******************************************************************************/
+int comp_bind_buffers(unsigned char* buf)
+{
+  if (buf == NULL)
+    return 1;
+
+  S_comp_name_buf = (char*) buf;
+  buf += COMP_BUFFER_BYTES(COMP_NAME_BUF_SIZE, char);
+
+  S_comp_name_offsets = (unsigned long*) buf;
+  buf += COMP_BUFFER_BYTES(COMP_MAX_FILES, unsigned long);
+
+  S_comp_subfolder_name_buf = (char*) buf;
+  buf += COMP_BUFFER_BYTES(COMP_NAME_BUF_SIZE, char);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* comp_print_memory()                                                        */
+/******************************************************************************/
+int comp_print_memory()
+{
+  mem_print_buffer("Folder Names", S_comp_name_buf, COMP_NAME_BUF_SIZE * sizeof(char));
+  mem_print_buffer("Folder Name Offsets", S_comp_name_offsets, COMP_MAX_FILES * sizeof(unsigned long));
+  mem_print_buffer("Subfolder Names", S_comp_subfolder_name_buf, COMP_NAME_BUF_SIZE * sizeof(char));
+
+  return 0;
+}
 
 /******************************************************************************/
 /* comp_reset_parse_vars()                                                    */
@@ -71,24 +183,41 @@ int comp_reset_parse_vars()
   for (k = 0; k < COMP_PATH_MAX_SIZE; k++)
     S_comp_file_path_buf[k] = '\0';
 
+  S_comp_name_buf_size = 0;
+  S_comp_num_names = 0;
+
   return 0;
 }
 
 /******************************************************************************/
-/* comp_parse_subfolder()                                                     */
+/* comp_compare_names()                                                       */
 /******************************************************************************/
-int comp_parse_subfolder(unsigned short folder)
+int comp_compare_names(const void* a, const void* b)
+{
+  return strcmp(&S_comp_name_buf[*((const unsigned long*) a)], 
+                &S_comp_name_buf[*((const unsigned long*) b)]);
+}
+
+/******************************************************************************/
+/* comp_gather_names()                                                        */
+/******************************************************************************/
+int comp_gather_names(char* path)
 {
   DIR* dp;
   struct dirent* e;
 
+  unsigned long len;
+
+  S_comp_name_buf_size = 0;
+  S_comp_num_names = 0;
+
   /* open the directory */
-  dp = opendir(S_comp_subfolder_path_buf);
+  dp = opendir(path);
 
   if (dp == NULL)
     return 1;
 
-  /* check all the files and folders in the directory */
+  /* add all the files in the directory to the list */
   e = readdir(dp);
 
   while (e != NULL)
@@ -100,21 +229,444 @@ int comp_parse_subfolder(unsigned short folder)
       continue;
     }
 
+    len = strlen(e->d_name) + 1;
+
+    if ((S_comp_num_names >= COMP_MAX_FILES) || 
+        (S_comp_name_buf_size + len > COMP_NAME_BUF_SIZE))
+    {
+      closedir(dp);
+      return 1;
+    }
+
+    strcpy(&S_comp_name_buf[S_comp_name_buf_size], e->d_name);
+
+    S_comp_name_offsets[S_comp_num_names] = S_comp_name_buf_size;
+    S_comp_name_used[S_comp_num_names] = 0;
+    S_comp_num_names += 1;
+
+    S_comp_name_buf_size += len;
+
+    e = readdir(dp);
+  }
+
+  /* close the directory */
+  closedir(dp);
+
+  /* sort the names, so the rom layout does not depend on readdir order */
+  qsort(S_comp_name_offsets, S_comp_num_names, sizeof(unsigned long), comp_compare_names);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* comp_prefetch_files()                                                      */
+/******************************************************************************/
+void* comp_prefetch_files(void* arg)
+{
+  struct comp_prefetch* p;
+
+  unsigned short k;
+
+  int  fd;
+  char path[COMP_PATH_MAX_SIZE];
+
+  p = (struct comp_prefetch*) arg;
+
+  TRACE_BEGIN("io", "prefetch");
+
+  /* the names are prefetched in the order they are decoded */
+  for (k = 0; k < p->num_names; k++)
+  {
+    if ((strlen(p->folder_path) + strlen(&p->name_buf[p->name_offsets[k]]) + 1) > COMP_PATH_MAX_SIZE)
+      continue;
+
+    strcpy(path, p->folder_path);
+    strcat(path, &p->name_buf[p->name_offsets[k]]);
+
+    fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+      continue;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+    close(fd);
+  }
+
+  TRACE_END();
+
+  return NULL;
+}
+
+/******************************************************************************/
+/* comp_prefetch_start()                                                      */
+/******************************************************************************/
+int comp_prefetch_start()
+{
+  S_comp_prefetch.folder_path = S_comp_subfolder_path_buf;
+  S_comp_prefetch.name_buf = S_comp_name_buf;
+  S_comp_prefetch.name_offsets = S_comp_name_offsets;
+  S_comp_prefetch.num_names = S_comp_num_names;
+
+  /* if the thread cannot start, the files are just read normally */
+  if (pthread_create(&S_comp_prefetch_thread, NULL, comp_prefetch_files, &S_comp_prefetch))
+    return 1;
+
+  S_comp_prefetch_active = 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* comp_prefetch_finish()                                                     */
+/******************************************************************************/
+int comp_prefetch_finish()
+{
+  /* the name list must not change while the thread is using it */
+  if (S_comp_prefetch_active)
+    pthread_join(S_comp_prefetch_thread, NULL);
+
+  S_comp_prefetch_active = 0;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* comp_find_angle()                                                          */
+/******************************************************************************/
+int comp_find_angle(char* name, unsigned long base_len)
+{
+  unsigned short k;
+
+  unsigned long len;
+  unsigned long dir_len;
+
+  /* returns the angle if the name is <base>_<direction>.gif, */
+  /* where base_len covers the base and the underscore        */
+  len = strlen(name);
+
+  for (k = 0; k < COMP_MAX_ANGLES; k++)
+  {
+    dir_len = strlen(S_comp_angle_names[k]);
+
+    if (len != base_len + dir_len + 4)
+      continue;
+
+    if ((base_len == 0) || (name[base_len - 1] != '_'))
+      continue;
+
+    if (strncmp(&name[base_len], S_comp_angle_names[k], dir_len))
+      continue;
+
+    if (strcmp(&name[base_len + dir_len], ".gif"))
+      continue;
+
+    return k;
+  }
+
+  return COMP_MAX_ANGLES;
+}
+
+/******************************************************************************/
+/* comp_find_angle_set()                                                      */
+/******************************************************************************/
+int comp_find_angle_set(unsigned short index)
+{
+  unsigned short k;
+  unsigned short m;
+
+  char* name;
+  char* other;
+
+  unsigned long  base_len;
+  unsigned short angle;
+  unsigned short num_angles;
+
+  unsigned short members[COMP_MAX_ANGLES];
+
+  /* returns the number of angles (4 or 8) if this file */
+  /* starts a complete angle set, and 0 otherwise       */
+  name = &S_comp_name_buf[S_comp_name_offsets[index]];
+
+  base_len = strlen(name);
+
+  while ((base_len > 0) && (name[base_len - 1] != '_'))
+    base_len -= 1;
+
+  if (comp_find_angle(name, base_len) == COMP_MAX_ANGLES)
+    return 0;
+
+  for (k = 0; k < COMP_MAX_ANGLES; k++)
+    members[k] = S_comp_num_names;
+
+  /* the other angles sort after this one, since they share its base */
+  for (k = index; k < S_comp_num_names; k++)
+  {
+    other = &S_comp_name_buf[S_comp_name_offsets[k]];
+
+    if (strncmp(other, name, base_len))
+      break;
+
+    if (S_comp_name_used[k])
+      continue;
+
+    angle = comp_find_angle(other, base_len);
+
+    if (angle < COMP_MAX_ANGLES)
+      members[angle] = k;
+  }
+
+  /* 8 directions, or 4 directions (e, n, w, s) */
+  num_angles = 0;
+
+  for (k = 0; k < COMP_MAX_ANGLES; k++)
+  {
+    if (members[k] < S_comp_num_names)
+      num_angles += 1;
+  }
+
+  if (num_angles == 4)
+  {
+    for (k = 0; k < COMP_MAX_ANGLES; k += 2)
+      members[k / 2] = members[k];
+
+    for (k = 0; k < 4; k++)
+    {
+      if (members[k] >= S_comp_num_names)
+        return 0;
+    }
+  }
+  else if (num_angles != 8)
+    return 0;
+
+  /* assemble the file paths, in angle order */
+  for (k = 0; k < num_angles; k++)
+  {
+    m = members[k];
+
+    strcpy(S_comp_angle_path_bufs[k], S_comp_subfolder_path_buf);
+    strcat(S_comp_angle_path_bufs[k], &S_comp_name_buf[S_comp_name_offsets[m]]);
+
+    S_comp_angle_paths[k] = S_comp_angle_path_bufs[k];
+    S_comp_name_used[m] = 1;
+  }
+
+  return num_angles;
+}
+
+/******************************************************************************/
+/* comp_compare_name_key()                                                    */
+/******************************************************************************/
+int comp_compare_name_key(const void* key, const void* elem)
+{
+  return strcmp((const char*) key, 
+                &S_comp_name_buf[*((const unsigned long*) elem)]);
+}
+
+/******************************************************************************/
+/* comp_name_has_extension()                                                  */
+/******************************************************************************/
+int comp_name_has_extension(char* name, const char* ext)
+{
+  unsigned long len;
+  unsigned long ext_len;
+
+  len = strlen(name);
+  ext_len = strlen(ext);
+
+  if (len <= ext_len)
+    return 0;
+
+  if (strcmp(&name[len - ext_len], ext))
+    return 0;
+
+  return 1;
+}
+
+/******************************************************************************/
+/* comp_gif_has_sidecar()                                                     */
+/******************************************************************************/
+int comp_gif_has_sidecar(char* name)
+{
+  unsigned long len;
+
+  /* a sheet gif is loaded by the con file with the same name */
+  if (!comp_name_has_extension(name, ".gif"))
+    return 0;
+
+  len = strlen(name);
+
+  if (len >= COMP_PATH_MAX_SIZE)
+    return 0;
+
+  strcpy(S_comp_file_path_buf, name);
+  strcpy(&S_comp_file_path_buf[len - 4], ".con");
+
+  if (bsearch( S_comp_file_path_buf, S_comp_name_offsets, S_comp_num_names, 
+               sizeof(unsigned long), comp_compare_name_key) == NULL)
+  {
+    return 0;
+  }
+
+  return 1;
+}
+
+/******************************************************************************/
+/* comp_parse_subfolder()                                                     */
+/******************************************************************************/
+int comp_parse_subfolder(unsigned short folder)
+{
+  unsigned short k;
+  unsigned short m;
+
+  unsigned short num_angles;
+
+  char* name;
+
+  int result;
+
+  /* obtain the sorted list of files */
+  STATS_BEGIN(STATS_PHASE_SCAN);
+
+  if (comp_gather_names(S_comp_subfolder_path_buf))
+    return 1;
+
+  STATS_END(STATS_PHASE_SCAN);
+
+  /* start reading the files ahead of the decoder */
+  if (!S_comp_estimate_flag)
+    comp_prefetch_start();
+
+  for (k = 0; k < S_comp_num_names; k++)
+  {
+    if (S_comp_name_used[k])
+      continue;
+
+    name = &S_comp_name_buf[S_comp_name_offsets[k]];
+
+    /* when estimating, each gif is counted by itself, and */
+    /* each sheet by the slices its con file names         */
+    if (S_comp_estimate_flag)
+    {
+      S_comp_name_used[k] = 1;
+
+      if ((folder == COMP_FOLDER_SPRITES) && comp_gif_has_sidecar(name))
+        continue;
+
+      strcpy(S_comp_file_path_buf, S_comp_subfolder_path_buf);
+      strcat(S_comp_file_path_buf, name);
+
+      if ((folder == COMP_FOLDER_SPRITES) && comp_name_has_extension(name, ".con"))
+        result = con_estimate_file(S_comp_file_path_buf);
+      else if (!comp_name_has_extension(name, ".gif"))
+        continue;
+      else if (folder == COMP_FOLDER_SPRITES)
+        result = art_estimate_gif(S_comp_file_path_buf);
+      else if (folder == COMP_FOLDER_BACKGROUNDS)
+        result = art_estimate_background(S_comp_file_path_buf);
+      else
+        result = 0;
+
+      /* the estimate goes on, but cannot be trusted */
+      if (result)
+      {
+        printf("Could not estimate: %s\n", S_comp_file_path_buf);
+        S_comp_estimate_failed = 1;
+      }
+
+      continue;
+    }
+
+    /* skip sheets, since their con file loads them */
+    if ((folder == COMP_FOLDER_SPRITES) && comp_gif_has_sidecar(name))
+      continue;
+
+    /* load an angle set */
+    if (folder == COMP_FOLDER_SPRITES)
+    {
+      num_angles = comp_find_angle_set(k);
+
+      if (num_angles > 0)
+      {
+        for (m = 0; m < num_angles; m++)
+          printf("File Path: %s\n", S_comp_angle_paths[m]);
+
+        TRACE_BEGIN("file", S_comp_angle_paths[0]);
+        result = art_load_gif_angles(S_comp_angle_paths, num_angles);
+        TRACE_END();
+
+        if (result)
+        {
+          printf("Could not load: %s\n", S_comp_angle_paths[0]);
+          goto nope;
+        }
+
+        continue;
+      }
+    }
+
     /* assemble file path */
     strcpy(S_comp_file_path_buf, S_comp_subfolder_path_buf);
-    strcat(S_comp_file_path_buf, e->d_name);
+    strcat(S_comp_file_path_buf, name);
 
     printf("File Path: %s\n", S_comp_file_path_buf);
 
     /* load the file */
-    if (folder == COMP_FOLDER_SPRITES)
-      art_load_gif(S_comp_file_path_buf);
+    TRACE_BEGIN("file", S_comp_file_path_buf);
+
+    if ((folder == COMP_FOLDER_SPRITES) && comp_name_has_extension(name, ".con"))
+      result = con_load_file(S_comp_file_path_buf);
+    else if (folder == COMP_FOLDER_SPRITES)
+      result = art_load_gif(S_comp_file_path_buf);
+    else if (folder == COMP_FOLDER_BACKGROUNDS)
+      result = art_load_background(S_comp_file_path_buf);
+    else
+      result = 0;
+
+    TRACE_END();
+
+    /* a file that does not load fails the whole pack, */
+    /* rather than leaving a rom without it            */
+    if (result)
+    {
+      printf("Could not load: %s\n", S_comp_file_path_buf);
+      goto nope;
+    }
 
-    e = readdir(dp);
+    S_comp_name_used[k] = 1;
   }
 
-  /* close the directory */
-  closedir(dp);
+  comp_prefetch_finish();
+
+  return 0;
+
+nope:
+  comp_prefetch_finish();
+  return 1;
+}
+
+/******************************************************************************/
+/* comp_report_estimate()                                                     */
+/******************************************************************************/
+int comp_report_estimate(unsigned short folder)
+{
+  unsigned long num_bytes;
+
+  int exceeded;
+
+  printf("Estimate For: %s\n", S_comp_folder_names[folder]);
+
+  if (folder == COMP_FOLDER_SPRITES)
+    exceeded = art_report_estimate(&num_bytes);
+  else if (folder == COMP_FOLDER_BACKGROUNDS)
+    exceeded = art_report_bg_estimate(&num_bytes);
+  else
+    return 1;
+
+  S_comp_estimate_bytes += num_bytes;
+
+  if (exceeded)
+    S_comp_estimate_exceeded = 1;
 
   return 0;
 }
@@ -124,49 +676,75 @@ int comp_parse_subfolder(unsigned short folder)
 /******************************************************************************/
 int comp_parse_folder(unsigned short folder)
 {
-  DIR* dp;
-  struct dirent* e;
+  unsigned short k;
+  unsigned short num_subfolders;
 
-  /* open the directory */
-  dp = opendir(S_comp_folder_path_buf);
+  char* name;
 
-  if (dp == NULL)
+  unsigned long num_bytes;
+
+  int result;
+
+  /* obtain the sorted list of subfolders, so the rom */
+  /* layout does not depend on readdir order either   */
+  if (comp_gather_names(S_comp_folder_path_buf))
     return 1;
 
+  num_bytes = 0;
+
+  for (k = 0; k < S_comp_num_names; k++)
+  {
+    name = &S_comp_name_buf[S_comp_name_offsets[k]];
+
+    strcpy(&S_comp_subfolder_name_buf[num_bytes], name);
+    num_bytes += strlen(name) + 1;
+  }
+
+  num_subfolders = S_comp_num_names;
+
   /* reset data buffers for this folder */
-  if (folder == COMP_FOLDER_SPRITES)
+  if (S_comp_estimate_flag)
+    art_clear_estimate_vars();
+  else if (folder == COMP_FOLDER_SPRITES)
     art_clear_rom_data_vars();
+  else if (folder == COMP_FOLDER_BACKGROUNDS)
+    art_clear_bg_data_vars();
 
-  /* check all the files and folders in the directory */
-  e = readdir(dp);
+  /* parse each subfolder */
+  name = S_comp_subfolder_name_buf;
 
-  while (e != NULL)
+  for (k = 0; k < num_subfolders; k++)
   {
-    /* skip dot, dot-dot, and hidden files */
-    if (e->d_name[0] == '.')
-    {
-      e = readdir(dp);
-      continue;
-    }
-
-    /* parse subfolder */
     strcpy(S_comp_subfolder_path_buf, S_comp_folder_path_buf);
-    strcat(S_comp_subfolder_path_buf, e->d_name);
+    strcat(S_comp_subfolder_path_buf, name);
     strcat(S_comp_subfolder_path_buf, "/");
 
     printf("Subfolder Path: %s\n", S_comp_subfolder_path_buf);
 
-    comp_parse_subfolder(folder);
+    if (comp_parse_subfolder(folder))
+      return 1;
 
-    e = readdir(dp);
+    name += strlen(name) + 1;
   }
 
   /* write folder files to the rom */
-  if (folder == COMP_FOLDER_SPRITES)
-    art_add_chunks_to_rom();
+  TRACE_BEGIN("rom", "chunk layout");
 
-  /* close the directory */
-  closedir(dp);
+  rom_set_chunk_owner(S_comp_folder_path_buf);
+
+  if (S_comp_estimate_flag)
+    result = comp_report_estimate(folder);
+  else if (folder == COMP_FOLDER_SPRITES)
+    result = art_add_chunks_to_rom();
+  else if (folder == COMP_FOLDER_BACKGROUNDS)
+    result = art_add_bg_chunks_to_rom();
+  else
+    result = 0;
+
+  TRACE_END();
+
+  if (result)
+    return 1;
 
   return 0;
 }
@@ -182,6 +760,8 @@ int comp_parse_root()
   unsigned short k;
   unsigned char  is_present[COMP_NUM_FOLDERS];
 
+  int result;
+
   /* open the directory */
   dp = opendir(S_comp_root_path_buf);
 
@@ -219,7 +799,7 @@ int comp_parse_root()
   /* make sure all necessary files and folders are present */
   for (k = 0; k < COMP_NUM_FOLDERS; k++)
   {
-    if (is_present[k] == 0)
+    if ((is_present[k] == 0) && S_comp_folder_required[k])
       goto nope;
   }
 
@@ -229,13 +809,21 @@ int comp_parse_root()
   /* parse the folders! (and the startup ini) */
   for (k = 0; k < COMP_NUM_FOLDERS; k++)
   {
+    if (is_present[k] == 0)
+      continue;
+
     strcpy(S_comp_folder_path_buf, S_comp_root_path_buf);
     strcat(S_comp_folder_path_buf, S_comp_folder_names[k]);
     strcat(S_comp_folder_path_buf, "/");
 
     printf("Folder Path: %s\n", S_comp_folder_path_buf);
 
-    comp_parse_folder(k);
+    TRACE_BEGIN("folder", S_comp_folder_path_buf);
+    result = comp_parse_folder(k);
+    TRACE_END();
+
+    if (result)
+      return 1;
   }
 
   goto ok;
@@ -298,8 +886,37 @@ int comp_pack_rom(char* name)
   printf("Root Path: %s\n", S_comp_root_path_buf);
 
   /* parse the root folder */
-  comp_parse_root();
+  if (comp_parse_root())
+    return 1;
 
   return 0;
 }
 
+/******************************************************************************/
+/* comp_estimate_rom()                                                        */
+/******************************************************************************/
+int comp_estimate_rom(char* name)
+{
+  int result;
+
+  S_comp_estimate_flag = 1;
+  S_comp_estimate_bytes = 0;
+  S_comp_estimate_exceeded = 0;
+  S_comp_estimate_failed = 0;
+
+  /* walk the folders like a pack, but only read the gif headers */
+  result = comp_pack_rom(name);
+
+  S_comp_estimate_flag = 0;
+
+  if (result)
+    return 1;
+
+  if (rom_report_estimate(S_comp_estimate_bytes))
+    S_comp_estimate_exceeded = 1;
+
+  if (S_comp_estimate_failed)
+    return 1;
+
+  return S_comp_estimate_exceeded;
+}
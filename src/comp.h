@@ -6,9 +6,14 @@
 #define COMP_H
 
 /* function declarations */
+unsigned long comp_buffers_size();
+int comp_bind_buffers(unsigned char* buf);
+int comp_print_memory();
+
 int comp_reset_parse_vars();
 
 int comp_pack_rom(char* name);
+int comp_estimate_rom(char* name);
 
 #endif
 
@@ -17,6 +17,7 @@ enum
   CON_TOKEN_ERROR, 
   /* top level tables */
   CON_TOKEN_SPRITESET, 
+  CON_TOKEN_SHEET, 
   /* spriteset fields */
   CON_TOKEN_SPRITE, 
   /* common fields */
@@ -57,12 +58,20 @@ enum
   ((con_advance_token()) || (S_con_token != expected))
 
 #define CON_STRING_MAX_SIZE 256
+#define CON_PATH_MAX_SIZE   1024
 
 /* file pointer variables */
-static FILE*          S_con_fp;
-static unsigned short S_con_token;
-static char           S_con_string_buf[CON_STRING_MAX_SIZE + 1];
-static unsigned short S_con_string_size;
+static __thread FILE*          S_con_fp;
+static __thread unsigned short S_con_token;
+static __thread char           S_con_string_buf[CON_STRING_MAX_SIZE + 1];
+static __thread unsigned short S_con_string_size;
+
+/* filenames in the con file are relative to its folder */
+static __thread char           S_con_path_buf[CON_PATH_MAX_SIZE];
+static __thread unsigned short S_con_folder_size;
+
+/* estimate mode (the files are counted, not loaded) */
+static __thread unsigned char  S_con_estimate_flag;
 
 /******************************************************************************/
 /* con_clear_parse_vars()                                                     */
@@ -79,6 +88,11 @@ int con_clear_parse_vars()
 
   S_con_string_size = 0;
 
+  for (k = 0; k < CON_PATH_MAX_SIZE; k++)
+    S_con_path_buf[k] = '\0';
+
+  S_con_folder_size = 0;
+
   return 0;
 }
 
@@ -124,6 +138,8 @@ int con_advance_token()
     /* check if this identifier is a defined keyword */
     if (!strcmp(S_con_string_buf, "spriteset"))
       S_con_token = CON_TOKEN_SPRITESET;
+    else if (!strcmp(S_con_string_buf, "sheet"))
+      S_con_token = CON_TOKEN_SHEET;
     else if (!strcmp(S_con_string_buf, "sprite"))
       S_con_token = CON_TOKEN_SPRITE;
     else
@@ -208,6 +224,21 @@ int con_advance_token()
   return 0;
 }
 
+/******************************************************************************/
+/* con_assemble_path()                                                        */
+/******************************************************************************/
+int con_assemble_path()
+{
+  /* add the filename in the string buffer onto the folder path */
+  if ((S_con_folder_size + strlen(S_con_string_buf) + 1) > CON_PATH_MAX_SIZE)
+    return 1;
+
+  S_con_path_buf[S_con_folder_size] = '\0';
+  strcat(S_con_path_buf, S_con_string_buf);
+
+  return 0;
+}
+
 /******************************************************************************/
 /* con_parse_sprite()                                                         */
 /******************************************************************************/
@@ -225,7 +256,14 @@ int con_parse_sprite()
 
   printf("Sprite Filename: %s\n", S_con_string_buf);
 
-  art_load_gif(S_con_string_buf);
+  if (con_assemble_path())
+    return 1;
+
+  if (S_con_estimate_flag)
+    return art_estimate_gif(S_con_path_buf);
+
+  if (art_load_gif(S_con_path_buf))
+    return 1;
 
   return 0;
 }
@@ -246,7 +284,8 @@ int con_parse_spriteset()
     return 1;
 
   /* read sprites */
-  art_clear_rom_data_vars();
+  if (!S_con_estimate_flag)
+    art_clear_rom_data_vars();
 
   if (con_advance_token())
     return 1;
@@ -261,7 +300,91 @@ int con_parse_spriteset()
       return 1;
   }
 
-  art_add_chunks_to_rom();
+  if ((!S_con_estimate_flag) && art_add_chunks_to_rom())
+    return 1;
+
+  /* check closing curly brace */
+  if (S_con_token != CON_TOKEN_CLOSE_CURLY_BRACE)
+    return 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* con_parse_sheet()                                                          */
+/******************************************************************************/
+int con_parse_sheet()
+{
+  unsigned short cell_w;
+  unsigned short cell_h;
+  unsigned short slot;
+
+  /* read name */
+  if (CON_ADVANCE_AND_CHECK_TOKEN(CON_TOKEN_NAME))
+    return 1;
+
+  printf("Sheet Name: %s\n", S_con_string_buf);
+
+  /* read filename */
+  if (CON_ADVANCE_AND_CHECK_TOKEN(CON_TOKEN_FILENAME))
+    return 1;
+
+  printf("Sheet Filename: %s\n", S_con_string_buf);
+
+  if (con_assemble_path())
+    return 1;
+
+  /* read grid cell width and height */
+  if (CON_ADVANCE_AND_CHECK_TOKEN(CON_TOKEN_INTEGER))
+    return 1;
+
+  cell_w = (unsigned short) atoi(S_con_string_buf);
+
+  if (CON_ADVANCE_AND_CHECK_TOKEN(CON_TOKEN_INTEGER))
+    return 1;
+
+  cell_h = (unsigned short) atoi(S_con_string_buf);
+
+  /* read opening curly brace */
+  if (CON_ADVANCE_AND_CHECK_TOKEN(CON_TOKEN_OPEN_CURLY_BRACE))
+    return 1;
+
+  /* decode the sheet once (or just read its headers) */
+  if (S_con_estimate_flag)
+  {
+    if (art_estimate_sheet(S_con_path_buf, cell_w, cell_h))
+      return 1;
+  }
+  else if (art_load_sheet(S_con_path_buf, cell_w, cell_h))
+    return 1;
+
+  /* read sprites (each one takes the next grid cell) */
+  slot = 0;
+
+  if (con_advance_token())
+    return 1;
+
+  while (S_con_token == CON_TOKEN_SPRITE)
+  {
+    if (CON_ADVANCE_AND_CHECK_TOKEN(CON_TOKEN_NAME))
+      return 1;
+
+    printf("Sprite Name: %s\n", S_con_string_buf);
+
+    if (S_con_estimate_flag)
+    {
+      if (art_estimate_sheet_sprite(slot))
+        return 1;
+    }
+    else if (art_add_sheet_sprite(slot, S_con_string_buf))
+      return 1;
+
+    slot += 1;
+
+    /* read next sprite, or closing curly brace */
+    if (con_advance_token())
+      return 1;
+  }
 
   /* check closing curly brace */
   if (S_con_token != CON_TOKEN_CLOSE_CURLY_BRACE)
@@ -282,6 +405,18 @@ int con_load_file(char* filename)
   /* reset file-related variables */
   con_clear_parse_vars();
 
+  /* determine the folder of the con file */
+  S_con_folder_size = strlen(filename);
+
+  while ((S_con_folder_size > 0) && (filename[S_con_folder_size - 1] != '/'))
+    S_con_folder_size -= 1;
+
+  if (S_con_folder_size >= CON_PATH_MAX_SIZE)
+    return 1;
+
+  strncpy(S_con_path_buf, filename, S_con_folder_size);
+  S_con_path_buf[S_con_folder_size] = '\0';
+
   /* open the file */
   S_con_fp = fopen(filename, "rb");
 
@@ -296,11 +431,19 @@ int con_load_file(char* filename)
     if (con_advance_token())
       goto nope;
 
+    if (S_con_token == CON_TOKEN_EOF)
+      break;
+
     if (S_con_token == CON_TOKEN_SPRITESET)
     {
       if (con_parse_spriteset())
         goto nope;
     }
+    else if (S_con_token == CON_TOKEN_SHEET)
+    {
+      if (con_parse_sheet())
+        goto nope;
+    }
     else
       goto nope;
   }
@@ -318,3 +461,20 @@ ok:
   return 0;
 }
 
+
+/******************************************************************************/
+/* con_estimate_file()                                                        */
+/******************************************************************************/
+int con_estimate_file(char* filename)
+{
+  int result;
+
+  /* parse the file like a load, but only count what it would add */
+  S_con_estimate_flag = 1;
+
+  result = con_load_file(filename);
+
+  S_con_estimate_flag = 0;
+
+  return result;
+}
@@ -9,6 +9,7 @@
 int con_clear_parse_vars();
 
 int con_load_file(char* filename);
+int con_estimate_file(char* filename);
 
 #endif
 
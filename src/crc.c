@@ -0,0 +1,189 @@
+/******************************************************************************/
+/* crc.c (crc-32 checksums)                                                   */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include "crc.h"
+
+/* the standard crc-32 (as in zip and png), computed 8 bytes at a */
+/* time with 8 tables ("slicing-by-8"), so it runs at several     */
+/* bytes per cycle instead of one                                 */
+#define CRC_POLYNOMIAL   0xEDB88320UL
+#define CRC_NUM_TABLES   8
+
+/* combining works on 32x32 bit matrices over gf(2) */
+#define CRC_MATRIX_ROWS  32
+
+static unsigned long  S_crc_tables[CRC_NUM_TABLES][256];
+static pthread_once_t S_crc_tables_once = PTHREAD_ONCE_INIT;
+
+/******************************************************************************/
+/* crc_make_tables()                                                          */
+/******************************************************************************/
+void crc_make_tables()
+{
+  unsigned long k;
+  unsigned long m;
+  unsigned long val;
+
+  for (k = 0; k < 256; k++)
+  {
+    val = k;
+
+    for (m = 0; m < 8; m++)
+      val = (val & 1) ? (CRC_POLYNOMIAL ^ (val >> 1)) : (val >> 1);
+
+    S_crc_tables[0][k] = val;
+  }
+
+  /* table n advances a byte through n more zero bytes */
+  for (k = 0; k < 256; k++)
+  {
+    for (m = 1; m < CRC_NUM_TABLES; m++)
+    {
+      val = S_crc_tables[m - 1][k];
+      S_crc_tables[m][k] = S_crc_tables[0][val & 0xFF] ^ (val >> 8);
+    }
+  }
+}
+
+/******************************************************************************/
+/* crc_32()                                                                   */
+/******************************************************************************/
+unsigned long crc_32(unsigned char* data, unsigned long num_bytes)
+{
+  unsigned long crc;
+
+  if (data == NULL)
+    return 0;
+
+  /* the tables are built once, by whichever thread gets here first */
+  pthread_once(&S_crc_tables_once, crc_make_tables);
+
+  crc = 0xFFFFFFFFUL;
+
+  /* the bytes are combined explicitly, so this works at any alignment */
+  while (num_bytes >= 8)
+  {
+    crc ^= (unsigned long) data[0] |
+           ((unsigned long) data[1] << 8) |
+           ((unsigned long) data[2] << 16) |
+           ((unsigned long) data[3] << 24);
+
+    crc = S_crc_tables[7][crc & 0xFF] ^
+          S_crc_tables[6][(crc >> 8) & 0xFF] ^
+          S_crc_tables[5][(crc >> 16) & 0xFF] ^
+          S_crc_tables[4][(crc >> 24) & 0xFF] ^
+          S_crc_tables[3][data[4]] ^
+          S_crc_tables[2][data[5]] ^
+          S_crc_tables[1][data[6]] ^
+          S_crc_tables[0][data[7]];
+
+    data += 8;
+    num_bytes -= 8;
+  }
+
+  while (num_bytes > 0)
+  {
+    crc = S_crc_tables[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+
+    data += 1;
+    num_bytes -= 1;
+  }
+
+  return crc ^ 0xFFFFFFFFUL;
+}
+
+/******************************************************************************/
+/* crc_matrix_times()                                                         */
+/******************************************************************************/
+unsigned long crc_matrix_times(unsigned long* matrix, unsigned long vec)
+{
+  unsigned long sum;
+
+  sum = 0;
+
+  while (vec)
+  {
+    if (vec & 1)
+      sum ^= *matrix;
+
+    vec >>= 1;
+    matrix += 1;
+  }
+
+  return sum;
+}
+
+/******************************************************************************/
+/* crc_matrix_square()                                                        */
+/******************************************************************************/
+void crc_matrix_square(unsigned long* square, unsigned long* matrix)
+{
+  int k;
+
+  for (k = 0; k < CRC_MATRIX_ROWS; k++)
+    square[k] = crc_matrix_times(matrix, matrix[k]);
+}
+
+/******************************************************************************/
+/* crc_32_combine()                                                           */
+/******************************************************************************/
+unsigned long crc_32_combine(unsigned long crc_1, unsigned long crc_2, unsigned long num_bytes_2)
+{
+  unsigned long even[CRC_MATRIX_ROWS];
+  unsigned long odd[CRC_MATRIX_ROWS];
+  unsigned long row;
+
+  int k;
+
+  /* the crc of two blocks back to back is the first crc advanced */
+  /* through as many zero bytes as the second block has, xored    */
+  /* with the second crc (the zeros are applied by repeatedly     */
+  /* squaring the one zero bit operator, as zlib does)            */
+  if (num_bytes_2 == 0)
+    return crc_1;
+
+  odd[0] = CRC_POLYNOMIAL;
+  row = 1;
+
+  for (k = 1; k < CRC_MATRIX_ROWS; k++)
+  {
+    odd[k] = row;
+    row <<= 1;
+  }
+
+  /* two zero bits, then four */
+  crc_matrix_square(even, odd);
+  crc_matrix_square(odd, even);
+
+  /* each pass doubles the zeros (the first one is a byte) */
+  do
+  {
+    crc_matrix_square(even, odd);
+
+    if (num_bytes_2 & 1)
+      crc_1 = crc_matrix_times(even, crc_1);
+
+    num_bytes_2 >>= 1;
+
+    if (num_bytes_2 == 0)
+      break;
+
+    crc_matrix_square(odd, even);
+
+    if (num_bytes_2 & 1)
+      crc_1 = crc_matrix_times(odd, crc_1);
+
+    num_bytes_2 >>= 1;
+  } while (num_bytes_2 != 0);
+
+  return crc_1 ^ crc_2;
+}
@@ -0,0 +1,12 @@
+/******************************************************************************/
+/* crc.h (crc-32 checksums)                                                   */
+/******************************************************************************/
+
+#ifndef CRC_H
+#define CRC_H
+
+/* function declarations */
+unsigned long crc_32(unsigned char* data, unsigned long num_bytes);
+unsigned long crc_32_combine(unsigned long crc_1, unsigned long crc_2, unsigned long num_bytes_2);
+
+#endif
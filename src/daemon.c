@@ -0,0 +1,396 @@
+/******************************************************************************/
+/* daemon.c (pack requests from a unix socket)                                */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+
+#include "kunopack.h"
+#include "trace.h"
+
+/* request format (one per line, any number per connection) */
+/*   pack <root> <rom> [--trim] [--metasprites]             */
+/* reply format                                             */
+/*   ok <rom bytes>                                         */
+/*   error <message>                                        */
+
+/* the socket is only open to the daemon's user, and roms */
+/* can only be written below the daemon's working folder  */
+
+/* the packer contexts are kept between requests, and the */
+/* decoded asset cache is shared by all of the clients    */
+#define DAEMON_MAX_CLIENTS      16
+
+#define DAEMON_LINE_MAX_SIZE    2048
+#define DAEMON_MAX_ARGS         8
+
+/* wait before accepting again when out of descriptors, etc */
+#define DAEMON_ACCEPT_BACKOFF_MS 100
+
+static kp_context*    S_daemon_contexts[DAEMON_MAX_CLIENTS];
+static unsigned char  S_daemon_context_used[DAEMON_MAX_CLIENTS];
+
+static pthread_mutex_t S_daemon_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/******************************************************************************/
+/* daemon_claim_context()                                                     */
+/******************************************************************************/
+int daemon_claim_context()
+{
+  int k;
+
+  pthread_mutex_lock(&S_daemon_mutex);
+
+  for (k = 0; k < DAEMON_MAX_CLIENTS; k++)
+  {
+    if (S_daemon_context_used[k])
+      continue;
+
+    if (S_daemon_contexts[k] == NULL)
+      S_daemon_contexts[k] = kp_context_create();
+
+    if (S_daemon_contexts[k] == NULL)
+      break;
+
+    S_daemon_context_used[k] = 1;
+
+    pthread_mutex_unlock(&S_daemon_mutex);
+
+    return k;
+  }
+
+  pthread_mutex_unlock(&S_daemon_mutex);
+
+  return -1;
+}
+
+/******************************************************************************/
+/* daemon_release_context()                                                   */
+/******************************************************************************/
+int daemon_release_context(int index)
+{
+  if ((index < 0) || (index >= DAEMON_MAX_CLIENTS))
+    return 1;
+
+  pthread_mutex_lock(&S_daemon_mutex);
+
+  S_daemon_context_used[index] = 0;
+
+  pthread_mutex_unlock(&S_daemon_mutex);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* daemon_reply()                                                             */
+/******************************************************************************/
+int daemon_reply(int fd, char* line)
+{
+  unsigned long num_bytes;
+  long          result;
+
+  num_bytes = 0;
+
+  while (num_bytes < strlen(line))
+  {
+    result = write(fd, &line[num_bytes], strlen(line) - num_bytes);
+
+    if ((result < 0) && (errno == EINTR))
+      continue;
+
+    /* a client that has gone away (EPIPE) just ends its connection */
+    if (result <= 0)
+      return 1;
+
+    num_bytes += result;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* daemon_check_rom_filename()                                                */
+/******************************************************************************/
+int daemon_check_rom_filename(char* filename)
+{
+  char* part;
+
+  /* the name must be relative, and must not climb out with ".." */
+  if ((filename[0] == '\0') || (filename[0] == '/'))
+    return 1;
+
+  part = filename;
+
+  while (part != NULL)
+  {
+    if (!strncmp(part, "..", 2) && ((part[2] == '/') || (part[2] == '\0')))
+      return 1;
+
+    part = strchr(part, '/');
+
+    if (part != NULL)
+      part += 1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* daemon_handle_request()                                                    */
+/******************************************************************************/
+int daemon_handle_request(int fd, kp_context* ctx, char* line)
+{
+  int k;
+
+  char* args[DAEMON_MAX_ARGS];
+  int   num_args;
+
+  char* root_name;
+  char* rom_filename;
+  char* save_ptr;
+
+  unsigned short options;
+
+  char reply[64];
+
+  /* split the line into arguments */
+  num_args = 0;
+
+  args[0] = strtok_r(line, " \t\r", &save_ptr);
+
+  while ((args[num_args] != NULL) && (num_args < DAEMON_MAX_ARGS - 1))
+  {
+    num_args += 1;
+    args[num_args] = strtok_r(NULL, " \t\r", &save_ptr);
+  }
+
+  if ((num_args == 0) || strcmp(args[0], "pack"))
+    return daemon_reply(fd, "error unknown request\n");
+
+  if (num_args < 3)
+    return daemon_reply(fd, "error missing root or rom\n");
+
+  root_name = args[1];
+  rom_filename = args[2];
+
+  if (daemon_check_rom_filename(rom_filename))
+    return daemon_reply(fd, "error rom must be below the daemon folder\n");
+
+  /* parse options */
+  options = 0x0000;
+
+  for (k = 3; k < num_args; k++)
+  {
+    if (!strcmp(args[k], "--trim"))
+      options |= KP_OPTION_TRIM;
+    else if (!strcmp(args[k], "--metasprites"))
+      options |= KP_OPTION_METASPRITES;
+    else
+      return daemon_reply(fd, "error unknown option\n");
+  }
+
+  /* pack the rom! */
+  kp_set_options(ctx, options);
+
+  if (kp_pack_folder(ctx, root_name))
+    return daemon_reply(fd, "error pack failed\n");
+
+  if (kp_save_rom(ctx, rom_filename))
+    return daemon_reply(fd, "error save failed\n");
+
+  sprintf(reply, "ok %lu\n", kp_rom_size(ctx));
+
+  /* the trace covers every request so far */
+  if (G_trace_enabled)
+    trace_write();
+
+  return daemon_reply(fd, reply);
+}
+
+/******************************************************************************/
+/* daemon_client()                                                            */
+/******************************************************************************/
+void* daemon_client(void* arg)
+{
+  int fd;
+  int index;
+
+  char line[DAEMON_LINE_MAX_SIZE];
+  long line_size;
+  long result;
+
+  char* end;
+
+  fd = (int) (long) arg;
+
+  index = daemon_claim_context();
+
+  if (index < 0)
+  {
+    daemon_reply(fd, "error busy\n");
+    close(fd);
+    return NULL;
+  }
+
+  /* handle each request line */
+  line_size = 0;
+
+  while (1)
+  {
+    end = memchr(line, '\n', line_size);
+
+    if (end != NULL)
+    {
+      *end = '\0';
+
+      if (daemon_handle_request(fd, S_daemon_contexts[index], line))
+        break;
+
+      line_size -= (end - line) + 1;
+      memmove(line, end + 1, line_size);
+
+      continue;
+    }
+
+    if (line_size == DAEMON_LINE_MAX_SIZE)
+    {
+      daemon_reply(fd, "error line too long\n");
+      break;
+    }
+
+    result = read(fd, &line[line_size], DAEMON_LINE_MAX_SIZE - line_size);
+
+    if (result <= 0)
+      break;
+
+    line_size += result;
+  }
+
+  daemon_release_context(index);
+
+  close(fd);
+
+  return NULL;
+}
+
+/******************************************************************************/
+/* daemon_run()                                                               */
+/******************************************************************************/
+int daemon_run(char* socket_path)
+{
+  int listen_fd;
+  int client_fd;
+
+  struct sockaddr_un addr;
+
+  pthread_t      thread;
+  pthread_attr_t attr;
+
+  mode_t old_mask;
+  int    result;
+
+  struct sigaction action;
+  struct timespec  backoff;
+
+  /* make sure socket path is valid */
+  if (socket_path == NULL)
+    return 1;
+
+  if (strlen(socket_path) >= sizeof(addr.sun_path))
+    return 1;
+
+  /* create the socket (replacing one left by an old daemon) */
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (listen_fd < 0)
+    return 1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+
+  unlink(socket_path);
+
+  /* connecting needs write permission on the socket, so */
+  /* create it with access for this user only            */
+  old_mask = umask(S_IRWXG | S_IRWXO);
+
+  result = bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr));
+
+  umask(old_mask);
+
+  if (result)
+    goto nope;
+
+  if (listen(listen_fd, DAEMON_MAX_CLIENTS))
+    goto nope;
+
+  /* a client that closes before its reply is written would */
+  /* otherwise raise SIGPIPE, and take the whole daemon down  */
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = SIG_IGN;
+  sigemptyset(&action.sa_mask);
+
+  if (sigaction(SIGPIPE, &action, NULL))
+    goto nope;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  printf("Listening: %s\n", socket_path);
+
+  /* each client gets its own thread */
+  while (1)
+  {
+    client_fd = accept(listen_fd, NULL, NULL);
+
+    if (client_fd < 0)
+    {
+      /* a client that gave up, or a signal */
+      if ((errno == EINTR) || (errno == ECONNABORTED))
+        continue;
+
+      /* out of descriptors or memory (until some clients finish) */
+      if ((errno == EMFILE) || (errno == ENFILE) ||
+          (errno == ENOBUFS) || (errno == ENOMEM))
+      {
+        backoff.tv_sec = 0;
+        backoff.tv_nsec = DAEMON_ACCEPT_BACKOFF_MS * 1000000L;
+
+        nanosleep(&backoff, NULL);
+
+        continue;
+      }
+
+      /* anything else means the socket itself is broken */
+      printf("Accept Failed: %s\n", strerror(errno));
+      break;
+    }
+
+    if (pthread_create(&thread, &attr, daemon_client, (void*) (long) client_fd))
+    {
+      daemon_reply(client_fd, "error busy\n");
+      close(client_fd);
+    }
+  }
+
+  pthread_attr_destroy(&attr);
+
+nope:
+  close(listen_fd);
+  return 1;
+}
@@ -0,0 +1,11 @@
+/******************************************************************************/
+/* daemon.h (pack requests from a unix socket)                                */
+/******************************************************************************/
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+/* function declarations */
+int daemon_run(char* socket_path);
+
+#endif
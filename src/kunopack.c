@@ -0,0 +1,394 @@
+/******************************************************************************/
+/* kunopack.c (packer library)                                                */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kunopack.h"
+
+#include "art.h"
+#include "comp.h"
+#include "mem.h"
+#include "rom.h"
+#include "stats.h"
+#include "trace.h"
+
+/* the module state that lasts between calls lives here  */
+/* (the art counts are kept at the end of its buffers);   */
+/* everything else is thread-local, and is reset by the   */
+/* pack calls before it is used                           */
+struct kp_context
+{
+  unsigned char* art_buffers;
+  unsigned char* comp_buffers;
+  unsigned char* rom_buffers;
+
+  unsigned short options;
+  unsigned long  rom_size;
+};
+
+/******************************************************************************/
+/* kp_context_create()                                                        */
+/******************************************************************************/
+kp_context* kp_context_create()
+{
+  kp_context* ctx;
+
+  ctx = calloc(1, sizeof(kp_context));
+
+  if (ctx == NULL)
+    return NULL;
+
+  /* the buffers start out cleared, like the old file-static arrays */
+  ctx->art_buffers = calloc(art_buffers_size(), sizeof(unsigned char));
+  ctx->comp_buffers = calloc(comp_buffers_size(), sizeof(unsigned char));
+  ctx->rom_buffers = calloc(rom_buffers_size(), sizeof(unsigned char));
+
+  if ((ctx->art_buffers == NULL) || (ctx->comp_buffers == NULL) || (ctx->rom_buffers == NULL))
+  {
+    kp_context_destroy(ctx);
+    return NULL;
+  }
+
+  ctx->options = 0x0000;
+  ctx->rom_size = 0;
+
+  return ctx;
+}
+
+/******************************************************************************/
+/* kp_context_destroy()                                                       */
+/******************************************************************************/
+int kp_context_destroy(kp_context* ctx)
+{
+  if (ctx == NULL)
+    return 1;
+
+  free(ctx->art_buffers);
+  free(ctx->comp_buffers);
+  free(ctx->rom_buffers);
+
+  free(ctx);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* kp_context_select()                                                        */
+/******************************************************************************/
+int kp_context_select(kp_context* ctx)
+{
+  if (ctx == NULL)
+    return 1;
+
+  /* bind the context buffers to this thread */
+  if (art_bind_buffers(ctx->art_buffers))
+    return 1;
+
+  if (comp_bind_buffers(ctx->comp_buffers))
+    return 1;
+
+  if (rom_bind_buffers(ctx->rom_buffers))
+    return 1;
+
+  /* pick up the counts from the last pack (on any thread) */
+  art_restore_state();
+
+  G_rom_size = ctx->rom_size;
+
+  /* set options */
+  G_art_options = 0x0000;
+
+  if (ctx->options & KP_OPTION_TRIM)
+    G_art_options |= ART_OPTION_TRIM;
+
+  if (ctx->options & KP_OPTION_METASPRITES)
+    G_art_options |= ART_OPTION_METASPRITES;
+
+  /* the stats are kept per thread, and cleared by each pack call */
+  G_stats_enabled = (ctx->options & KP_OPTION_STATS) ? 1 : 0;
+
+  /* the buffers are calloc'd, so their pages are only reserved until   */
+  /* written; lazy clears keep the unused pages from being touched at all */
+  G_mem_lazy = (ctx->options & KP_OPTION_LAZY_BUFFERS) ? 1 : 0;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* kp_set_options()                                                           */
+/******************************************************************************/
+int kp_set_options(kp_context* ctx, unsigned short options)
+{
+  if (ctx == NULL)
+    return 1;
+
+  ctx->options = options;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* kp_pack_folder()                                                           */
+/******************************************************************************/
+int kp_pack_folder(kp_context* ctx, char* root_name)
+{
+  int result;
+
+  if (kp_context_select(ctx))
+    return 1;
+
+  stats_clear();
+
+  rom_format();
+
+  TRACE_BEGIN("pack", root_name);
+  result = comp_pack_rom(root_name);
+  TRACE_END();
+
+  /* the checksums cover every chunk, so they are added last */
+  if (!result && (ctx->options & KP_OPTION_CHECKSUMS))
+    result = rom_add_checksum_chunk();
+
+  art_save_state();
+
+  ctx->rom_size = G_rom_size;
+
+  return result;
+}
+
+/******************************************************************************/
+/* kp_estimate_folder()                                                       */
+/******************************************************************************/
+int kp_estimate_folder(kp_context* ctx, char* root_name)
+{
+  if (kp_context_select(ctx))
+    return 1;
+
+  /* this does not change the rom */
+  return comp_estimate_rom(root_name);
+}
+
+/******************************************************************************/
+/* kp_pack_gifs()                                                             */
+/******************************************************************************/
+int kp_pack_gifs(kp_context* ctx, unsigned char** data, unsigned long* sizes, unsigned short num_files)
+{
+  unsigned short k;
+
+  int result;
+
+  /* make sure the files are valid */
+  if ((data == NULL) || (sizes == NULL))
+    return 1;
+
+  if (kp_context_select(ctx))
+    return 1;
+
+  stats_clear();
+
+  /* the gifs are packed like a sprites folder */
+  rom_format();
+
+  art_clear_rom_data_vars();
+
+  TRACE_BEGIN("pack", "memory");
+
+  result = 0;
+
+  for (k = 0; k < num_files; k++)
+  {
+    TRACE_BEGIN("file", "memory gif");
+    result = art_load_gif_memory(data[k], sizes[k]);
+    TRACE_END();
+
+    if (result)
+      break;
+  }
+
+  if (!result)
+  {
+    TRACE_BEGIN("rom", "chunk layout");
+    rom_set_chunk_owner("(memory)");
+    result = art_add_chunks_to_rom();
+    TRACE_END();
+  }
+
+  TRACE_END();
+
+  if (!result && (ctx->options & KP_OPTION_CHECKSUMS))
+    result = rom_add_checksum_chunk();
+
+  art_save_state();
+
+  ctx->rom_size = G_rom_size;
+
+  return result;
+}
+
+/******************************************************************************/
+/* kp_rom_size()                                                              */
+/******************************************************************************/
+unsigned long kp_rom_size(kp_context* ctx)
+{
+  unsigned long num_bytes;
+
+  if (kp_context_select(ctx))
+    return 0;
+
+  /* this is the size with the cart header */
+  rom_save_buffer(NULL, 0, &num_bytes);
+
+  return num_bytes;
+}
+
+/******************************************************************************/
+/* kp_save_rom()                                                              */
+/******************************************************************************/
+int kp_save_rom(kp_context* ctx, char* filename)
+{
+  char* dot;
+  char* map_filename;
+
+  if (kp_context_select(ctx))
+    return 1;
+
+  if (rom_save(filename))
+    return 1;
+
+  if (!(ctx->options & KP_OPTION_MAP))
+    return 0;
+
+  /* the map is a sidecar: rom.kn1 -> rom.map */
+  map_filename = malloc(strlen(filename) + 5);
+
+  if (map_filename == NULL)
+    return 1;
+
+  strcpy(map_filename, filename);
+
+  dot = strrchr(map_filename, '.');
+
+  if ((dot != NULL) && (strchr(dot, '/') == NULL))
+    *dot = '\0';
+
+  strcat(map_filename, ".map");
+
+  if (kp_write_map(ctx, map_filename))
+  {
+    free(map_filename);
+    return 1;
+  }
+
+  free(map_filename);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* kp_save_rom_buffer()                                                       */
+/******************************************************************************/
+int kp_save_rom_buffer(kp_context* ctx, unsigned char* buf, unsigned long buf_size, unsigned long* num_bytes)
+{
+  if (kp_context_select(ctx))
+    return 1;
+
+  return rom_save_buffer(buf, buf_size, num_bytes);
+}
+
+/******************************************************************************/
+/* kp_write_map()                                                             */
+/******************************************************************************/
+int kp_write_map(kp_context* ctx, char* filename)
+{
+  FILE* fp;
+
+  if (filename == NULL)
+    return 1;
+
+  if (kp_context_select(ctx))
+    return 1;
+
+  fp = fopen(filename, "w");
+
+  if (fp == NULL)
+    return 1;
+
+  /* addresses are offsets in the rom file, and each */
+  /* section is sorted by address (for binary search) */
+  fprintf(fp, "# kunopack map (hex addresses and sizes)\n");
+
+  if (rom_write_map(fp))
+    goto nope;
+
+  if (art_write_map(fp))
+    goto nope;
+
+  fclose(fp);
+
+  return 0;
+
+nope:
+  fclose(fp);
+  return 1;
+}
+
+/******************************************************************************/
+/* kp_print_memory()                                                          */
+/******************************************************************************/
+int kp_print_memory(kp_context* ctx)
+{
+  if (kp_context_select(ctx))
+    return 1;
+
+  /* used is the high-water mark of each buffer since it was cleared */
+  mem_print_header();
+
+  art_print_memory();
+  comp_print_memory();
+  rom_print_memory();
+
+  mem_print_footer();
+
+  return 0;
+}
+
+/******************************************************************************/
+/* kp_write_report()                                                          */
+/******************************************************************************/
+int kp_write_report(kp_context* ctx, char* filename)
+{
+  FILE* fp;
+
+  if (filename == NULL)
+    return 1;
+
+  if (kp_context_select(ctx))
+    return 1;
+
+  fp = fopen(filename, "w");
+
+  if (fp == NULL)
+    return 1;
+
+  /* the report describes the last pack with this context */
+  fprintf(fp, "{\n");
+
+  if (art_write_report(fp))
+    goto nope;
+
+  if (rom_write_report(fp))
+    goto nope;
+
+  fprintf(fp, "}\n");
+
+  fclose(fp);
+
+  return 0;
+
+nope:
+  fclose(fp);
+  return 1;
+}
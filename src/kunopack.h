@@ -0,0 +1,43 @@
+/******************************************************************************/
+/* kunopack.h (packer library)                                                */
+/******************************************************************************/
+
+#ifndef KUNOPACK_H
+#define KUNOPACK_H
+
+/* a context owns the packer buffers and the counts that go  */
+/* with them; any number of contexts can be used at the same  */
+/* time, one per thread. each call selects the context for    */
+/* the calling thread, so a context may also be moved to      */
+/* another thread between calls (but not used by two at once) */
+typedef struct kp_context kp_context;
+
+/* options */
+#define KP_OPTION_TRIM         0x0001
+#define KP_OPTION_METASPRITES  0x0002
+#define KP_OPTION_STATS        0x0004
+#define KP_OPTION_LAZY_BUFFERS 0x0008
+#define KP_OPTION_MAP          0x0010
+#define KP_OPTION_CHECKSUMS    0x0020
+
+/* function declarations */
+kp_context* kp_context_create();
+int kp_context_destroy(kp_context* ctx);
+int kp_context_select(kp_context* ctx);
+
+int kp_set_options(kp_context* ctx, unsigned short options);
+
+int kp_pack_folder(kp_context* ctx, char* root_name);
+int kp_estimate_folder(kp_context* ctx, char* root_name);
+int kp_pack_gifs(kp_context* ctx, unsigned char** data, unsigned long* sizes, unsigned short num_files);
+
+unsigned long kp_rom_size(kp_context* ctx);
+
+int kp_save_rom(kp_context* ctx, char* filename);
+int kp_save_rom_buffer(kp_context* ctx, unsigned char* buf, unsigned long buf_size, unsigned long* num_bytes);
+
+int kp_write_report(kp_context* ctx, char* filename);
+int kp_write_map(kp_context* ctx, char* filename);
+int kp_print_memory(kp_context* ctx);
+
+#endif
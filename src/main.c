@@ -4,21 +4,227 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "art.h"
+#include "cache.h"
 #include "con.h"
+#include "daemon.h"
 #include "comp.h"
+#include "kunopack.h"
 #include "rom.h"
+#include "stats.h"
+#include "trace.h"
+#include "verify.h"
+#include "watch.h"
 
 /******************************************************************************/
 /* main()                                                                     */
 /******************************************************************************/
 int main(int argc, char *argv[])
 {
-  rom_format();
+  int k;
+
+  char* root_name;
+  char* rom_filename;
+  char* cache_folder;
+  char* socket_path;
+  char* trace_filename;
+  char* report_filename;
+  char* verify_filename;
+
+  unsigned short options;
+  unsigned char  watch_flag;
+  unsigned char  estimate_flag;
+  unsigned char  memory_flag;
+
+  kp_context* ctx;
+
+  int result;
+
+  /* parse command line */
+  root_name = NULL;
+  rom_filename = NULL;
+  cache_folder = NULL;
+  socket_path = NULL;
+  trace_filename = NULL;
+  report_filename = NULL;
+  verify_filename = NULL;
+
+  options = 0x0000;
+  watch_flag = 0;
+  estimate_flag = 0;
+  memory_flag = 0;
+
+  for (k = 1; k < argc; k++)
+  {
+    if (!strcmp(argv[k], "--trim"))
+      options |= KP_OPTION_TRIM;
+    else if (!strcmp(argv[k], "--metasprites"))
+      options |= KP_OPTION_METASPRITES;
+    else if (!strcmp(argv[k], "--stats"))
+      options |= KP_OPTION_STATS;
+    else if (!strcmp(argv[k], "--lazy-buffers"))
+      options |= KP_OPTION_LAZY_BUFFERS;
+    else if (!strcmp(argv[k], "--checksums"))
+      options |= KP_OPTION_CHECKSUMS;
+    else if (!strcmp(argv[k], "--map"))
+      options |= KP_OPTION_MAP;
+    else if (!strcmp(argv[k], "--memory"))
+      memory_flag = 1;
+    else if (!strcmp(argv[k], "--cache"))
+    {
+      if (k + 1 >= argc)
+      {
+        printf("Missing cache folder\n");
+        return 1;
+      }
+
+      k += 1;
+      cache_folder = argv[k];
+    }
+    else if (!strcmp(argv[k], "--daemon"))
+    {
+      if (k + 1 >= argc)
+      {
+        printf("Missing socket path\n");
+        return 1;
+      }
+
+      k += 1;
+      socket_path = argv[k];
+    }
+    else if (!strcmp(argv[k], "--trace"))
+    {
+      if (k + 1 >= argc)
+      {
+        printf("Missing trace file\n");
+        return 1;
+      }
+
+      k += 1;
+      trace_filename = argv[k];
+    }
+    else if (!strcmp(argv[k], "--report"))
+    {
+      if (k + 1 >= argc)
+      {
+        printf("Missing report file\n");
+        return 1;
+      }
+
+      k += 1;
+      report_filename = argv[k];
+    }
+    else if (!strcmp(argv[k], "--verify"))
+    {
+      if (k + 1 >= argc)
+      {
+        printf("Missing rom file\n");
+        return 1;
+      }
+
+      k += 1;
+      verify_filename = argv[k];
+    }
+    else if (!strcmp(argv[k], "--watch"))
+      watch_flag = 1;
+    else if (!strcmp(argv[k], "--estimate"))
+      estimate_flag = 1;
+    else if (argv[k][0] == '-')
+    {
+      printf("Unknown option: %s\n", argv[k]);
+      return 1;
+    }
+    else if (root_name == NULL)
+      root_name = argv[k];
+    else if (rom_filename == NULL)
+      rom_filename = argv[k];
+    else
+    {
+      printf("Too many arguments: %s\n", argv[k]);
+      return 1;
+    }
+  }
+
+  if (root_name == NULL)
+    root_name = "test";
+
+  if (rom_filename == NULL)
+    rom_filename = "test.kn1";
+
+  /* check an existing rom against its checksums (nothing is packed) */
+  if (verify_filename != NULL)
+    return verify_rom_file(verify_filename, 0);
+
+  /* record a timeline of the pack (written when the pack is done) */
+  if (trace_filename != NULL)
+  {
+    if (trace_open(trace_filename))
+      printf("Trace not available: %s\n", trace_filename);
+  }
+
+  /* pack requests from the socket until killed (each client */
+  /* gets a context of its own, so none is created here)     */
+  if (socket_path != NULL)
+  {
+    if (cache_open(cache_folder))
+      printf("Cache not available: %s\n", cache_folder != NULL ? cache_folder : "(memory)");
+
+    daemon_run(socket_path);
+
+    trace_close();
+    cache_close();
+
+    return 1;
+  }
+
+  /* create the packer context */
+  ctx = kp_context_create();
+
+  if (ctx == NULL)
+  {
+    printf("Could not create packer context\n");
+    trace_close();
+    return 1;
+  }
+
+  kp_set_options(ctx, options);
+
+  /* check the rom budgets from the gif headers (no rom is saved) */
+  if (estimate_flag)
+  {
+    result = kp_estimate_folder(ctx, root_name);
+
+    trace_close();
+    kp_context_destroy(ctx);
+
+    return result;
+  }
+
+  /* open the decoded asset cache (watch mode always keeps one) */
+  if ((cache_folder != NULL) || watch_flag)
+  {
+    if (cache_open(cache_folder))
+      printf("Cache not available: %s\n", cache_folder != NULL ? cache_folder : "(memory)");
+  }
+
+  /* rebuild whenever the rom folder changes */
+  if (watch_flag)
+  {
+    watch_run(ctx, root_name, rom_filename);
+
+    cache_close();
+    kp_context_destroy(ctx);
+
+    return 1;
+  }
 
   /* compile rom folder */
-  comp_pack_rom("test");
+  result = kp_pack_folder(ctx, root_name);
+
+  if (result)
+    printf("Pack Failed: %s\n", root_name);
 
 #if 0
   /* parse con file */
@@ -34,9 +240,26 @@ int main(int argc, char *argv[])
   art_add_files_to_rom();
 #endif
 
-  /* save the rom! */
-  rom_save("test.kn1");
+  /* save the rom! (a failed pack keeps the old one) */
+  if (!result && kp_save_rom(ctx, rom_filename))
+  {
+    printf("Save Failed: %s\n", rom_filename);
+    result = 1;
+  }
 
-  return 0;
-}
+  if (options & KP_OPTION_STATS)
+    stats_print();
 
+  if (memory_flag)
+    kp_print_memory(ctx);
+
+  /* describe each asset in the rom */
+  if (!result && (report_filename != NULL) && kp_write_report(ctx, report_filename))
+    printf("Report not written: %s\n", report_filename);
+
+  trace_close();
+  cache_close();
+  kp_context_destroy(ctx);
+
+  return result;
+}
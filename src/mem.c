@@ -0,0 +1,140 @@
+/******************************************************************************/
+/* mem.c (buffer usage and peak memory)                                       */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/resource.h>
+
+#include "mem.h"
+
+__thread unsigned char G_mem_lazy;
+
+static __thread unsigned long S_mem_total_used;
+static __thread unsigned long S_mem_total_reserved;
+
+/******************************************************************************/
+/* mem_used_bytes()                                                           */
+/******************************************************************************/
+unsigned long mem_used_bytes(void* buf, unsigned long num_bytes)
+{
+  unsigned char* bytes;
+  unsigned long* words;
+
+  unsigned long  num_words;
+
+  /* the buffers start out cleared, so the used part is up */
+  /* to the last nonzero byte (the high-water mark)        */
+  if (buf == NULL)
+    return 0;
+
+  bytes = (unsigned char*) buf;
+
+  while ((num_bytes % sizeof(unsigned long)) != 0)
+  {
+    if (bytes[num_bytes - 1] != 0)
+      return num_bytes;
+
+    num_bytes -= 1;
+  }
+
+  /* the context buffers are word aligned, so scan by words */
+  words = (unsigned long*) buf;
+  num_words = num_bytes / sizeof(unsigned long);
+
+  while ((num_words > 0) && (words[num_words - 1] == 0))
+    num_words -= 1;
+
+  if (num_words == 0)
+    return 0;
+
+  num_bytes = num_words * sizeof(unsigned long);
+
+  while (bytes[num_bytes - 1] == 0)
+    num_bytes -= 1;
+
+  return num_bytes;
+}
+
+/******************************************************************************/
+/* mem_clear()                                                                */
+/******************************************************************************/
+int mem_clear(void* buf, unsigned long num_bytes)
+{
+  if (buf == NULL)
+    return 1;
+
+  /* reading the untouched pages maps the shared zero page, */
+  /* so finding the used part does not make them resident   */
+  if (G_mem_lazy)
+    num_bytes = mem_used_bytes(buf, num_bytes);
+
+  memset(buf, 0, num_bytes);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* mem_print_header()                                                         */
+/******************************************************************************/
+int mem_print_header()
+{
+  S_mem_total_used = 0;
+  S_mem_total_reserved = 0;
+
+  printf("Memory:\n");
+  printf("  %-22s %10s %10s\n", "Buffer", "Used", "Reserved");
+
+  return 0;
+}
+
+/******************************************************************************/
+/* mem_print_buffer()                                                         */
+/******************************************************************************/
+int mem_print_buffer(const char* name, void* buf, unsigned long num_bytes)
+{
+  unsigned long used;
+
+  used = mem_used_bytes(buf, num_bytes);
+
+  printf("  %-22s %10lu %10lu  (%5.1f%%)\n",
+         name, used, num_bytes,
+         (num_bytes > 0) ? (100.0 * used / num_bytes) : 0.0);
+
+  S_mem_total_used += used;
+  S_mem_total_reserved += num_bytes;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* mem_print_footer()                                                         */
+/******************************************************************************/
+int mem_print_footer()
+{
+  printf("  %-22s %10lu %10lu  (%5.1f%%)\n",
+         "Total", S_mem_total_used, S_mem_total_reserved,
+         (S_mem_total_reserved > 0) ? (100.0 * S_mem_total_used / S_mem_total_reserved) : 0.0);
+
+  printf("  %-22s %10lu KB\n", "Peak RSS", mem_peak_rss_kb());
+
+  return 0;
+}
+
+/******************************************************************************/
+/* mem_peak_rss_kb()                                                          */
+/******************************************************************************/
+unsigned long mem_peak_rss_kb()
+{
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+
+  /* linux reports the high-water resident set in kilobytes */
+  return (unsigned long) usage.ru_maxrss;
+}
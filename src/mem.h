@@ -0,0 +1,22 @@
+/******************************************************************************/
+/* mem.h (buffer usage and peak memory)                                       */
+/******************************************************************************/
+
+#ifndef MEM_H
+#define MEM_H
+
+/* in lazy mode, a buffer clear only covers the part that was used, */
+/* so the pages past it are never touched (and never become resident) */
+extern __thread unsigned char G_mem_lazy;
+
+/* function declarations */
+unsigned long mem_used_bytes(void* buf, unsigned long num_bytes);
+int mem_clear(void* buf, unsigned long num_bytes);
+
+int mem_print_header();
+int mem_print_buffer(const char* name, void* buf, unsigned long num_bytes);
+int mem_print_footer();
+
+unsigned long mem_peak_rss_kb();
+
+#endif
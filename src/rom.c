@@ -2,11 +2,20 @@
 /* rom.c (faux game cartridge)                                                */
 /******************************************************************************/
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "crc.h"
+#include "mem.h"
 #include "rom.h"
+#include "stats.h"
+#include "trace.h"
 
 /* chunk table format                         */
 /* 1) number of chunks (2 bytes)              */
@@ -25,7 +34,7 @@
 #define ROM_CHUNK_TABLE_ENTRY_BYTES  6
 
 #define ROM_CHUNK_TABLE_SIZE(num_entries)                                      \
-  (ROM_CHUNK_TABLE_COUNT_BYTES + (ROM_CHUNK_TABLE_ENTRY_BYTES * num_entries))
+  (ROM_CHUNK_TABLE_COUNT_BYTES + (ROM_CHUNK_TABLE_ENTRY_BYTES * (num_entries)))
 
 #define ROM_CHUNK_ENTRY_LOC(entry_index)                                       \
   (ROM_CHUNK_TABLE_COUNT_BYTES + (ROM_CHUNK_TABLE_ENTRY_BYTES * (entry_index)))
@@ -50,6 +59,9 @@
   G_rom_data[(addr) + 1] = ((val) >> 8) & 0xFF;                                \
   G_rom_data[(addr) + 2] = (val) & 0xFF;
 
+#define ROM_SWAP_16(val)                                                       \
+  ((unsigned short) ((((val) >> 8) & 0x00FF) | (((val) << 8) & 0xFF00)))
+
 #define ROM_READ_BYTE(val, addr)                                               \
   (val) = G_rom_data[(addr) + 0] & 0xFF;
 
@@ -62,25 +74,131 @@
   (val) |= (G_rom_data[(addr) + 1] << 8) & 0x00FF00;                           \
   (val) |=  G_rom_data[(addr) + 2] & 0x0000FF;
 
+/* the rom file starts with the cart header */
+/* 1) signature ("KUNOICHI")                 */
+/* 2) type ("CART")                          */
+
+#define ROM_HEADER_BYTES 12
+
+/* the optional checksum chunk is added last, and covers the chunks before it */
+/* 1) tag ("KCRC", 4 bytes)                                                   */
+/* 2) number of chunks covered (2 bytes)                                      */
+/* 3) the crc-32 of each chunk (4 bytes each)                                 */
+
+#define ROM_CHECKSUM_TAG_BYTES       4
+#define ROM_CHECKSUM_COUNT_BYTES     2
+#define ROM_CHECKSUM_ENTRY_BYTES     4
+
+#define ROM_CHECKSUM_CHUNK_SIZE(num_entries)                                   \
+  (ROM_CHECKSUM_TAG_BYTES + ROM_CHECKSUM_COUNT_BYTES +                         \
+   (ROM_CHECKSUM_ENTRY_BYTES * (num_entries)))
+
 /* the rom! */
 
 #define ROM_MAX_BYTES (4 * 1024 * 1024) /* 4 MB */
 
-unsigned char G_rom_data[ROM_MAX_BYTES];
-unsigned long G_rom_size;
+__thread unsigned char* G_rom_data;
+__thread unsigned long G_rom_size;
+
+/* saves number their temp files, so that two threads (or  */
+/* processes) saving the same rom never share a temp file  */
+#define ROM_TEMP_SUFFIX_SIZE 48
+
+static unsigned long S_rom_num_saves;
+
+/* map file labels (which folder, and which table, each chunk holds) */
+#define ROM_MAP_MAX_CHUNKS  256
+#define ROM_MAP_OWNER_SIZE  128
+#define ROM_MAP_NAME_SIZE   32
+
+struct rom_map_chunk
+{
+  char owner[ROM_MAP_OWNER_SIZE];
+  char name[ROM_MAP_NAME_SIZE];
+};
+
+static __thread struct rom_map_chunk* S_rom_map;
+
+static __thread char        S_rom_map_owner[ROM_MAP_OWNER_SIZE];
+static __thread const char* S_rom_map_name;
+
+/* how far into the rom buffer anything has been written (the rom */
+/* itself, and chunk data built in the tail), so that clearing it */
+/* only touches that part; kept with the buffer, like the rom     */
+static __thread unsigned long* S_rom_used_end;
+
+/* the large buffers are owned by the packer context, */
+/* which binds them to the thread that is using it    */
+#define ROM_BUFFER_BYTES(num, type)                                            \
+  ((((num) * sizeof(type)) + 7) & ~7UL)
+
+/******************************************************************************/
+/* rom_buffers_size()                                                         */
+/******************************************************************************/
+unsigned long rom_buffers_size()
+{
+  return
+    ROM_BUFFER_BYTES(ROM_MAX_BYTES, unsigned char) +
+    ROM_BUFFER_BYTES(ROM_MAP_MAX_CHUNKS, struct rom_map_chunk) +
+    ROM_BUFFER_BYTES(1, unsigned long);
+}
+
+/******************************************************************************/
+/* rom_bind_buffers()                                                         */
+/******************************************************************************/
+int rom_bind_buffers(unsigned char* buf)
+{
+  if (buf == NULL)
+    return 1;
+
+  G_rom_data = (unsigned char*) buf;
+  buf += ROM_BUFFER_BYTES(ROM_MAX_BYTES, unsigned char);
+
+  S_rom_map = (struct rom_map_chunk*) buf;
+  buf += ROM_BUFFER_BYTES(ROM_MAP_MAX_CHUNKS, struct rom_map_chunk);
+
+  S_rom_used_end = (unsigned long*) buf;
+  buf += ROM_BUFFER_BYTES(1, unsigned long);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_print_memory()                                                         */
+/******************************************************************************/
+int rom_print_memory()
+{
+  /* the cells are built past the end of the rom, so this counts them too */
+  mem_print_buffer("ROM Data", G_rom_data, ROM_MAX_BYTES);
+
+  return 0;
+}
 
 /******************************************************************************/
 /* rom_clear()                                                                */
 /******************************************************************************/
 int rom_clear()
 {
-  unsigned long k;
+  unsigned long num_bytes;
+
+  /* the rest of the buffer was never written, so it is still clear */
+  num_bytes = *S_rom_used_end;
+
+  if (num_bytes < G_rom_size)
+    num_bytes = G_rom_size;
 
-  for (k = 0; k < ROM_MAX_BYTES; k++)
-    G_rom_data[k] = 0x00;
+  if (num_bytes > ROM_MAX_BYTES)
+    num_bytes = ROM_MAX_BYTES;
+
+  mem_clear(G_rom_data, num_bytes);
+
+  *S_rom_used_end = 0;
 
   G_rom_size = 0;
 
+  S_rom_map_owner[0] = '\0';
+  S_rom_map_name = NULL;
+
   return 0;
 }
 
@@ -191,6 +309,8 @@ int rom_create_chunk(unsigned long num_bytes)
     memmove(&G_rom_data[data_block_addr + ROM_CHUNK_TABLE_ENTRY_BYTES], 
             &G_rom_data[data_block_addr], 
             data_block_size);
+
+    STATS_COUNT(STATS_COUNT_MEMMOVE_BYTES, data_block_size);
   }
 
   G_rom_size += ROM_CHUNK_TABLE_ENTRY_BYTES;
@@ -204,9 +324,24 @@ int rom_create_chunk(unsigned long num_bytes)
   ROM_WRITE_24BE(ROM_CHUNK_ADDR_LOC(chunk_index), data_block_size)
   ROM_WRITE_24BE(ROM_CHUNK_SIZE_LOC(chunk_index), num_bytes)
 
+  /* label it for the map file */
+  if (chunk_index < ROM_MAP_MAX_CHUNKS)
+  {
+    strcpy(S_rom_map[chunk_index].owner, S_rom_map_owner);
+
+    strncpy(S_rom_map[chunk_index].name, 
+            (S_rom_map_name != NULL) ? S_rom_map_name : "", 
+            ROM_MAP_NAME_SIZE - 1);
+    S_rom_map[chunk_index].name[ROM_MAP_NAME_SIZE - 1] = '\0';
+  }
+
+  S_rom_map_name = NULL;
+
   /* update the rom size and return */
   G_rom_size += num_bytes;
 
+  STATS_COUNT(STATS_COUNT_CHUNKS, 1);
+
   return 0;
 }
 
@@ -227,6 +362,8 @@ int rom_add_chunk_bytes(unsigned char* data, unsigned long num_bytes)
   if (num_bytes == 0)
     return 0;
 
+  STATS_BEGIN(STATS_PHASE_CHUNKS);
+
   /* create new chunk */
   if (rom_create_chunk(num_bytes))
     return 1;
@@ -238,8 +375,163 @@ int rom_add_chunk_bytes(unsigned char* data, unsigned long num_bytes)
 
   ROM_READ_24BE(chunk_addr, ROM_CHUNK_ADDR_LOC(num_chunks - 1))
 
-  /* copy the data to the chunk */
-  memcpy(&G_rom_data[data_block_addr + chunk_addr], data, num_bytes);
+  /* copy the data to the chunk (it may already be in the rom tail) */
+  if (&G_rom_data[data_block_addr + chunk_addr] != data)
+  {
+    memmove(&G_rom_data[data_block_addr + chunk_addr], data, num_bytes);
+
+    STATS_COUNT(STATS_COUNT_MEMMOVE_BYTES, num_bytes);
+  }
+
+  STATS_END(STATS_PHASE_CHUNKS);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_reserve_tail()                                                         */
+/******************************************************************************/
+unsigned char* rom_reserve_tail(unsigned long offset, unsigned long* num_bytes)
+{
+  /* the space past the end of the rom can be used to build chunk  */
+  /* data in place, as long as the offset leaves room for whatever */
+  /* is added to the rom before that chunk (including its table    */
+  /* entry). rom_add_chunk_bytes() then moves it into position.    */
+  if (num_bytes == NULL)
+    return NULL;
+
+  if ((G_rom_size + offset) >= ROM_MAX_BYTES)
+  {
+    *num_bytes = 0;
+    return NULL;
+  }
+
+  *num_bytes = ROM_MAX_BYTES - (G_rom_size + offset);
+
+  return &G_rom_data[G_rom_size + offset];
+}
+
+/******************************************************************************/
+/* rom_mark_used()                                                            */
+/******************************************************************************/
+int rom_mark_used(unsigned char* end)
+{
+  unsigned long num_bytes;
+
+  /* called before data is built in the tail, with the end of */
+  /* the part that is about to be written                     */
+  if ((end < G_rom_data) || (end > G_rom_data + ROM_MAX_BYTES))
+    return 1;
+
+  num_bytes = end - G_rom_data;
+
+  if (num_bytes > *S_rom_used_end)
+    *S_rom_used_end = num_bytes;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_add_checksum_chunk()                                                   */
+/******************************************************************************/
+int rom_add_checksum_chunk()
+{
+  unsigned short k;
+  unsigned short num_chunks;
+
+  unsigned long  data_block_addr;
+  unsigned long  chunk_addr;
+  unsigned long  chunk_size;
+  unsigned long  crc;
+
+  unsigned char* dest;
+
+  if (G_rom_size < ROM_CHUNK_TABLE_COUNT_BYTES)
+    return 1;
+
+  ROM_READ_16BE(num_chunks, 0)
+
+  /* make the chunk first, so the others are already in their final */
+  /* place (adding the table entry moves the data, not the offsets) */
+  S_rom_map_owner[0] = '\0';
+  rom_set_chunk_name("checksums");
+
+  if (rom_create_chunk(ROM_CHECKSUM_CHUNK_SIZE(num_chunks)))
+    return 1;
+
+  data_block_addr = ROM_CHUNK_TABLE_SIZE(num_chunks + 1);
+
+  ROM_READ_24BE(chunk_addr, ROM_CHUNK_ADDR_LOC(num_chunks))
+
+  dest = &G_rom_data[data_block_addr + chunk_addr];
+
+  dest[0] = 'K';
+  dest[1] = 'C';
+  dest[2] = 'R';
+  dest[3] = 'C';
+
+  dest[4] = (num_chunks >> 8) & 0xFF;
+  dest[5] = num_chunks & 0xFF;
+
+  dest += ROM_CHECKSUM_TAG_BYTES + ROM_CHECKSUM_COUNT_BYTES;
+
+  for (k = 0; k < num_chunks; k++)
+  {
+    ROM_READ_24BE(chunk_addr, ROM_CHUNK_ADDR_LOC(k))
+    ROM_READ_24BE(chunk_size, ROM_CHUNK_SIZE_LOC(k))
+
+    crc = crc_32(&G_rom_data[data_block_addr + chunk_addr], chunk_size);
+
+    dest[0] = (crc >> 24) & 0xFF;
+    dest[1] = (crc >> 16) & 0xFF;
+    dest[2] = (crc >> 8) & 0xFF;
+    dest[3] = crc & 0xFF;
+
+    dest += ROM_CHECKSUM_ENTRY_BYTES;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_write_words()                                                          */
+/******************************************************************************/
+int rom_write_words(unsigned char* dest, unsigned short* data, unsigned long num_words)
+{
+  unsigned long k;
+
+  unsigned short  val[8];
+  unsigned short* src;
+
+  k = 0;
+
+  /* on little endian hosts, 8 words at a time are byte swapped */
+  /* and stored whole; the compiler turns each block into a few */
+  /* vector shifts, so big chunks are written at memory speed   */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+  for (k = 0; k + 8 <= num_words; k += 8)
+  {
+    src = &data[k];
+
+    val[0] = ROM_SWAP_16(src[0]);
+    val[1] = ROM_SWAP_16(src[1]);
+    val[2] = ROM_SWAP_16(src[2]);
+    val[3] = ROM_SWAP_16(src[3]);
+    val[4] = ROM_SWAP_16(src[4]);
+    val[5] = ROM_SWAP_16(src[5]);
+    val[6] = ROM_SWAP_16(src[6]);
+    val[7] = ROM_SWAP_16(src[7]);
+
+    memcpy(&dest[2 * k], val, sizeof(val));
+  }
+#endif
+
+  /* remaining words */
+  for (; k < num_words; k++)
+  {
+    dest[2 * k + 0] = (data[k] >> 8) & 0xFF;
+    dest[2 * k + 1] = data[k] & 0xFF;
+  }
 
   return 0;
 }
@@ -249,8 +541,6 @@ int rom_add_chunk_bytes(unsigned char* data, unsigned long num_bytes)
 /******************************************************************************/
 int rom_add_chunk_words(unsigned short* data, unsigned long num_words)
 {
-  unsigned long  k;
-
   unsigned short num_chunks;
 
   unsigned long  data_block_addr;
@@ -263,6 +553,8 @@ int rom_add_chunk_words(unsigned short* data, unsigned long num_words)
   if (num_words == 0)
     return 0;
 
+  STATS_BEGIN(STATS_PHASE_CHUNKS);
+
   /* create new chunk */
   if (rom_create_chunk(2 * num_words))
     return 1;
@@ -275,10 +567,36 @@ int rom_add_chunk_words(unsigned short* data, unsigned long num_words)
   ROM_READ_24BE(chunk_addr, ROM_CHUNK_ADDR_LOC(num_chunks - 1))
 
   /* copy the data to the chunk */
-  for (k = 0; k < num_words; k++)
-  {
-    ROM_WRITE_16BE(data_block_addr + chunk_addr + 2 * k, data[k])
-  }
+  rom_write_words(&G_rom_data[data_block_addr + chunk_addr], data, num_words);
+
+  STATS_END(STATS_PHASE_CHUNKS);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_write_header()                                                         */
+/******************************************************************************/
+int rom_write_header(unsigned char* header)
+{
+  if (header == NULL)
+    return 1;
+
+  /* signature */
+  header[0] = 'K';
+  header[1] = 'U';
+  header[2] = 'N';
+  header[3] = 'O';
+  header[4] = 'I';
+  header[5] = 'C';
+  header[6] = 'H';
+  header[7] = 'I';
+
+  /* type */
+  header[8] = 'C';
+  header[9] = 'A';
+  header[10] = 'R';
+  header[11] = 'T';
 
   return 0;
 }
@@ -289,9 +607,11 @@ int rom_add_chunk_words(unsigned short* data, unsigned long num_words)
 int rom_save(char* filename)
 {
   FILE* fp;
+  int   fd;
 
-  char signature[8];
-  char type[4];
+  char* temp_filename;
+
+  unsigned char header[ROM_HEADER_BYTES];
 
   /* make sure filename is valid */
   if (filename == NULL)
@@ -301,40 +621,277 @@ int rom_save(char* filename)
   if (rom_validate())
     return 1;
 
-  /* open the rom file */
-  fp = fopen(filename, "wb");
+  /* the rom is written to a temp file and renamed over the old */
+  /* one, so a reader (or a failed save) never sees half a rom  */
+  /* (it is in the same folder, so the rename stays on one disk) */
+  temp_filename = malloc(strlen(filename) + ROM_TEMP_SUFFIX_SIZE);
+
+  if (temp_filename == NULL)
+    return 1;
+
+  sprintf(temp_filename, "%s.%lu.%lu.tmp", filename, 
+          (unsigned long) getpid(), __sync_fetch_and_add(&S_rom_num_saves, 1));
+
+  STATS_BEGIN(STATS_PHASE_WRITE);
+  TRACE_BEGIN("rom", "save");
+
+  /* create the temp file (failing if it somehow exists already) */
+  fp = NULL;
+  fd = open(temp_filename, O_WRONLY | O_CREAT | O_EXCL, 0666);
+
+  if (fd >= 0)
+  {
+    fp = fdopen(fd, "wb");
+
+    if (fp == NULL)
+    {
+      close(fd);
+      remove(temp_filename);
+    }
+  }
 
   if (fp == NULL)
+  {
+    TRACE_END();
+    free(temp_filename);
     return 1;
+  }
 
   /* write cart header */
-  signature[0] = 'K';
-  signature[1] = 'U';
-  signature[2] = 'N';
-  signature[3] = 'O';
-  signature[4] = 'I';
-  signature[5] = 'C';
-  signature[6] = 'H';
-  signature[7] = 'I';
-
-  type[0] = 'C';
-  type[1] = 'A';
-  type[2] = 'R';
-  type[3] = 'T';
-
-  if (fwrite(signature, sizeof(char), 8, fp) < 8)
-    return 1;
+  rom_write_header(header);
 
-  if (fwrite(type, sizeof(char), 4, fp) < 4)
-    return 1;
+  if (fwrite(header, sizeof(unsigned char), ROM_HEADER_BYTES, fp) < ROM_HEADER_BYTES)
+    goto nope;
 
   /* write rom data */
   if (fwrite(G_rom_data, sizeof(unsigned char), G_rom_size, fp) < G_rom_size)
-    return 1;
+    goto nope;
 
   /* close the rom file */
-  fclose(fp);
+  if (fclose(fp))
+  {
+    fp = NULL;
+    goto nope;
+  }
+
+  fp = NULL;
+
+  if (rename(temp_filename, filename))
+    goto nope;
+
+  free(temp_filename);
+
+  STATS_END(STATS_PHASE_WRITE);
+  TRACE_END();
 
   return 0;
+
+nope:
+  if (fp != NULL)
+    fclose(fp);
+
+  remove(temp_filename);
+  free(temp_filename);
+
+  TRACE_END();
+  return 1;
 }
 
+/******************************************************************************/
+/* rom_save_buffer()                                                          */
+/******************************************************************************/
+int rom_save_buffer(unsigned char* buf, unsigned long buf_size, unsigned long* num_bytes)
+{
+  if (num_bytes == NULL)
+    return 1;
+
+  /* the size is returned even if the buffer is too small */
+  *num_bytes = ROM_HEADER_BYTES + G_rom_size;
+
+  /* make sure buffer is valid */
+  if ((buf == NULL) || (buf_size < *num_bytes))
+    return 1;
+
+  /* make sure the rom is valid */
+  if (rom_validate())
+    return 1;
+
+  /* write cart header and rom data */
+  STATS_BEGIN(STATS_PHASE_WRITE);
+
+  rom_write_header(buf);
+
+  memcpy(&buf[ROM_HEADER_BYTES], G_rom_data, G_rom_size);
+
+  STATS_END(STATS_PHASE_WRITE);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_report_estimate()                                                      */
+/******************************************************************************/
+int rom_report_estimate(unsigned long num_bytes)
+{
+  /* num_bytes is the size of all chunks and their table entries */
+  num_bytes += ROM_CHUNK_TABLE_COUNT_BYTES;
+
+  printf("Estimated ROM Bytes: %lu (max %d)\n", num_bytes, ROM_MAX_BYTES);
+
+  if (num_bytes >= ROM_MAX_BYTES)
+  {
+    printf("Limit May Be Exceeded: ROM_MAX_BYTES\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_write_report()                                                         */
+/******************************************************************************/
+int rom_write_report(FILE* fp)
+{
+  unsigned short k;
+
+  unsigned short num_chunks;
+
+  unsigned long  chunk_addr;
+  unsigned long  chunk_size;
+
+  if (fp == NULL)
+    return 1;
+
+  if (G_rom_size < ROM_CHUNK_TABLE_COUNT_BYTES)
+    return 1;
+
+  ROM_READ_16BE(num_chunks, 0)
+
+  fprintf(fp, "  \"rom\": {\n");
+  fprintf(fp, "    \"bytes\": %lu, \"max_bytes\": %d, \"headroom\": %lu,\n", 
+          G_rom_size, ROM_MAX_BYTES, ROM_MAX_BYTES - G_rom_size);
+  fprintf(fp, "    \"file_bytes\": %lu,\n", ROM_HEADER_BYTES + G_rom_size);
+
+  /* chunk addresses are relative to the end of the chunk table */
+  fprintf(fp, "    \"chunks\": [\n");
+
+  for (k = 0; k < num_chunks; k++)
+  {
+    ROM_READ_24BE(chunk_addr, ROM_CHUNK_ADDR_LOC(k))
+    ROM_READ_24BE(chunk_size, ROM_CHUNK_SIZE_LOC(k))
+
+    fprintf(fp, "      {\"index\": %d, \"addr\": %lu, \"bytes\": %lu}%s\n", 
+            k, chunk_addr, chunk_size, (k + 1 < num_chunks) ? "," : "");
+  }
+
+  fprintf(fp, "    ]\n");
+  fprintf(fp, "  }\n");
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_set_chunk_owner()                                                      */
+/******************************************************************************/
+int rom_set_chunk_owner(char* owner)
+{
+  if (owner == NULL)
+    return 1;
+
+  /* long paths keep their end, which names the folder */
+  if (strlen(owner) >= ROM_MAP_OWNER_SIZE)
+    owner += strlen(owner) - (ROM_MAP_OWNER_SIZE - 1);
+
+  strcpy(S_rom_map_owner, owner);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_set_chunk_name()                                                       */
+/******************************************************************************/
+int rom_set_chunk_name(const char* name)
+{
+  /* this names the next chunk created (a static string) */
+  S_rom_map_name = name;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* rom_find_chunk()                                                           */
+/******************************************************************************/
+int rom_find_chunk(const char* name, unsigned long* file_addr)
+{
+  unsigned short k;
+  unsigned short num_chunks;
+
+  unsigned long  chunk_addr;
+
+  if ((name == NULL) || (file_addr == NULL))
+    return 1;
+
+  if (G_rom_size < ROM_CHUNK_TABLE_COUNT_BYTES)
+    return 1;
+
+  ROM_READ_16BE(num_chunks, 0)
+
+  /* the latest chunk with this name (the folders are added in order) */
+  for (k = num_chunks; k > 0; k--)
+  {
+    if ((k - 1 >= ROM_MAP_MAX_CHUNKS) || strcmp(S_rom_map[k - 1].name, name))
+      continue;
+
+    ROM_READ_24BE(chunk_addr, ROM_CHUNK_ADDR_LOC(k - 1))
+
+    *file_addr = ROM_HEADER_BYTES + ROM_CHUNK_TABLE_SIZE(num_chunks) + chunk_addr;
+
+    return 0;
+  }
+
+  return 1;
+}
+
+/******************************************************************************/
+/* rom_write_map()                                                            */
+/******************************************************************************/
+int rom_write_map(FILE* fp)
+{
+  unsigned short k;
+
+  unsigned short num_chunks;
+
+  unsigned long  chunk_addr;
+  unsigned long  chunk_size;
+
+  if (fp == NULL)
+    return 1;
+
+  if (G_rom_size < ROM_CHUNK_TABLE_COUNT_BYTES)
+    return 1;
+
+  ROM_READ_16BE(num_chunks, 0)
+
+  /* the chunks are stored in table order, so this is sorted by address */
+  fprintf(fp, "[header]\n");
+  fprintf(fp, "%08X %08X cart_header\n", 0, ROM_HEADER_BYTES);
+  fprintf(fp, "%08X %08lX chunk_table\n", 
+          ROM_HEADER_BYTES, (unsigned long) ROM_CHUNK_TABLE_SIZE(num_chunks));
+
+  fprintf(fp, "\n[chunks]\n");
+  fprintf(fp, "# address size     index name owner\n");
+
+  for (k = 0; k < num_chunks; k++)
+  {
+    ROM_READ_24BE(chunk_addr, ROM_CHUNK_ADDR_LOC(k))
+    ROM_READ_24BE(chunk_size, ROM_CHUNK_SIZE_LOC(k))
+
+    fprintf(fp, "%08lX %08lX %5d %s %s\n", 
+            ROM_HEADER_BYTES + ROM_CHUNK_TABLE_SIZE(num_chunks) + chunk_addr, 
+            chunk_size, k,
+            ((k < ROM_MAP_MAX_CHUNKS) && (S_rom_map[k].name[0] != '\0')) ? S_rom_map[k].name : "-",
+            ((k < ROM_MAP_MAX_CHUNKS) && (S_rom_map[k].owner[0] != '\0')) ? S_rom_map[k].owner : "-");
+  }
+
+  return 0;
+}
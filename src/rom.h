@@ -5,18 +5,36 @@
 #ifndef ROM_H
 #define ROM_H
 
-extern unsigned char G_rom_data[];
-extern unsigned long G_rom_size;
+extern __thread unsigned char* G_rom_data;
+extern __thread unsigned long G_rom_size;
 
 /* function declarations */
+unsigned long rom_buffers_size();
+int rom_bind_buffers(unsigned char* buf);
+int rom_print_memory();
+
 int rom_clear();
 int rom_validate();
 int rom_format();
 
 int rom_add_chunk_bytes(unsigned char*  data, unsigned long num_bytes);
 int rom_add_chunk_words(unsigned short* data, unsigned long num_words);
+int rom_write_words(unsigned char* dest, unsigned short* data, unsigned long num_words);
+
+unsigned char* rom_reserve_tail(unsigned long offset, unsigned long* num_bytes);
+int rom_mark_used(unsigned char* end);
+int rom_add_checksum_chunk();
 
 int rom_save(char* filename);
+int rom_save_buffer(unsigned char* buf, unsigned long buf_size, unsigned long* num_bytes);
+
+int rom_report_estimate(unsigned long num_bytes);
+int rom_write_report(FILE* fp);
+
+int rom_set_chunk_owner(char* owner);
+int rom_set_chunk_name(const char* name);
+int rom_find_chunk(const char* name, unsigned long* file_addr);
+int rom_write_map(FILE* fp);
 
 #endif
 
@@ -0,0 +1,117 @@
+/******************************************************************************/
+/* stats.c (pack timing and counters)                                         */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+static const char* S_stats_phase_names[STATS_NUM_PHASES] = 
+  { "Directory Scan", 
+    "GIF Parsing", 
+    "  LZW Decode", 
+    "  Compositing", 
+    "Ping-Pong Check", 
+    "Cell Packing", 
+    "Chunk Insertion", 
+    "File Write" 
+  };
+
+static const char* S_stats_counter_names[STATS_NUM_COUNTERS] = 
+  { "Files", 
+    "Bytes Read", 
+    "LZW Codes", 
+    "Clear Codes", 
+    "Pixels", 
+    "Cells Emitted", 
+    "Chunks", 
+    "Memmove Bytes" 
+  };
+
+__thread unsigned char G_stats_enabled;
+__thread unsigned long G_stats_counters[STATS_NUM_COUNTERS];
+
+static __thread unsigned long S_stats_phase_ns[STATS_NUM_PHASES];
+static __thread unsigned long S_stats_phase_calls[STATS_NUM_PHASES];
+
+static __thread struct timespec S_stats_phase_start[STATS_NUM_PHASES];
+
+/******************************************************************************/
+/* stats_clear()                                                              */
+/******************************************************************************/
+int stats_clear()
+{
+  unsigned short k;
+
+  for (k = 0; k < STATS_NUM_PHASES; k++)
+  {
+    S_stats_phase_ns[k] = 0;
+    S_stats_phase_calls[k] = 0;
+  }
+
+  for (k = 0; k < STATS_NUM_COUNTERS; k++)
+    G_stats_counters[k] = 0;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* stats_begin()                                                              */
+/******************************************************************************/
+int stats_begin(unsigned short phase)
+{
+  if (phase >= STATS_NUM_PHASES)
+    return 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &S_stats_phase_start[phase]);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* stats_end()                                                                */
+/******************************************************************************/
+int stats_end(unsigned short phase)
+{
+  struct timespec t;
+
+  if (phase >= STATS_NUM_PHASES)
+    return 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  S_stats_phase_ns[phase] += (t.tv_sec - S_stats_phase_start[phase].tv_sec) * 1000000000L;
+  S_stats_phase_ns[phase] += t.tv_nsec - S_stats_phase_start[phase].tv_nsec;
+
+  S_stats_phase_calls[phase] += 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* stats_print()                                                              */
+/******************************************************************************/
+int stats_print()
+{
+  unsigned short k;
+
+  printf("Stats:\n");
+
+  for (k = 0; k < STATS_NUM_PHASES; k++)
+  {
+    printf("  %-18s %10.3f ms  (%lu calls)\n", 
+           S_stats_phase_names[k], 
+           S_stats_phase_ns[k] / 1000000.0, 
+           S_stats_phase_calls[k]);
+  }
+
+  for (k = 0; k < STATS_NUM_COUNTERS; k++)
+    printf("  %-18s %10lu\n", S_stats_counter_names[k], G_stats_counters[k]);
+
+  return 0;
+}
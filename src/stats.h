@@ -0,0 +1,57 @@
+/******************************************************************************/
+/* stats.h (pack timing and counters)                                         */
+/******************************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+/* phases (the gif phases are nested inside gif parsing) */
+enum
+{
+  STATS_PHASE_SCAN = 0,
+  STATS_PHASE_PARSE,
+  STATS_PHASE_LZW,
+  STATS_PHASE_COMPOSITE,
+  STATS_PHASE_PING_PONG,
+  STATS_PHASE_CELLS,
+  STATS_PHASE_CHUNKS,
+  STATS_PHASE_WRITE,
+  STATS_NUM_PHASES
+};
+
+/* counters */
+enum
+{
+  STATS_COUNT_FILES = 0,
+  STATS_COUNT_BYTES_READ,
+  STATS_COUNT_LZW_CODES,
+  STATS_COUNT_CLEAR_CODES,
+  STATS_COUNT_PIXELS,
+  STATS_COUNT_CELLS,
+  STATS_COUNT_CHUNKS,
+  STATS_COUNT_MEMMOVE_BYTES,
+  STATS_NUM_COUNTERS
+};
+
+extern __thread unsigned char G_stats_enabled;
+extern __thread unsigned long G_stats_counters[];
+
+/* when stats are disabled, these only cost a test and a branch */
+#define STATS_BEGIN(phase)                                                     \
+  do { if (G_stats_enabled) stats_begin(phase); } while (0)
+
+#define STATS_END(phase)                                                       \
+  do { if (G_stats_enabled) stats_end(phase); } while (0)
+
+#define STATS_COUNT(counter, num)                                              \
+  do { if (G_stats_enabled) G_stats_counters[counter] += (num); } while (0)
+
+/* function declarations */
+int stats_clear();
+
+int stats_begin(unsigned short phase);
+int stats_end(unsigned short phase);
+
+int stats_print();
+
+#endif
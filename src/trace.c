@@ -0,0 +1,265 @@
+/******************************************************************************/
+/* trace.c (timeline of the pack pipeline)                                    */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+#include <time.h>
+
+#include "trace.h"
+
+/* the trace is written in the chrome trace event format, which can be */
+/* loaded by chrome://tracing or perfetto. each span is a complete     */
+/* ("X") event with its own thread id, and events are recorded from    */
+/* any thread into one shared table (slots are claimed atomically)     */
+
+#define TRACE_MAX_EVENTS      (1 << 16)
+#define TRACE_NAME_SIZE       96
+#define TRACE_MAX_DEPTH       16
+
+typedef struct trace_event
+{
+  char           name[TRACE_NAME_SIZE];
+  const char*    cat;
+  unsigned long  tid;
+  unsigned long  start_ns;
+  unsigned long  dur_ns;
+  unsigned char  ready;
+} trace_event;
+
+unsigned char G_trace_enabled;
+
+static char*          S_trace_filename;
+static struct timespec S_trace_origin;
+
+static trace_event*   S_trace_events;
+static unsigned long  S_trace_num_events;
+static unsigned long  S_trace_next_tid;
+
+static pthread_mutex_t S_trace_write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* each thread keeps a stack of its open spans */
+static __thread unsigned long  S_trace_tid;
+static __thread unsigned short S_trace_depth;
+static __thread unsigned long  S_trace_stack_start[TRACE_MAX_DEPTH];
+static __thread const char*    S_trace_stack_cat[TRACE_MAX_DEPTH];
+static __thread char           S_trace_stack_name[TRACE_MAX_DEPTH][TRACE_NAME_SIZE];
+
+/******************************************************************************/
+/* trace_now()                                                                */
+/******************************************************************************/
+unsigned long trace_now()
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return (t.tv_sec - S_trace_origin.tv_sec) * 1000000000UL + t.tv_nsec - S_trace_origin.tv_nsec;
+}
+
+/******************************************************************************/
+/* trace_open()                                                               */
+/******************************************************************************/
+int trace_open(char* filename)
+{
+  if (filename == NULL)
+    return 1;
+
+  if (S_trace_events != NULL)
+    return 1;
+
+  S_trace_events = calloc(TRACE_MAX_EVENTS, sizeof(trace_event));
+
+  if (S_trace_events == NULL)
+    return 1;
+
+  S_trace_filename = filename;
+  S_trace_num_events = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &S_trace_origin);
+
+  G_trace_enabled = 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* trace_close()                                                              */
+/******************************************************************************/
+int trace_close()
+{
+  int result;
+
+  if (S_trace_events == NULL)
+    return 1;
+
+  result = trace_write();
+
+  G_trace_enabled = 0;
+
+  free(S_trace_events);
+  S_trace_events = NULL;
+
+  return result;
+}
+
+/******************************************************************************/
+/* trace_begin()                                                              */
+/******************************************************************************/
+int trace_begin(const char* cat, const char* name)
+{
+  if (S_trace_events == NULL)
+    return 1;
+
+  if (S_trace_tid == 0)
+    S_trace_tid = __sync_add_and_fetch(&S_trace_next_tid, 1);
+
+  /* spans past the maximum depth are still counted, but not recorded */
+  if (S_trace_depth < TRACE_MAX_DEPTH)
+  {
+    S_trace_stack_start[S_trace_depth] = trace_now();
+    S_trace_stack_cat[S_trace_depth] = cat;
+
+    /* the name is copied, since path buffers are reused */
+    strncpy(S_trace_stack_name[S_trace_depth], name, TRACE_NAME_SIZE - 1);
+    S_trace_stack_name[S_trace_depth][TRACE_NAME_SIZE - 1] = '\0';
+  }
+
+  S_trace_depth += 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* trace_end()                                                                */
+/******************************************************************************/
+int trace_end()
+{
+  unsigned long index;
+  trace_event*  e;
+
+  if ((S_trace_events == NULL) || (S_trace_depth == 0))
+    return 1;
+
+  S_trace_depth -= 1;
+
+  if (S_trace_depth >= TRACE_MAX_DEPTH)
+    return 0;
+
+  /* claim an event slot (the trace stops growing once it is full) */
+  if (S_trace_num_events >= TRACE_MAX_EVENTS)
+    return 1;
+
+  index = __sync_fetch_and_add(&S_trace_num_events, 1);
+
+  if (index >= TRACE_MAX_EVENTS)
+    return 1;
+
+  e = &S_trace_events[index];
+
+  strcpy(e->name, S_trace_stack_name[S_trace_depth]);
+
+  e->cat = S_trace_stack_cat[S_trace_depth];
+  e->tid = S_trace_tid;
+  e->start_ns = S_trace_stack_start[S_trace_depth];
+  e->dur_ns = trace_now() - e->start_ns;
+
+  /* publish the event */
+  __sync_synchronize();
+  e->ready = 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* trace_write_string()                                                       */
+/******************************************************************************/
+int trace_write_string(FILE* fp, const char* s)
+{
+  fputc('"', fp);
+
+  for (; *s != '\0'; s++)
+  {
+    if ((*s == '"') || (*s == '\\'))
+      fprintf(fp, "\\%c", *s);
+    else if ((unsigned char) *s < 0x20)
+      fprintf(fp, "\\u%04x", (unsigned char) *s);
+    else
+      fputc(*s, fp);
+  }
+
+  fputc('"', fp);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* trace_write()                                                              */
+/******************************************************************************/
+int trace_write()
+{
+  FILE* fp;
+
+  unsigned long k;
+  unsigned long num_events;
+
+  unsigned char first;
+
+  if (S_trace_events == NULL)
+    return 1;
+
+  /* the whole trace is rewritten each time (for the watch and daemon modes) */
+  pthread_mutex_lock(&S_trace_write_lock);
+
+  fp = fopen(S_trace_filename, "w");
+
+  if (fp == NULL)
+  {
+    pthread_mutex_unlock(&S_trace_write_lock);
+    return 1;
+  }
+
+  num_events = S_trace_num_events;
+
+  if (num_events > TRACE_MAX_EVENTS)
+    num_events = TRACE_MAX_EVENTS;
+
+  fprintf(fp, "{\"traceEvents\":[\n");
+
+  first = 1;
+
+  for (k = 0; k < num_events; k++)
+  {
+    /* skip the events that are still being filled in */
+    if (!S_trace_events[k].ready)
+      continue;
+
+    if (!first)
+      fprintf(fp, ",\n");
+
+    fprintf(fp, "{\"name\":");
+    trace_write_string(fp, S_trace_events[k].name);
+    fprintf(fp, ",\"cat\":");
+    trace_write_string(fp, S_trace_events[k].cat);
+
+    fprintf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%lu.%03lu,\"dur\":%lu.%03lu}", 
+            S_trace_events[k].tid, 
+            S_trace_events[k].start_ns / 1000, S_trace_events[k].start_ns % 1000, 
+            S_trace_events[k].dur_ns / 1000, S_trace_events[k].dur_ns % 1000);
+
+    first = 0;
+  }
+
+  fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  fclose(fp);
+
+  pthread_mutex_unlock(&S_trace_write_lock);
+
+  return 0;
+}
@@ -0,0 +1,27 @@
+/******************************************************************************/
+/* trace.h (timeline of the pack pipeline)                                    */
+/******************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+extern unsigned char G_trace_enabled;
+
+/* spans nest within each thread; when tracing is off, */
+/* these only cost a test and a branch                 */
+#define TRACE_BEGIN(cat, name)                                                 \
+  do { if (G_trace_enabled) trace_begin(cat, name); } while (0)
+
+#define TRACE_END()                                                            \
+  do { if (G_trace_enabled) trace_end(); } while (0)
+
+/* function declarations */
+int trace_open(char* filename);
+int trace_close();
+
+int trace_begin(const char* cat, const char* name);
+int trace_end();
+
+int trace_write();
+
+#endif
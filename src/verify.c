@@ -0,0 +1,338 @@
+/******************************************************************************/
+/* verify.c (check a rom file against its checksums)                          */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "verify.h"
+
+#include "crc.h"
+#include "rom.h"
+
+/* the file layout (see rom.c): cart header, chunk */
+/* table, chunk data, and the optional checksum    */
+/* chunk last ("KCRC", count, crc-32 per chunk)    */
+#define VERIFY_HEADER_BYTES        12
+#define VERIFY_TABLE_COUNT_BYTES   2
+#define VERIFY_TABLE_ENTRY_BYTES   6
+
+#define VERIFY_CHECKSUM_HEADER_BYTES 6
+#define VERIFY_CHECKSUM_ENTRY_BYTES  4
+
+#define VERIFY_MAX_THREADS         16
+
+/* large chunks are split into ranges, so one big chunk  */
+/* is checked by several threads (the range crcs are     */
+/* combined into the chunk crc afterwards)               */
+#define VERIFY_RANGE_BYTES         (1UL << 20)
+
+#define VERIFY_READ_16BE(p)                                                    \
+  ((((unsigned long) (p)[0]) << 8) | ((unsigned long) (p)[1]))
+
+#define VERIFY_READ_24BE(p)                                                    \
+  ((((unsigned long) (p)[0]) << 16) | (((unsigned long) (p)[1]) << 8) |        \
+   ((unsigned long) (p)[2]))
+
+#define VERIFY_READ_32BE(p)                                                    \
+  ((((unsigned long) (p)[0]) << 24) | (((unsigned long) (p)[1]) << 16) |       \
+   (((unsigned long) (p)[2]) << 8) | ((unsigned long) (p)[3]))
+
+/* one piece of a chunk */
+struct verify_range
+{
+  unsigned long  addr;
+  unsigned long  size;
+  unsigned long  crc;
+};
+
+/* the job shared by the checking threads (ranges are claimed in order) */
+struct verify_job
+{
+  unsigned char* data_block;
+
+  struct verify_range* ranges;
+
+  unsigned long  num_ranges;
+  unsigned long  next_range;
+};
+
+/******************************************************************************/
+/* verify_check_chunks()                                                      */
+/******************************************************************************/
+void* verify_check_chunks(void* arg)
+{
+  struct verify_job* job;
+  struct verify_range* range;
+
+  unsigned long k;
+
+  job = (struct verify_job*) arg;
+
+  while (1)
+  {
+    k = __sync_fetch_and_add(&job->next_range, 1);
+
+    if (k >= job->num_ranges)
+      break;
+
+    range = &job->ranges[k];
+    range->crc = crc_32(&job->data_block[range->addr], range->size);
+  }
+
+  return NULL;
+}
+
+/******************************************************************************/
+/* verify_rom_file()                                                          */
+/******************************************************************************/
+int verify_rom_file(char* filename, unsigned short num_threads)
+{
+  int fd;
+  struct stat st;
+
+  unsigned char* map;
+  unsigned long  map_size;
+
+  unsigned char* old_rom_data;
+  unsigned long  old_rom_size;
+  int            result;
+
+  unsigned long  num_chunks;
+  unsigned long  data_block_addr;
+  unsigned long  last_addr;
+  unsigned long  last_size;
+  unsigned char* last;
+
+  struct verify_job job;
+
+  unsigned char* table;
+  unsigned char* checksums;
+  unsigned long  num_checked;
+  unsigned long  num_failed;
+
+  unsigned long  chunk_addr;
+  unsigned long  chunk_size;
+  unsigned long  offset;
+  unsigned long  crc;
+  unsigned long  m;
+  unsigned long  n;
+
+  pthread_t threads[VERIFY_MAX_THREADS];
+  unsigned short num_started;
+  unsigned short k;
+
+  struct timespec t1;
+  struct timespec t2;
+
+  if (filename == NULL)
+    return 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  /* map the rom file */
+  fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+  {
+    printf("Could not open rom: %s\n", filename);
+    return 1;
+  }
+
+  if (fstat(fd, &st) || (st.st_size < VERIFY_HEADER_BYTES + VERIFY_TABLE_COUNT_BYTES))
+  {
+    printf("Not a rom file: %s\n", filename);
+    close(fd);
+    return 1;
+  }
+
+  map_size = st.st_size;
+  map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  close(fd);
+
+  if (map == MAP_FAILED)
+  {
+    printf("Could not map rom: %s\n", filename);
+    return 1;
+  }
+
+  job.ranges = NULL;
+
+  if (memcmp(map, "KUNOICHICART", VERIFY_HEADER_BYTES))
+  {
+    printf("Not a rom file: %s\n", filename);
+    goto nope;
+  }
+
+  /* the chunk table checks are the packer's own, run on the mapped */
+  /* file (this thread's rom binding is put back afterwards)        */
+  old_rom_data = G_rom_data;
+  old_rom_size = G_rom_size;
+
+  G_rom_data = map + VERIFY_HEADER_BYTES;
+  G_rom_size = map_size - VERIFY_HEADER_BYTES;
+
+  result = rom_validate();
+
+  G_rom_data = old_rom_data;
+  G_rom_size = old_rom_size;
+
+  if (result)
+  {
+    printf("Chunk table is not valid: %s\n", filename);
+    goto nope;
+  }
+
+  num_chunks = VERIFY_READ_16BE(&map[VERIFY_HEADER_BYTES]);
+  data_block_addr = VERIFY_HEADER_BYTES + VERIFY_TABLE_COUNT_BYTES + VERIFY_TABLE_ENTRY_BYTES * num_chunks;
+
+  /* find the checksum chunk (the last one, if it covers the rest) */
+  last = NULL;
+
+  if (num_chunks > 0)
+  {
+    last_addr = VERIFY_READ_24BE(&map[data_block_addr - VERIFY_TABLE_ENTRY_BYTES]);
+    last_size = VERIFY_READ_24BE(&map[data_block_addr - VERIFY_TABLE_ENTRY_BYTES + 3]);
+
+    last = &map[data_block_addr + last_addr];
+
+    if ((last_size != VERIFY_CHECKSUM_HEADER_BYTES + VERIFY_CHECKSUM_ENTRY_BYTES * (num_chunks - 1)) ||
+        memcmp(last, "KCRC", 4) ||
+        (VERIFY_READ_16BE(&last[4]) != num_chunks - 1))
+    {
+      last = NULL;
+    }
+  }
+
+  if (last == NULL)
+  {
+    printf("Chunk table is valid, but the rom has no checksums: %s\n", filename);
+    goto nope;
+  }
+
+  table = &map[VERIFY_HEADER_BYTES + VERIFY_TABLE_COUNT_BYTES];
+  checksums = &last[VERIFY_CHECKSUM_HEADER_BYTES];
+  num_checked = num_chunks - 1;
+
+  /* split the chunks into ranges (an empty chunk is one empty range) */
+  job.num_ranges = 0;
+
+  for (m = 0; m < num_checked; m++)
+  {
+    chunk_size = VERIFY_READ_24BE(&table[VERIFY_TABLE_ENTRY_BYTES * m + 3]);
+
+    job.num_ranges += (chunk_size > 0) ? (chunk_size + VERIFY_RANGE_BYTES - 1) / VERIFY_RANGE_BYTES : 1;
+  }
+
+  job.ranges = malloc((job.num_ranges + 1) * sizeof(struct verify_range));
+
+  if (job.ranges == NULL)
+    goto nope;
+
+  n = 0;
+
+  for (m = 0; m < num_checked; m++)
+  {
+    chunk_addr = VERIFY_READ_24BE(&table[VERIFY_TABLE_ENTRY_BYTES * m]);
+    chunk_size = VERIFY_READ_24BE(&table[VERIFY_TABLE_ENTRY_BYTES * m + 3]);
+
+    offset = 0;
+
+    do
+    {
+      job.ranges[n].addr = chunk_addr + offset;
+      job.ranges[n].size = (chunk_size - offset > VERIFY_RANGE_BYTES) ? VERIFY_RANGE_BYTES : chunk_size - offset;
+      job.ranges[n].crc = 0;
+
+      offset += job.ranges[n].size;
+      n += 1;
+    } while (offset < chunk_size);
+  }
+
+  /* check the ranges in parallel */
+  job.data_block = &map[data_block_addr];
+  job.next_range = 0;
+
+  /* zero threads means one per processor */
+  if (num_threads == 0)
+    num_threads = (sysconf(_SC_NPROCESSORS_ONLN) > 0) ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+
+  if (num_threads > VERIFY_MAX_THREADS)
+    num_threads = VERIFY_MAX_THREADS;
+
+  if (num_threads > job.num_ranges)
+    num_threads = job.num_ranges;
+
+  num_started = 0;
+
+  for (k = 1; k < num_threads; k++)
+  {
+    if (pthread_create(&threads[num_started], NULL, verify_check_chunks, &job))
+      break;
+
+    num_started += 1;
+  }
+
+  /* this thread checks too (and alone, if no threads could start) */
+  verify_check_chunks(&job);
+
+  for (k = 0; k < num_started; k++)
+    pthread_join(threads[k], NULL);
+
+  /* combine the range crcs of each chunk, and check them */
+  num_failed = 0;
+  n = 0;
+
+  for (m = 0; m < num_checked; m++)
+  {
+    chunk_size = VERIFY_READ_24BE(&table[VERIFY_TABLE_ENTRY_BYTES * m + 3]);
+
+    crc = job.ranges[n].crc;
+    offset = job.ranges[n].size;
+    n += 1;
+
+    while (offset < chunk_size)
+    {
+      crc = crc_32_combine(crc, job.ranges[n].crc, job.ranges[n].size);
+      offset += job.ranges[n].size;
+      n += 1;
+    }
+
+    if (crc != VERIFY_READ_32BE(&checksums[VERIFY_CHECKSUM_ENTRY_BYTES * m]))
+    {
+      printf("Checksum Mismatch: chunk %lu\n", m);
+      num_failed += 1;
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t2);
+
+  printf("Verified %lu chunks (%lu bytes, %d threads) in %.3f ms: %s\n",
+         num_checked, map_size, num_started + 1,
+         (t2.tv_sec - t1.tv_sec) * 1000.0 + (t2.tv_nsec - t1.tv_nsec) / 1000000.0,
+         (num_failed == 0) ? "OK" : "FAILED");
+
+  if (num_failed > 0)
+    goto nope;
+
+  free(job.ranges);
+  munmap(map, map_size);
+
+  return 0;
+
+nope:
+  free(job.ranges);
+  munmap(map, map_size);
+  return 1;
+}
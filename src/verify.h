@@ -0,0 +1,11 @@
+/******************************************************************************/
+/* verify.h (check a rom file against its checksums)                          */
+/******************************************************************************/
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+/* function declarations */
+int verify_rom_file(char* filename, unsigned short num_threads);
+
+#endif
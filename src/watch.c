@@ -0,0 +1,427 @@
+/******************************************************************************/
+/* watch.c (rebuild the rom when the rom folder changes)                      */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <dirent.h>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "watch.h"
+
+#include "trace.h"
+
+/* the rebuild itself is a full pack; files that did not change */
+/* are found in the decoded asset cache, so only the edited     */
+/* files are decoded again                                      */
+
+/* one inotify instance is kept for the whole session. folders  */
+/* that are created (or moved in) get watches as they appear,   */
+/* and their watches are dropped when the kernel says they are  */
+/* gone. if the event queue overflows, it counts as a change    */
+/* and every folder is added again                              */
+
+#define WATCH_EVENT_MASK                                                       \
+  ( IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |                             \
+    IN_CREATE | IN_DELETE | IN_DELETE_SELF)
+
+/* root, folders (Sprites, etc), and subfolders */
+#define WATCH_MAX_DEPTH 2
+
+/* editors often write a file in several steps, */
+/* so wait for the events to settle down        */
+#define WATCH_SETTLE_MS 20
+
+#define WATCH_PATH_MAX_SIZE 1024
+
+#define WATCH_EVENT_BUFFER_SIZE (64 * (sizeof(struct inotify_event) + 256))
+
+#define WATCH_MAX_FOLDERS 4096
+
+/* the watched folders (by watch descriptor) */
+struct watch_folder
+{
+  int            wd;
+  unsigned short depth;
+  char*          path;
+};
+
+static int  S_watch_fd = -1;
+
+static struct watch_folder S_watch_folders[WATCH_MAX_FOLDERS];
+static unsigned short      S_watch_num_folders;
+
+static char S_watch_path_buf[WATCH_PATH_MAX_SIZE];
+
+static char S_watch_event_buf[WATCH_EVENT_BUFFER_SIZE];
+
+/******************************************************************************/
+/* watch_find_folder()                                                        */
+/******************************************************************************/
+int watch_find_folder(int wd, char* path)
+{
+  int k;
+
+  /* returns the index of the folder with this watch (or path), or -1 */
+  for (k = 0; k < S_watch_num_folders; k++)
+  {
+    if ((path == NULL) && (S_watch_folders[k].wd == wd))
+      return k;
+
+    if ((path != NULL) && !strcmp(S_watch_folders[k].path, path))
+      return k;
+  }
+
+  return -1;
+}
+
+/******************************************************************************/
+/* watch_record_folder()                                                      */
+/******************************************************************************/
+int watch_record_folder(int wd, unsigned short depth, char* path)
+{
+  int   index;
+  char* copy;
+
+  copy = malloc(strlen(path) + 1);
+
+  if (copy == NULL)
+    return 1;
+
+  strcpy(copy, path);
+
+  /* a folder that was moved within the tree keeps its watch */
+  index = watch_find_folder(wd, NULL);
+
+  if (index < 0)
+  {
+    if (S_watch_num_folders >= WATCH_MAX_FOLDERS)
+    {
+      free(copy);
+      return 1;
+    }
+
+    index = S_watch_num_folders;
+    S_watch_num_folders += 1;
+  }
+  else
+    free(S_watch_folders[index].path);
+
+  S_watch_folders[index].wd = wd;
+  S_watch_folders[index].depth = depth;
+  S_watch_folders[index].path = copy;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* watch_forget_folder()                                                      */
+/******************************************************************************/
+int watch_forget_folder(int wd)
+{
+  int index;
+
+  index = watch_find_folder(wd, NULL);
+
+  if (index < 0)
+    return 0;
+
+  free(S_watch_folders[index].path);
+
+  S_watch_num_folders -= 1;
+  S_watch_folders[index] = S_watch_folders[S_watch_num_folders];
+
+  return 0;
+}
+
+/******************************************************************************/
+/* watch_add_folder()                                                         */
+/******************************************************************************/
+int watch_add_folder(unsigned short depth)
+{
+  DIR* dp;
+  struct dirent* e;
+
+  int wd;
+
+  unsigned long len;
+
+  /* open the directory (if this is a file, just skip it) */
+  dp = opendir(S_watch_path_buf);
+
+  if (dp == NULL)
+    return 0;
+
+  wd = inotify_add_watch(S_watch_fd, S_watch_path_buf, WATCH_EVENT_MASK);
+
+  if (wd < 0)
+    goto nope;
+
+  if (watch_record_folder(wd, depth, S_watch_path_buf))
+    goto nope;
+
+  if (depth >= WATCH_MAX_DEPTH)
+    goto ok;
+
+  /* add the folders inside this one */
+  len = strlen(S_watch_path_buf);
+
+  e = readdir(dp);
+
+  while (e != NULL)
+  {
+    /* skip dot, dot-dot, and hidden files */
+    if (e->d_name[0] == '.')
+    {
+      e = readdir(dp);
+      continue;
+    }
+
+    if ((len + strlen(e->d_name) + 2) > WATCH_PATH_MAX_SIZE)
+      goto nope;
+
+    strcat(S_watch_path_buf, e->d_name);
+    strcat(S_watch_path_buf, "/");
+
+    if (watch_add_folder(depth + 1))
+      goto nope;
+
+    S_watch_path_buf[len] = '\0';
+
+    e = readdir(dp);
+  }
+
+  goto ok;
+
+nope:
+  closedir(dp);
+  return 1;
+
+ok:
+  closedir(dp);
+  return 0;
+}
+
+/******************************************************************************/
+/* watch_open_folders()                                                       */
+/******************************************************************************/
+int watch_open_folders(char* root_name)
+{
+  /* this is also the rescan after an overflow (folders that */
+  /* are already watched just get their watches back)        */
+  if (S_watch_fd < 0)
+    S_watch_fd = inotify_init();
+
+  if (S_watch_fd < 0)
+    return 1;
+
+  if ((strlen(root_name) + 4) > WATCH_PATH_MAX_SIZE)
+    return 1;
+
+  strcpy(S_watch_path_buf, "./");
+  strcat(S_watch_path_buf, root_name);
+  strcat(S_watch_path_buf, "/");
+
+  if (watch_add_folder(0))
+    return 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* watch_read_events()                                                        */
+/******************************************************************************/
+int watch_read_events(unsigned char* changed, unsigned char* rescan)
+{
+  long num_bytes;
+  long k;
+
+  int index;
+
+  struct inotify_event* ev;
+
+  do
+  {
+    num_bytes = read(S_watch_fd, S_watch_event_buf, WATCH_EVENT_BUFFER_SIZE);
+  } while ((num_bytes < 0) && (errno == EINTR));
+
+  if (num_bytes <= 0)
+    return 1;
+
+  for (k = 0; k < num_bytes; k += sizeof(struct inotify_event) + ev->len)
+  {
+    ev = (struct inotify_event*) &S_watch_event_buf[k];
+
+    /* events were lost, so anything may have changed */
+    if (ev->mask & IN_Q_OVERFLOW)
+    {
+      *changed = 1;
+      *rescan = 1;
+      continue;
+    }
+
+    /* the folder is gone (or was moved out), so its watch is too */
+    if (ev->mask & IN_IGNORED)
+    {
+      watch_forget_folder(ev->wd);
+      continue;
+    }
+
+    /* skip hidden files (editor swap files, etc) */
+    if ((ev->len > 0) && (ev->name[0] == '.'))
+      continue;
+
+    *changed = 1;
+
+    if (!(ev->mask & IN_ISDIR))
+      continue;
+
+    index = watch_find_folder(ev->wd, NULL);
+
+    if (index < 0)
+      continue;
+
+    if ((strlen(S_watch_folders[index].path) + strlen(ev->name) + 2) > WATCH_PATH_MAX_SIZE)
+      continue;
+
+    strcpy(S_watch_path_buf, S_watch_folders[index].path);
+    strcat(S_watch_path_buf, ev->name);
+    strcat(S_watch_path_buf, "/");
+
+    /* watch a new folder (and anything already inside it) */
+    if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) && (S_watch_folders[index].depth < WATCH_MAX_DEPTH))
+    {
+      if (watch_add_folder(S_watch_folders[index].depth + 1))
+        *rescan = 1;
+    }
+
+    /* stop watching a folder that was moved out */
+    if (ev->mask & IN_MOVED_FROM)
+    {
+      index = watch_find_folder(0, S_watch_path_buf);
+
+      if (index >= 0)
+        inotify_rm_watch(S_watch_fd, S_watch_folders[index].wd);
+    }
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* watch_rebuild()                                                            */
+/******************************************************************************/
+int watch_rebuild(kp_context* ctx, char* root_name, char* rom_filename)
+{
+  struct timespec t1;
+  struct timespec t2;
+
+  unsigned long ms;
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  /* keep the last rom if this one did not pack */
+  if (kp_pack_folder(ctx, root_name))
+  {
+    printf("Rebuild Failed: %s\n", root_name);
+    return 1;
+  }
+
+  if (kp_save_rom(ctx, rom_filename))
+  {
+    printf("Rebuild Failed: %s\n", rom_filename);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t2);
+
+  ms = (t2.tv_sec - t1.tv_sec) * 1000 + (t2.tv_nsec - t1.tv_nsec) / 1000000;
+
+  printf("Rebuilt %s in %lu ms\n", rom_filename, ms);
+
+  /* the trace covers every rebuild so far */
+  if (G_trace_enabled)
+    trace_write();
+
+  return 0;
+}
+
+/******************************************************************************/
+/* watch_run()                                                                */
+/******************************************************************************/
+int watch_run(kp_context* ctx, char* root_name, char* rom_filename)
+{
+  struct pollfd pfd;
+
+  unsigned char changed;
+  unsigned char rescan;
+
+  int k;
+
+  /* make sure context and names are valid */
+  if ((ctx == NULL) || (root_name == NULL) || (rom_filename == NULL))
+    return 1;
+
+  if (watch_open_folders(root_name))
+    return 1;
+
+  watch_rebuild(ctx, root_name, rom_filename);
+
+  printf("Watching: %s\n", root_name);
+
+  while (1)
+  {
+    pfd.fd = S_watch_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    /* wait for a change (a signal just means wait again) */
+    if (poll(&pfd, 1, -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      printf("Watch Failed: %s\n", strerror(errno));
+      break;
+    }
+
+    changed = 0;
+    rescan = 0;
+
+    if (watch_read_events(&changed, &rescan))
+      break;
+
+    /* gather any other events from the same save */
+    while (poll(&pfd, 1, WATCH_SETTLE_MS) > 0)
+    {
+      if (watch_read_events(&changed, &rescan))
+        break;
+    }
+
+    if (rescan && watch_open_folders(root_name))
+      break;
+
+    if (changed == 0)
+      continue;
+
+    watch_rebuild(ctx, root_name, rom_filename);
+  }
+
+  close(S_watch_fd);
+  S_watch_fd = -1;
+
+  for (k = 0; k < S_watch_num_folders; k++)
+    free(S_watch_folders[k].path);
+
+  S_watch_num_folders = 0;
+
+  return 1;
+}
@@ -0,0 +1,14 @@
+/******************************************************************************/
+/* watch.h (rebuild the rom when the rom folder changes)                      */
+/******************************************************************************/
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "kunopack.h"
+
+/* function declarations */
+int watch_rebuild(kp_context* ctx, char* root_name, char* rom_filename);
+int watch_run(kp_context* ctx, char* root_name, char* rom_filename);
+
+#endif
@@ -0,0 +1,642 @@
+/******************************************************************************/
+/* bench.c (microbenchmarks for the packer hot paths)                         */
+/******************************************************************************/
+
+/* the kernels are timed on the module state directly, so these */
+/* modules are compiled into the benchmark (the rest is linked) */
+#include "art.c"
+#include "con.c"
+#include "rom.c"
+
+#include "gifenc.h"
+#include "perfctr.h"
+
+#define BENCH_DEFAULT_WARMUP  5
+#define BENCH_DEFAULT_REPS    50
+#define BENCH_MAX_REPS        10000
+
+/* fixed inputs */
+#define BENCH_IMAGE_W_H       128 /* the largest sprite frame */
+#define BENCH_IMAGE_PIXELS    (BENCH_IMAGE_W_H * BENCH_IMAGE_W_H)
+#define BENCH_NUM_FRAMES      8
+
+#define BENCH_NUM_CHUNKS      64
+#define BENCH_CHUNK_WORDS     2048
+#define BENCH_NUM_SMALL_CHUNKS 1024
+#define BENCH_SMALL_CHUNK_BYTES 64
+
+#define BENCH_CON_NUM_SHEETS  512
+#define BENCH_CON_TEXT_SIZE   (BENCH_CON_NUM_SHEETS * 160)
+
+struct bench_kernel
+{
+  const char* name;
+  const char* units;
+  int (*setup)();
+  int (*reset)(); /* untimed, before each run (optional) */
+  int (*run)();
+};
+
+static unsigned long  S_bench_seed;
+static unsigned long  S_bench_units;
+
+static unsigned char  S_bench_pixels[BENCH_IMAGE_PIXELS];
+static unsigned char  S_bench_lzw[GIFENC_MAX_LZW_BYTES(BENCH_IMAGE_PIXELS)];
+static unsigned long  S_bench_lzw_size;
+
+static unsigned short S_bench_words[BENCH_CHUNK_WORDS];
+
+static char           S_bench_con_text[BENCH_CON_TEXT_SIZE];
+static FILE*          S_bench_con_fp;
+
+static unsigned long  S_bench_samples[BENCH_MAX_REPS];
+
+static unsigned char  S_bench_counters_flag;
+static unsigned long  S_bench_counter_totals[PERFCTR_NUM_COUNTERS];
+
+/******************************************************************************/
+/* bench_random()                                                             */
+/******************************************************************************/
+unsigned long bench_random()
+{
+  /* the inputs are the same on every run */
+  S_bench_seed = (S_bench_seed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+
+  return S_bench_seed >> 16;
+}
+
+/******************************************************************************/
+/* bench_now()                                                                */
+/******************************************************************************/
+unsigned long bench_now()
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+/******************************************************************************/
+/* bench_make_image()                                                         */
+/******************************************************************************/
+int bench_make_image(unsigned char* pixels, unsigned short pattern)
+{
+  unsigned long k;
+
+  unsigned char color;
+  unsigned short run;
+
+  /* runs of 16 colors, like drawn sprite art */
+  S_bench_seed = 1 + pattern;
+
+  color = 0;
+  run = 0;
+
+  for (k = 0; k < BENCH_IMAGE_PIXELS; k++)
+  {
+    if (run == 0)
+    {
+      color = bench_random() % VDP_COLORS_PER_PAL;
+      run = 1 + bench_random() % 12;
+    }
+
+    pixels[k] = color;
+    run -= 1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_setup_lzw()                                                          */
+/******************************************************************************/
+int bench_setup_lzw(unsigned short clear_interval)
+{
+  unsigned long k;
+
+  bench_make_image(S_bench_pixels, 0);
+
+  if (gifenc_lzw(S_bench_pixels, BENCH_IMAGE_PIXELS, 4, clear_interval, S_bench_lzw, &S_bench_lzw_size))
+    return 1;
+
+  memcpy(S_art_lzw_image_buf, S_bench_lzw, S_bench_lzw_size);
+
+  S_art_lzw_image_size = S_bench_lzw_size;
+  S_art_lzw_root_bits = 4;
+
+  /* make sure the stream decodes to the image */
+  if (art_gif_decompress_image())
+    return 1;
+
+  if (S_art_decomp_image_size != BENCH_IMAGE_PIXELS)
+    return 1;
+
+  for (k = 0; k < BENCH_IMAGE_PIXELS; k++)
+  {
+    if (S_art_decomp_image_buf[k] != S_bench_pixels[k])
+      return 1;
+  }
+
+  S_bench_units = BENCH_IMAGE_PIXELS;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_setup_lzw_decode()                                                   */
+/******************************************************************************/
+int bench_setup_lzw_decode()
+{
+  return bench_setup_lzw(0);
+}
+
+/******************************************************************************/
+/* bench_setup_lzw_decode_clears()                                            */
+/******************************************************************************/
+int bench_setup_lzw_decode_clears()
+{
+  return bench_setup_lzw(64);
+}
+
+/******************************************************************************/
+/* bench_run_lzw_decode()                                                     */
+/******************************************************************************/
+int bench_run_lzw_decode()
+{
+  return art_gif_decompress_image();
+}
+
+/******************************************************************************/
+/* bench_setup_add_cells()                                                    */
+/******************************************************************************/
+int bench_setup_add_cells()
+{
+  unsigned short k;
+
+  art_clear_rom_data_vars();
+  art_clear_image_vars();
+
+  for (k = 0; k < BENCH_NUM_FRAMES; k++)
+    bench_make_image(&S_art_pixels_buf[k * BENCH_IMAGE_PIXELS], k);
+
+  S_art_pixels_size = BENCH_NUM_FRAMES * BENCH_IMAGE_PIXELS;
+
+  S_art_image_w = BENCH_IMAGE_W_H;
+  S_art_image_h = BENCH_IMAGE_W_H;
+
+  S_art_frame_rows = BENCH_IMAGE_W_H / VDP_CELL_W_H;
+  S_art_frame_columns = BENCH_IMAGE_W_H / VDP_CELL_W_H;
+
+  S_art_num_frames = BENCH_NUM_FRAMES;
+  S_art_num_stored_frames = BENCH_NUM_FRAMES;
+  S_art_cell_depth = VDP_CELL_DEPTH_4BPP;
+
+  S_bench_units = BENCH_NUM_FRAMES * S_art_frame_rows * S_art_frame_columns;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_run_add_cells()                                                      */
+/******************************************************************************/
+int bench_run_add_cells()
+{
+  G_art_num_entries = 0;
+  G_art_num_cells = 0;
+
+  return art_add_cells();
+}
+
+/******************************************************************************/
+/* bench_setup_ping_pong()                                                    */
+/******************************************************************************/
+int bench_setup_ping_pong()
+{
+  unsigned short k;
+
+  art_clear_image_vars();
+
+  /* frames 1 and 2 are repeated at 7 and 6, but 5 differs from 3 */
+  /* in its last pixel, so the check does the most work it can    */
+  /* without changing the frames                                  */
+  for (k = 0; k < BENCH_NUM_FRAMES; k++)
+  {
+    if (k < 5)
+      bench_make_image(&S_art_pixels_buf[k * BENCH_IMAGE_PIXELS], k);
+    else
+      bench_make_image(&S_art_pixels_buf[k * BENCH_IMAGE_PIXELS], BENCH_NUM_FRAMES - k);
+  }
+
+  S_art_pixels_buf[6 * BENCH_IMAGE_PIXELS - 1] ^= 0x01;
+
+  S_art_pixels_size = BENCH_NUM_FRAMES * BENCH_IMAGE_PIXELS;
+
+  S_art_image_w = BENCH_IMAGE_W_H;
+  S_art_image_h = BENCH_IMAGE_W_H;
+  S_art_num_frames = BENCH_NUM_FRAMES;
+  S_art_angle_addr = 0;
+
+  S_bench_units = 3 * BENCH_IMAGE_PIXELS;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_run_ping_pong()                                                      */
+/******************************************************************************/
+int bench_run_ping_pong()
+{
+  if (art_check_for_ping_pong_animation())
+    return 1;
+
+  if (S_art_num_frames != BENCH_NUM_FRAMES)
+    return 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_setup_chunk_words()                                                  */
+/******************************************************************************/
+int bench_setup_chunk_words()
+{
+  unsigned short k;
+
+  S_bench_seed = 1;
+
+  for (k = 0; k < BENCH_CHUNK_WORDS; k++)
+    S_bench_words[k] = bench_random() & 0xFFFF;
+
+  S_bench_units = BENCH_NUM_CHUNKS;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_run_chunk_words()                                                    */
+/******************************************************************************/
+int bench_run_chunk_words()
+{
+  unsigned short k;
+
+  for (k = 0; k < BENCH_NUM_CHUNKS; k++)
+  {
+    if (rom_add_chunk_words(S_bench_words, BENCH_CHUNK_WORDS))
+      return 1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_setup_create_chunk()                                                 */
+/******************************************************************************/
+int bench_setup_create_chunk()
+{
+  S_bench_units = BENCH_NUM_SMALL_CHUNKS;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_run_create_chunk()                                                   */
+/******************************************************************************/
+int bench_run_create_chunk()
+{
+  unsigned short k;
+
+  /* each new table entry moves the whole data block */
+  for (k = 0; k < BENCH_NUM_SMALL_CHUNKS; k++)
+  {
+    if (rom_create_chunk(BENCH_SMALL_CHUNK_BYTES))
+      return 1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_setup_con_tokens()                                                   */
+/******************************************************************************/
+int bench_setup_con_tokens()
+{
+  unsigned short k;
+  unsigned long  size;
+
+  size = 0;
+
+  for (k = 0; k < BENCH_CON_NUM_SHEETS; k++)
+  {
+    size += sprintf(&S_bench_con_text[size],
+                    "sheet sheet_%d \"sheet_%d.gif\" 16 16\n{\n  sprite a_%d\n  sprite b_%d\n  sprite c_%d\n}\n",
+                    k, k, k, k, k);
+  }
+
+  if (S_bench_con_fp != NULL)
+    fclose(S_bench_con_fp);
+
+  perfctr_close();
+
+  S_bench_con_fp = fmemopen(S_bench_con_text, size, "r");
+
+  if (S_bench_con_fp == NULL)
+    return 1;
+
+  /* 5 tokens for the sheet line, 2 braces, 2 per sprite */
+  S_bench_units = BENCH_CON_NUM_SHEETS * 13;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* bench_run_con_tokens()                                                     */
+/******************************************************************************/
+int bench_run_con_tokens()
+{
+  unsigned long num_tokens;
+
+  rewind(S_bench_con_fp);
+
+  S_con_fp = S_bench_con_fp;
+  num_tokens = 0;
+
+  while (1)
+  {
+    if (con_advance_token())
+      return 1;
+
+    if (S_con_token == CON_TOKEN_EOF)
+      break;
+
+    num_tokens += 1;
+  }
+
+  S_con_fp = NULL;
+
+  if (num_tokens != S_bench_units)
+    return 1;
+
+  return 0;
+}
+
+static struct bench_kernel S_bench_kernels[] =
+  { { "lzw_decode",          "pixels", bench_setup_lzw_decode,        NULL,       bench_run_lzw_decode },
+    { "lzw_decode_clears",   "pixels", bench_setup_lzw_decode_clears, NULL,       bench_run_lzw_decode },
+    { "add_cells",           "cells",  bench_setup_add_cells,         NULL,       bench_run_add_cells },
+    { "ping_pong_check",     "pixels", bench_setup_ping_pong,         NULL,       bench_run_ping_pong },
+    { "rom_add_chunk_words", "chunks", bench_setup_chunk_words,       rom_format, bench_run_chunk_words },
+    { "rom_create_chunk",    "chunks", bench_setup_create_chunk,      rom_format, bench_run_create_chunk },
+    { "con_advance_token",   "tokens", bench_setup_con_tokens,        NULL,       bench_run_con_tokens }
+  };
+
+#define BENCH_NUM_KERNELS (sizeof(S_bench_kernels) / sizeof(S_bench_kernels[0]))
+
+/******************************************************************************/
+/* bench_compare_samples()                                                    */
+/******************************************************************************/
+int bench_compare_samples(const void* a, const void* b)
+{
+  unsigned long x;
+  unsigned long y;
+
+  x = *((const unsigned long*) a);
+  y = *((const unsigned long*) b);
+
+  return (x > y) - (x < y);
+}
+
+/******************************************************************************/
+/* bench_percentile()                                                         */
+/******************************************************************************/
+unsigned long bench_percentile(unsigned long num_reps, unsigned short percent)
+{
+  unsigned long index;
+
+  /* nearest rank, on the sorted samples */
+  index = (percent * num_reps + 99) / 100;
+
+  if (index > 0)
+    index -= 1;
+
+  return S_bench_samples[index];
+}
+
+/******************************************************************************/
+/* bench_run_kernel()                                                         */
+/******************************************************************************/
+int bench_run_kernel(struct bench_kernel* b, unsigned long num_warmup, unsigned long num_reps, unsigned char first)
+{
+  unsigned long k;
+
+  unsigned long t1;
+  unsigned long t2;
+  unsigned long total;
+
+  unsigned long counters[PERFCTR_NUM_COUNTERS];
+  int           n;
+
+  double median;
+  double per_unit;
+
+  if (b->setup())
+  {
+    fprintf(stderr, "Benchmark Setup Failed: %s\n", b->name);
+    return 1;
+  }
+
+  for (k = 0; k < num_warmup; k++)
+  {
+    if ((b->reset != NULL) && b->reset())
+      return 1;
+
+    if (b->run())
+    {
+      fprintf(stderr, "Benchmark Failed: %s\n", b->name);
+      return 1;
+    }
+  }
+
+  total = 0;
+
+  for (n = 0; n < PERFCTR_NUM_COUNTERS; n++)
+    S_bench_counter_totals[n] = 0;
+
+  for (k = 0; k < num_reps; k++)
+  {
+    if ((b->reset != NULL) && b->reset())
+      return 1;
+
+    /* the counters are started outside the timed region */
+    if (S_bench_counters_flag)
+      perfctr_start();
+
+    t1 = bench_now();
+
+    if (b->run())
+    {
+      fprintf(stderr, "Benchmark Failed: %s\n", b->name);
+      return 1;
+    }
+
+    t2 = bench_now();
+
+    if (S_bench_counters_flag)
+    {
+      perfctr_stop(counters);
+
+      for (n = 0; n < PERFCTR_NUM_COUNTERS; n++)
+        S_bench_counter_totals[n] += counters[n];
+    }
+
+    S_bench_samples[k] = t2 - t1;
+    total += t2 - t1;
+  }
+
+  qsort(S_bench_samples, num_reps, sizeof(unsigned long), bench_compare_samples);
+
+  median = (double) bench_percentile(num_reps, 50);
+
+  printf("%s    {\"name\": \"%s\", \"units\": \"%s\", \"units_per_run\": %lu, ",
+         first ? "" : ",\n", b->name, b->units, S_bench_units);
+  printf("\"warmup\": %lu, \"reps\": %lu, ", num_warmup, num_reps);
+  printf("\"min_ns\": %lu, \"median_ns\": %lu, \"p90_ns\": %lu, \"p99_ns\": %lu, \"max_ns\": %lu, \"mean_ns\": %lu, ",
+         S_bench_samples[0],
+         bench_percentile(num_reps, 50),
+         bench_percentile(num_reps, 90),
+         bench_percentile(num_reps, 99),
+         S_bench_samples[num_reps - 1],
+         total / num_reps);
+  printf("\"ns_per_unit\": %.3f, \"units_per_sec\": %.0f",
+         median / S_bench_units,
+         (median > 0) ? (S_bench_units * 1e9 / median) : 0.0);
+
+  /* counter columns are only written when the counter could be opened */
+  if (S_bench_counters_flag)
+  {
+    for (n = 0; n < PERFCTR_NUM_COUNTERS; n++)
+    {
+      if (!perfctr_available(n))
+        continue;
+
+      per_unit = (double) S_bench_counter_totals[n] / num_reps / S_bench_units;
+
+      printf(", \"%s_per_unit\": %.3f", perfctr_name(n), per_unit);
+    }
+
+    if (perfctr_available(PERFCTR_CYCLES) &&
+        perfctr_available(PERFCTR_INSTRUCTIONS) &&
+        (S_bench_counter_totals[PERFCTR_CYCLES] > 0))
+    {
+      printf(", \"ipc\": %.3f",
+             (double) S_bench_counter_totals[PERFCTR_INSTRUCTIONS] /
+                      S_bench_counter_totals[PERFCTR_CYCLES]);
+    }
+  }
+
+  printf("}");
+
+  return 0;
+}
+
+/******************************************************************************/
+/* main()                                                                     */
+/******************************************************************************/
+int main(int argc, char *argv[])
+{
+  int k;
+
+  unsigned long num_warmup;
+  unsigned long num_reps;
+  char*         filter;
+
+  unsigned char* art_buf;
+  unsigned char* rom_buf;
+
+  unsigned char first;
+  int           result;
+
+  /* parse command line */
+  num_warmup = BENCH_DEFAULT_WARMUP;
+  num_reps = BENCH_DEFAULT_REPS;
+  filter = NULL;
+
+  S_bench_counters_flag = 1;
+
+  for (k = 1; k < argc; k++)
+  {
+    if (!strcmp(argv[k], "--warmup") && (k + 1 < argc))
+      num_warmup = strtoul(argv[++k], NULL, 10);
+    else if (!strcmp(argv[k], "--reps") && (k + 1 < argc))
+      num_reps = strtoul(argv[++k], NULL, 10);
+    else if (!strcmp(argv[k], "--filter") && (k + 1 < argc))
+      filter = argv[++k];
+    else if (!strcmp(argv[k], "--no-counters"))
+      S_bench_counters_flag = 0;
+    else
+    {
+      fprintf(stderr, "Usage: %s [--warmup n] [--reps n] [--filter name] [--no-counters]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if ((num_reps == 0) || (num_reps > BENCH_MAX_REPS))
+  {
+    fprintf(stderr, "Reps must be 1 to %d\n", BENCH_MAX_REPS);
+    return 1;
+  }
+
+  /* bind the module buffers */
+  art_buf = malloc(art_buffers_size());
+  rom_buf = malloc(rom_buffers_size());
+
+  if ((art_buf == NULL) || (rom_buf == NULL))
+  {
+    fprintf(stderr, "Could not allocate buffers\n");
+    return 1;
+  }
+
+  memset(art_buf, 0, art_buffers_size());
+  memset(rom_buf, 0, rom_buffers_size());
+
+  art_bind_buffers(art_buf);
+  rom_bind_buffers(rom_buf);
+
+  rom_format();
+
+  /* hardware counters (the timings are still written without them) */
+  if (S_bench_counters_flag && (perfctr_open() == 0))
+  {
+    fprintf(stderr, "Hardware counters not available (perf_event_open failed)\n");
+    S_bench_counters_flag = 0;
+  }
+
+  /* run the kernels, and write the results as json */
+  result = 0;
+  first = 1;
+
+  printf("{\n  \"benchmarks\": [\n");
+
+  for (k = 0; k < (int) BENCH_NUM_KERNELS; k++)
+  {
+    if ((filter != NULL) && (strstr(S_bench_kernels[k].name, filter) == NULL))
+      continue;
+
+    if (bench_run_kernel(&S_bench_kernels[k], num_warmup, num_reps, first))
+      result = 1;
+    else
+      first = 0;
+  }
+
+  printf("\n  ]\n}\n");
+
+  if (S_bench_con_fp != NULL)
+    fclose(S_bench_con_fp);
+
+  perfctr_close();
+
+  free(art_buf);
+  free(rom_buf);
+
+  return result;
+}
@@ -0,0 +1,167 @@
+/******************************************************************************/
+/* gifenc.c (gif lzw encoder for the tools)                                   */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gifenc.h"
+
+#define GIFENC_MAX_CODES  4096 /* 12 bits */
+#define GIFENC_MAX_ROOTS  256
+
+/* the dictionary is a child table: (code, next pixel) -> code */
+/* (each row is num_roots wide, so only the used rows are cleared) */
+static unsigned short S_gifenc_children[GIFENC_MAX_CODES * GIFENC_MAX_ROOTS];
+
+static unsigned char* S_gifenc_out;
+static unsigned long  S_gifenc_out_size;
+static unsigned long  S_gifenc_bit_buf;
+static unsigned short S_gifenc_bit_count;
+
+/******************************************************************************/
+/* gifenc_write_code()                                                        */
+/******************************************************************************/
+int gifenc_write_code(unsigned short code, unsigned char code_bits)
+{
+  /* codes are packed starting at the least significant bit */
+  S_gifenc_bit_buf |= (unsigned long) code << S_gifenc_bit_count;
+  S_gifenc_bit_count += code_bits;
+
+  while (S_gifenc_bit_count >= 8)
+  {
+    S_gifenc_out[S_gifenc_out_size] = S_gifenc_bit_buf & 0xFF;
+    S_gifenc_out_size += 1;
+
+    S_gifenc_bit_buf >>= 8;
+    S_gifenc_bit_count -= 8;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* gifenc_lzw()                                                               */
+/******************************************************************************/
+int gifenc_lzw( unsigned char* pixels, unsigned long num_pixels, 
+                unsigned char root_bits, unsigned short clear_interval, 
+                unsigned char* out, unsigned long* out_size)
+{
+  unsigned long k;
+
+  unsigned short num_roots;
+  unsigned short clear_code;
+  unsigned short next_code;
+  unsigned short num_codes_since_clear;
+
+  unsigned short code;
+  unsigned short child;
+
+  /* the decoder lags the encoder by one dictionary entry, */
+  /* so the code width follows the decoder's table size    */
+  unsigned short dec_size;
+  unsigned char  dec_bits;
+  unsigned char  dec_first;
+
+  if ((pixels == NULL) || (num_pixels == 0) || (out == NULL) || (out_size == NULL))
+    return 1;
+
+  if ((root_bits < 2) || (root_bits > 8))
+    return 1;
+
+  num_roots = 1 << root_bits;
+  clear_code = num_roots;
+
+  S_gifenc_out = out;
+  S_gifenc_out_size = 0;
+  S_gifenc_bit_buf = 0;
+  S_gifenc_bit_count = 0;
+
+  /* start with a clear code */
+  memset(S_gifenc_children, 0, GIFENC_MAX_CODES * num_roots * sizeof(unsigned short));
+
+  next_code = num_roots + 2;
+  dec_size = num_roots + 2;
+  dec_bits = root_bits + 1;
+  dec_first = 1;
+  num_codes_since_clear = 0;
+
+  gifenc_write_code(clear_code, dec_bits);
+
+  if (pixels[0] >= num_roots)
+    return 1;
+
+  code = pixels[0];
+
+  for (k = 1; k < num_pixels; k++)
+  {
+    if (pixels[k] >= num_roots)
+      return 1;
+
+    child = S_gifenc_children[code * num_roots + pixels[k]];
+
+    /* extend the current string */
+    if (child != 0)
+    {
+      code = child;
+      continue;
+    }
+
+    /* emit the current string */
+    gifenc_write_code(code, dec_bits);
+
+    if (!dec_first)
+    {
+      dec_size += 1;
+
+      if ((dec_size == (1 << dec_bits)) && (dec_bits < 12))
+        dec_bits += 1;
+    }
+
+    dec_first = 0;
+    num_codes_since_clear += 1;
+
+    /* start over when the table is full, or on the requested interval */
+    if ((next_code >= GIFENC_MAX_CODES - 1) || 
+        ((clear_interval > 0) && (num_codes_since_clear >= clear_interval)))
+    {
+      gifenc_write_code(clear_code, dec_bits);
+
+      memset(S_gifenc_children, 0, next_code * num_roots * sizeof(unsigned short));
+
+      next_code = num_roots + 2;
+      dec_size = num_roots + 2;
+      dec_bits = root_bits + 1;
+      dec_first = 1;
+      num_codes_since_clear = 0;
+    }
+    else
+    {
+      S_gifenc_children[code * num_roots + pixels[k]] = next_code;
+      next_code += 1;
+    }
+
+    code = pixels[k];
+  }
+
+  /* emit the last string, and the end of stream code */
+  gifenc_write_code(code, dec_bits);
+
+  if (!dec_first)
+  {
+    dec_size += 1;
+
+    if ((dec_size == (1 << dec_bits)) && (dec_bits < 12))
+      dec_bits += 1;
+  }
+
+  gifenc_write_code(clear_code + 1, dec_bits);
+
+  if (S_gifenc_bit_count > 0)
+    gifenc_write_code(0, 8 - S_gifenc_bit_count);
+
+  *out_size = S_gifenc_out_size;
+
+  return 0;
+}
@@ -0,0 +1,16 @@
+/******************************************************************************/
+/* gifenc.h (gif lzw encoder for the tools)                                   */
+/******************************************************************************/
+
+#ifndef GIFENC_H
+#define GIFENC_H
+
+/* the largest code stream for an image of n pixels (every code at 12 bits) */
+#define GIFENC_MAX_LZW_BYTES(num_pixels) (2 * (num_pixels) + 64)
+
+/* function declarations */
+int gifenc_lzw( unsigned char* pixels, unsigned long num_pixels, 
+                unsigned char root_bits, unsigned short clear_interval, 
+                unsigned char* out, unsigned long* out_size);
+
+#endif
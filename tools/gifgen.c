@@ -0,0 +1,583 @@
+/******************************************************************************/
+/* gifgen.c (synthetic gif corpus generator)                                  */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "gifenc.h"
+
+/* the limits match the packer (16 x 16 cells, 8 frames, 16 colors) */
+#define GIFGEN_CELL_W_H        8
+#define GIFGEN_MAX_CELLS_W_H   16
+#define GIFGEN_MAX_W_H         (GIFGEN_CELL_W_H * GIFGEN_MAX_CELLS_W_H)
+#define GIFGEN_MAX_PIXELS      (GIFGEN_MAX_W_H * GIFGEN_MAX_W_H)
+
+#define GIFGEN_MAX_UNIQUE_FRAMES 8
+#define GIFGEN_MAX_FRAMES        (2 * (GIFGEN_MAX_UNIQUE_FRAMES - 1))
+
+/* the packer stores a palette per sprite, so a rom holds at most  */
+/* 256 sprites (VDP_ROM_MAX_PALS); bigger corpora are split into    */
+/* several rom folders, and each rom's files share its 65536 cells  */
+/* (VDP_ROM_MAX_CELLS), so every rom folder packs                   */
+#define GIFGEN_ROM_MAX_FILES     256
+#define GIFGEN_ROM_MAX_CELLS     (1UL << 16)
+
+#define GIFGEN_MAX_FILES         100000
+#define GIFGEN_DEFAULT_PER_SET   100
+#define GIFGEN_MAX_PER_SET       4096
+
+#define GIFGEN_PATH_MAX_SIZE     1024
+#define GIFGEN_ROM_PATH_MAX_SIZE (GIFGEN_PATH_MAX_SIZE - 128)
+
+/* the current file */
+static unsigned long  S_gifgen_seed;
+
+static unsigned short S_gifgen_w;
+static unsigned short S_gifgen_h;
+static unsigned short S_gifgen_num_frames;
+static unsigned char  S_gifgen_color_bits;
+static unsigned char  S_gifgen_interlaced;
+static unsigned char  S_gifgen_sub_rects;
+static unsigned short S_gifgen_clear_interval;
+
+/* the files in a set share its palette (the 1st 2, 4, 8 or 16 colors) */
+static unsigned char  S_gifgen_palette[16][3];
+
+static unsigned char  S_gifgen_frames[GIFGEN_MAX_FRAMES][GIFGEN_MAX_PIXELS];
+static unsigned char  S_gifgen_rect_pixels[GIFGEN_MAX_PIXELS];
+static unsigned char  S_gifgen_lzw[GIFENC_MAX_LZW_BYTES(GIFGEN_MAX_PIXELS)];
+
+static const unsigned short S_gifgen_clear_intervals[6] = { 0, 0, 0, 32, 128, 511 };
+
+/******************************************************************************/
+/* gifgen_random()                                                            */
+/******************************************************************************/
+unsigned long gifgen_random()
+{
+  S_gifgen_seed = (S_gifgen_seed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+
+  return S_gifgen_seed >> 16;
+}
+
+/******************************************************************************/
+/* gifgen_write_16le()                                                        */
+/******************************************************************************/
+int gifgen_write_16le(FILE* fp, unsigned short val)
+{
+  fputc(val & 0xFF, fp);
+  fputc((val >> 8) & 0xFF, fp);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* gifgen_draw_rects()                                                        */
+/******************************************************************************/
+int gifgen_draw_rects(unsigned char* pixels, unsigned short num_rects)
+{
+  unsigned short k;
+
+  unsigned short x;
+  unsigned short y;
+  unsigned short rect_x;
+  unsigned short rect_y;
+  unsigned short rect_w;
+  unsigned short rect_h;
+
+  unsigned char  color;
+
+  /* filled boxes, like blocky sprite art */
+  for (k = 0; k < num_rects; k++)
+  {
+    rect_w = 1 + gifgen_random() % (S_gifgen_w / 2);
+    rect_h = 1 + gifgen_random() % (S_gifgen_h / 2);
+    rect_x = gifgen_random() % (S_gifgen_w - rect_w + 1);
+    rect_y = gifgen_random() % (S_gifgen_h - rect_h + 1);
+
+    color = gifgen_random() % (1 << S_gifgen_color_bits);
+
+    for (y = rect_y; y < rect_y + rect_h; y++)
+    {
+      for (x = rect_x; x < rect_x + rect_w; x++)
+        pixels[y * S_gifgen_w + x] = color;
+    }
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* gifgen_make_palette()                                                      */
+/******************************************************************************/
+int gifgen_make_palette()
+{
+  unsigned short k;
+
+  for (k = 0; k < 16; k++)
+  {
+    S_gifgen_palette[k][0] = gifgen_random() & 0xF8;
+    S_gifgen_palette[k][1] = gifgen_random() & 0xF8;
+    S_gifgen_palette[k][2] = gifgen_random() & 0xF8;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* gifgen_make_frames()                                                       */
+/******************************************************************************/
+int gifgen_make_frames(unsigned long max_cells)
+{
+  unsigned short k;
+
+  unsigned short num_unique;
+  unsigned char  ping_pong;
+
+  unsigned long  num_pixels;
+
+  /* choose the image settings */
+  S_gifgen_w = GIFGEN_CELL_W_H * (1 + gifgen_random() % GIFGEN_MAX_CELLS_W_H);
+  S_gifgen_h = GIFGEN_CELL_W_H * (1 + gifgen_random() % GIFGEN_MAX_CELLS_W_H);
+
+  S_gifgen_color_bits = 1 + gifgen_random() % 4;
+  S_gifgen_interlaced = (gifgen_random() % 8) == 0;
+  S_gifgen_sub_rects = (gifgen_random() % 2) == 0;
+  S_gifgen_clear_interval = S_gifgen_clear_intervals[gifgen_random() % 6];
+
+  num_unique = 1 + gifgen_random() % GIFGEN_MAX_UNIQUE_FRAMES;
+  ping_pong = (num_unique >= 3) && ((gifgen_random() % 4) == 0);
+
+  /* the packer does not de-interlace, so the rows of the changed */
+  /* rects come out of order and a ping-pong would not fold back  */
+  if (S_gifgen_interlaced && S_gifgen_sub_rects)
+    ping_pong = 0;
+
+  /* keep the file within its share of the rom cells */
+  /* (fewer frames first, then a smaller image)      */
+  while ((num_unique > 1) && 
+         ((unsigned long) (S_gifgen_w / GIFGEN_CELL_W_H) * (S_gifgen_h / GIFGEN_CELL_W_H) * num_unique > max_cells))
+  {
+    num_unique -= 1;
+  }
+
+  while ((unsigned long) (S_gifgen_w / GIFGEN_CELL_W_H) * (S_gifgen_h / GIFGEN_CELL_W_H) > max_cells)
+  {
+    if (S_gifgen_w >= S_gifgen_h)
+      S_gifgen_w = GIFGEN_CELL_W_H * ((S_gifgen_w / GIFGEN_CELL_W_H + 1) / 2);
+    else
+      S_gifgen_h = GIFGEN_CELL_W_H * ((S_gifgen_h / GIFGEN_CELL_W_H + 1) / 2);
+  }
+
+  if (num_unique < 3)
+    ping_pong = 0;
+
+  num_pixels = (unsigned long) S_gifgen_w * S_gifgen_h;
+
+  /* the 1st frame, then each frame changes part of the last one */
+  memset(S_gifgen_frames[0], 0, num_pixels);
+  gifgen_draw_rects(S_gifgen_frames[0], 2 + gifgen_random() % 8);
+
+  for (k = 1; k < num_unique; k++)
+  {
+    memcpy(S_gifgen_frames[k], S_gifgen_frames[k - 1], num_pixels);
+    gifgen_draw_rects(S_gifgen_frames[k], 1 + gifgen_random() % 3);
+  }
+
+  S_gifgen_num_frames = num_unique;
+
+  /* a ping-pong sequence plays the frames forward, then back */
+  if (ping_pong)
+  {
+    for (k = num_unique - 2; k > 0; k--)
+    {
+      memcpy(S_gifgen_frames[S_gifgen_num_frames], S_gifgen_frames[k], num_pixels);
+      S_gifgen_num_frames += 1;
+    }
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* gifgen_find_changed_rect()                                                 */
+/******************************************************************************/
+int gifgen_find_changed_rect( unsigned short frame,
+                              unsigned short* left, unsigned short* top,
+                              unsigned short* w, unsigned short* h)
+{
+  unsigned short x;
+  unsigned short y;
+
+  unsigned short min_x;
+  unsigned short min_y;
+  unsigned short max_x;
+  unsigned short max_y;
+
+  unsigned char* cur;
+  unsigned char* last;
+
+  /* the whole image, for the 1st frame (or without sub-rectangles) */
+  *left = 0;
+  *top = 0;
+  *w = S_gifgen_w;
+  *h = S_gifgen_h;
+
+  if ((frame == 0) || (!S_gifgen_sub_rects))
+    return 0;
+
+  cur = S_gifgen_frames[frame];
+  last = S_gifgen_frames[frame - 1];
+
+  min_x = S_gifgen_w;
+  min_y = S_gifgen_h;
+  max_x = 0;
+  max_y = 0;
+
+  for (y = 0; y < S_gifgen_h; y++)
+  {
+    for (x = 0; x < S_gifgen_w; x++)
+    {
+      if (cur[y * S_gifgen_w + x] == last[y * S_gifgen_w + x])
+        continue;
+
+      if (x < min_x)
+        min_x = x;
+      if (x > max_x)
+        max_x = x;
+      if (y < min_y)
+        min_y = y;
+      if (y > max_y)
+        max_y = y;
+    }
+  }
+
+  /* an unchanged frame still needs 1 pixel */
+  if (min_x > max_x)
+  {
+    *w = 1;
+    *h = 1;
+    return 0;
+  }
+
+  *left = min_x;
+  *top = min_y;
+  *w = max_x - min_x + 1;
+  *h = max_y - min_y + 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* gifgen_copy_rect()                                                         */
+/******************************************************************************/
+int gifgen_copy_rect( unsigned short frame,
+                      unsigned short left, unsigned short top,
+                      unsigned short w, unsigned short h)
+{
+  unsigned short k;
+  unsigned short pass;
+  unsigned short row;
+
+  unsigned short pass_start[4] = { 0, 4, 2, 1 };
+  unsigned short pass_step[4] = { 8, 8, 4, 2 };
+
+  /* interlaced images store the rows in 4 passes */
+  k = 0;
+
+  if (S_gifgen_interlaced)
+  {
+    for (pass = 0; pass < 4; pass++)
+    {
+      for (row = pass_start[pass]; row < h; row += pass_step[pass])
+      {
+        memcpy(&S_gifgen_rect_pixels[k * w], &S_gifgen_frames[frame][(top + row) * S_gifgen_w + left], w);
+        k += 1;
+      }
+    }
+  }
+  else
+  {
+    for (row = 0; row < h; row++)
+      memcpy(&S_gifgen_rect_pixels[row * w], &S_gifgen_frames[frame][(top + row) * S_gifgen_w + left], w);
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* gifgen_write_file()                                                        */
+/******************************************************************************/
+int gifgen_write_file(char* filename)
+{
+  FILE* fp;
+
+  unsigned short k;
+  unsigned short m;
+
+  unsigned short left;
+  unsigned short top;
+  unsigned short w;
+  unsigned short h;
+
+  unsigned char  root_bits;
+  unsigned long  lzw_size;
+  unsigned long  offset;
+  unsigned long  block_size;
+
+  fp = fopen(filename, "wb");
+
+  if (fp == NULL)
+    return 1;
+
+  /* header and logical screen descriptor (with a global color table) */
+  fwrite("GIF89a", 1, 6, fp);
+
+  gifgen_write_16le(fp, S_gifgen_w);
+  gifgen_write_16le(fp, S_gifgen_h);
+
+  fputc(0x80 | ((S_gifgen_color_bits - 1) << 4) | (S_gifgen_color_bits - 1), fp);
+  fputc(0x00, fp);
+  fputc(0x00, fp);
+
+  for (k = 0; k < (1 << S_gifgen_color_bits); k++)
+  {
+    fputc(S_gifgen_palette[k][0], fp);
+    fputc(S_gifgen_palette[k][1], fp);
+    fputc(S_gifgen_palette[k][2], fp);
+  }
+
+  /* looping app extension */
+  fwrite("\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00", 1, 19, fp);
+
+  root_bits = (S_gifgen_color_bits < 2) ? 2 : S_gifgen_color_bits;
+
+  for (k = 0; k < S_gifgen_num_frames; k++)
+  {
+    /* graphic control extension (delay of 10/100ths) */
+    fwrite("\x21\xF9\x04\x04", 1, 4, fp);
+    gifgen_write_16le(fp, 10);
+    fputc(0x00, fp);
+    fputc(0x00, fp);
+
+    /* image descriptor */
+    gifgen_find_changed_rect(k, &left, &top, &w, &h);
+    gifgen_copy_rect(k, left, top, w, h);
+
+    fputc(0x2C, fp);
+
+    gifgen_write_16le(fp, left);
+    gifgen_write_16le(fp, top);
+    gifgen_write_16le(fp, w);
+    gifgen_write_16le(fp, h);
+
+    fputc(S_gifgen_interlaced ? 0x40 : 0x00, fp);
+
+    /* image data, in sub-blocks */
+    if (gifenc_lzw(S_gifgen_rect_pixels, (unsigned long) w * h, root_bits,
+                   S_gifgen_clear_interval, S_gifgen_lzw, &lzw_size))
+    {
+      goto nope;
+    }
+
+    fputc(root_bits, fp);
+
+    for (offset = 0; offset < lzw_size; offset += block_size)
+    {
+      block_size = lzw_size - offset;
+
+      if (block_size > 255)
+        block_size = 255;
+
+      fputc(block_size, fp);
+
+      for (m = 0; m < block_size; m++)
+        fputc(S_gifgen_lzw[offset + m], fp);
+    }
+
+    fputc(0x00, fp);
+  }
+
+  /* trailer */
+  fputc(0x3B, fp);
+
+  if (ferror(fp))
+    goto nope;
+
+  fclose(fp);
+
+  return 0;
+
+nope:
+  fclose(fp);
+  return 1;
+}
+
+/******************************************************************************/
+/* gifgen_make_folder()                                                       */
+/******************************************************************************/
+int gifgen_make_folder(char* path)
+{
+  if (mkdir(path, 0755) && (errno != EEXIST))
+    return 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* main()                                                                     */
+/******************************************************************************/
+int main(int argc, char *argv[])
+{
+  int k;
+
+  char* root_name;
+  unsigned long num_files;
+  unsigned long per_set;
+  unsigned long seed;
+
+  unsigned long n;
+  unsigned long num_bytes;
+
+  unsigned long num_roms;
+  unsigned long rom;
+  unsigned long rom_start;
+  unsigned long rom_num_files;
+  unsigned long set;
+
+  char rom_path[GIFGEN_ROM_PATH_MAX_SIZE];
+  char path[GIFGEN_PATH_MAX_SIZE];
+  struct stat st;
+
+  /* parse command line */
+  root_name = NULL;
+  num_files = 0;
+  per_set = GIFGEN_DEFAULT_PER_SET;
+  seed = 1;
+
+  for (k = 1; k < argc; k++)
+  {
+    if (!strcmp(argv[k], "--seed") && (k + 1 < argc))
+      seed = strtoul(argv[++k], NULL, 10);
+    else if (!strcmp(argv[k], "--per-set") && (k + 1 < argc))
+      per_set = strtoul(argv[++k], NULL, 10);
+    else if (argv[k][0] == '-')
+      break;
+    else if (root_name == NULL)
+      root_name = argv[k];
+    else if (num_files == 0)
+      num_files = strtoul(argv[k], NULL, 10);
+    else
+      break;
+  }
+
+  if ((k < argc) || (root_name == NULL) || (num_files == 0) || (per_set == 0))
+  {
+    printf("Usage: %s <root> <num files> [--seed n] [--per-set n]\n", argv[0]);
+    printf("  up to %d files: <root>/Sprites/set_nnnn/\n", GIFGEN_ROM_MAX_FILES);
+    printf("  more files:      <root>/rom_nnnn/Sprites/set_nnnn/ (%d per rom)\n", GIFGEN_ROM_MAX_FILES);
+    return 1;
+  }
+
+  if (num_files > GIFGEN_MAX_FILES)
+  {
+    printf("Too many files (max %d)\n", GIFGEN_MAX_FILES);
+    return 1;
+  }
+
+  if (per_set > GIFGEN_MAX_PER_SET)
+  {
+    printf("Too many files per set (max %d)\n", GIFGEN_MAX_PER_SET);
+    return 1;
+  }
+
+  if (strlen(root_name) + 64 > GIFGEN_ROM_PATH_MAX_SIZE)
+  {
+    printf("Root name too long: %s\n", root_name);
+    return 1;
+  }
+
+  /* make the root folder (which is the rom folder, if there is just one) */
+  sprintf(path, "%s", root_name);
+
+  if (gifgen_make_folder(path))
+    goto nope;
+
+  num_roms = (num_files + GIFGEN_ROM_MAX_FILES - 1) / GIFGEN_ROM_MAX_FILES;
+  num_bytes = 0;
+
+  for (rom = 0; rom < num_roms; rom++)
+  {
+    rom_start = rom * GIFGEN_ROM_MAX_FILES;
+    rom_num_files = num_files - rom_start;
+
+    if (rom_num_files > GIFGEN_ROM_MAX_FILES)
+      rom_num_files = GIFGEN_ROM_MAX_FILES;
+
+    /* make the folder tree: rom/Sprites/set_nnnn/ */
+    if (num_roms == 1)
+      sprintf(rom_path, "%s", root_name);
+    else
+    {
+      sprintf(rom_path, "%s/rom_%04lu", root_name, rom);
+
+      if (gifgen_make_folder(rom_path))
+      {
+        strcpy(path, rom_path);
+        goto nope;
+      }
+    }
+
+    sprintf(path, "%s/Sprites", rom_path);
+
+    if (gifgen_make_folder(path))
+      goto nope;
+
+    for (n = 0; n < rom_num_files; n++)
+    {
+      set = n / per_set;
+
+      if ((n % per_set) == 0)
+      {
+        sprintf(path, "%s/Sprites/set_%04lu", rom_path, set);
+
+        if (gifgen_make_folder(path))
+          goto nope;
+
+        /* each set has its own seed for its palette */
+        S_gifgen_seed = (seed * 1000003UL + rom_start + n) ^ 0x5A5A5AUL;
+
+        gifgen_random();
+        gifgen_make_palette();
+      }
+
+      /* each file has its own seed, so any one file can be remade */
+      S_gifgen_seed = seed * 1000003UL + rom_start + n;
+
+      gifgen_random();
+      gifgen_make_frames(GIFGEN_ROM_MAX_CELLS / rom_num_files);
+
+      sprintf(path, "%s/Sprites/set_%04lu/spr_%06lu.gif", rom_path, set, rom_start + n);
+
+      if (gifgen_write_file(path))
+        goto nope;
+
+      if (!stat(path, &st))
+        num_bytes += st.st_size;
+    }
+  }
+
+  printf("Generated %lu files (%lu bytes, %lu roms) in %s\n", num_files, num_bytes, num_roms, root_name);
+
+  return 0;
+
+nope:
+  printf("Could not write: %s\n", path);
+  return 1;
+}
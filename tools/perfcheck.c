@@ -0,0 +1,814 @@
+/******************************************************************************/
+/* perfcheck.c (performance regression gate)                                  */
+/******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define PERF_MAX_METRICS          64
+#define PERF_NAME_SIZE            64
+#define PERF_UNIT_SIZE            16
+#define PERF_PATH_MAX_SIZE        1024
+#define PERF_LINE_SIZE            1024
+
+/* one rom holds at most 256 sprites (a palette each), */
+/* and the corpus must pack completely to be measured  */
+#define PERF_MAX_FILES            256
+
+#define PERF_DEFAULT_FILES        256
+#define PERF_DEFAULT_SEED         1
+#define PERF_DEFAULT_PACK_REPS    3
+#define PERF_DEFAULT_BENCH_REPS   5
+#define PERF_MAX_BENCH_REPS       31
+#define PERF_DEFAULT_TOLERANCE    15.0 /* percent, throughput */
+#define PERF_DEFAULT_SIZE_TOLERANCE 2.0 /* percent, peak rss and rom size */
+
+/* speed metrics are higher-is-better, size metrics are lower-is-better */
+enum
+{
+  PERF_KIND_SPEED = 0,
+  PERF_KIND_SIZE
+};
+
+struct perf_metric
+{
+  char          name[PERF_NAME_SIZE];
+  char          unit[PERF_UNIT_SIZE];
+  double        value;
+  unsigned char kind;
+};
+
+static struct perf_metric S_perf_current[PERF_MAX_METRICS];
+static int                S_perf_num_current;
+
+static struct perf_metric S_perf_baseline[PERF_MAX_METRICS];
+static int                S_perf_num_baseline;
+
+static unsigned long      S_perf_baseline_files;
+static unsigned long      S_perf_baseline_seed;
+
+/* the benchmark results of each run (the median is gated) */
+static double             S_perf_samples[PERF_MAX_METRICS][PERF_MAX_BENCH_REPS];
+static unsigned long      S_perf_num_samples[PERF_MAX_METRICS];
+
+/******************************************************************************/
+/* perf_now()                                                                 */
+/******************************************************************************/
+unsigned long perf_now()
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+/******************************************************************************/
+/* perf_add_metric()                                                          */
+/******************************************************************************/
+int perf_add_metric(struct perf_metric* list, int* num_metrics,
+                    const char* name, const char* unit,
+                    double value, unsigned char kind)
+{
+  struct perf_metric* m;
+
+  if (*num_metrics >= PERF_MAX_METRICS)
+    return 1;
+
+  m = &list[*num_metrics];
+
+  strncpy(m->name, name, PERF_NAME_SIZE - 1);
+  m->name[PERF_NAME_SIZE - 1] = '\0';
+
+  strncpy(m->unit, unit, PERF_UNIT_SIZE - 1);
+  m->unit[PERF_UNIT_SIZE - 1] = '\0';
+
+  m->value = value;
+  m->kind = kind;
+
+  *num_metrics += 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perf_find_metric()                                                         */
+/******************************************************************************/
+struct perf_metric* perf_find_metric(struct perf_metric* list, int num_metrics,
+                                     const char* name)
+{
+  int k;
+
+  for (k = 0; k < num_metrics; k++)
+  {
+    if (!strcmp(list[k].name, name))
+      return &list[k];
+  }
+
+  return NULL;
+}
+
+/******************************************************************************/
+/* perf_get_string()                                                          */
+/******************************************************************************/
+int perf_get_string(char* line, const char* key, char* dest, int size)
+{
+  char* p;
+  int   n;
+
+  /* the json files are our own, so each field is "key": "value" */
+  p = strstr(line, key);
+
+  if (p == NULL)
+    return 1;
+
+  p = strchr(p + strlen(key), '"');
+
+  if (p == NULL)
+    return 1;
+
+  p += 1;
+
+  for (n = 0; (n < size - 1) && (p[n] != '"') && (p[n] != '\0'); n++)
+    dest[n] = p[n];
+
+  dest[n] = '\0';
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perf_get_number()                                                          */
+/******************************************************************************/
+int perf_get_number(char* line, const char* key, double* value)
+{
+  char* p;
+
+  p = strstr(line, key);
+
+  if (p == NULL)
+    return 1;
+
+  p = strchr(p + strlen(key), ':');
+
+  if (p == NULL)
+    return 1;
+
+  *value = strtod(p + 1, NULL);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perf_compare_doubles()                                                     */
+/******************************************************************************/
+int perf_compare_doubles(const void* a, const void* b)
+{
+  double x;
+  double y;
+
+  x = *((const double*) a);
+  y = *((const double*) b);
+
+  return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+/******************************************************************************/
+/* perf_run()                                                                 */
+/******************************************************************************/
+int perf_run(char** args, char* dir)
+{
+  pid_t pid;
+  int   status;
+  int   fd;
+
+  pid = fork();
+
+  if (pid < 0)
+    return 1;
+
+  /* the tools print a line per file, which would bury the table */
+  if (pid == 0)
+  {
+    if (chdir(dir))
+      _exit(127);
+
+    fd = open("/dev/null", O_WRONLY);
+
+    if (fd >= 0)
+    {
+      dup2(fd, STDOUT_FILENO);
+      close(fd);
+    }
+
+    execv(args[0], args);
+    _exit(127);
+  }
+
+  if (waitpid(pid, &status, 0) != pid)
+    return 1;
+
+  if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    return 1;
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perf_count_packed()                                                        */
+/******************************************************************************/
+int perf_count_packed(char* report_path, unsigned long* num_entries)
+{
+  FILE* fp;
+
+  char   line[PERF_LINE_SIZE];
+  double value;
+
+  fp = fopen(report_path, "r");
+
+  if (fp == NULL)
+    return 1;
+
+  /* the sprite totals line: "entries": n, "max_entries": ... */
+  while (fgets(line, PERF_LINE_SIZE, fp) != NULL)
+  {
+    if (strstr(line, "\"max_entries\"") == NULL)
+      continue;
+
+    if (perf_get_number(line, "\"entries\"", &value))
+      continue;
+
+    *num_entries = (unsigned long) value;
+
+    fclose(fp);
+    return 0;
+  }
+
+  fclose(fp);
+
+  return 1;
+}
+
+/******************************************************************************/
+/* perf_measure_pack()                                                        */
+/******************************************************************************/
+int perf_measure_pack(char* bin_dir, char* work_dir,
+                      unsigned long num_files, unsigned long seed,
+                      unsigned long num_reps)
+{
+  char gen_path[PERF_PATH_MAX_SIZE];
+  char pack_path[PERF_PATH_MAX_SIZE];
+  char root_name[64];
+  char rom_path[PERF_PATH_MAX_SIZE];
+  char report_path[PERF_PATH_MAX_SIZE];
+  char files_arg[32];
+  char seed_arg[32];
+
+  char* args[8];
+
+  unsigned long k;
+  unsigned long t1;
+  unsigned long t2;
+  unsigned long best;
+  unsigned long num_entries;
+
+  struct rusage usage;
+  struct stat   st;
+
+  sprintf(gen_path, "%s/kunogen", bin_dir);
+  sprintf(pack_path, "%s/kunopack", bin_dir);
+  sprintf(root_name, "corpus_%lu_%lu", num_files, seed);
+  sprintf(rom_path, "%s/corpus.kn1", work_dir);
+  sprintf(report_path, "%s/corpus.json", work_dir);
+  sprintf(files_arg, "%lu", num_files);
+  sprintf(seed_arg, "%lu", seed);
+
+  if (mkdir(work_dir, 0755) && (errno != EEXIST))
+  {
+    printf("Could not make work folder: %s\n", work_dir);
+    return 1;
+  }
+
+  /* generate the corpus (the same seed always gives the same files) */
+  args[0] = gen_path;
+  args[1] = root_name;
+  args[2] = files_arg;
+  args[3] = "--seed";
+  args[4] = seed_arg;
+  args[5] = NULL;
+
+  if (perf_run(args, work_dir))
+  {
+    printf("Corpus generation failed: %s\n", gen_path);
+    return 1;
+  }
+
+  /* pack it, keeping the fastest run (the packer exits */
+  /* with an error if any file does not go in the rom)  */
+  args[0] = pack_path;
+  args[1] = root_name;
+  args[2] = "corpus.kn1";
+  args[3] = "--report";
+  args[4] = "corpus.json";
+  args[5] = NULL;
+
+  best = 0;
+
+  for (k = 0; k < num_reps; k++)
+  {
+    t1 = perf_now();
+
+    if (perf_run(args, work_dir))
+    {
+      printf("Pack failed: %s\n", pack_path);
+      return 1;
+    }
+
+    t2 = perf_now();
+
+    if ((k == 0) || (t2 - t1 < best))
+      best = t2 - t1;
+  }
+
+  /* the packer is the largest child so far, so it sets the peak */
+  getrusage(RUSAGE_CHILDREN, &usage);
+
+  if (stat(rom_path, &st))
+  {
+    printf("Rom not written: %s\n", rom_path);
+    return 1;
+  }
+
+  /* a rom that is missing files would look faster and smaller */
+  if (perf_count_packed(report_path, &num_entries))
+  {
+    printf("Report not written: %s\n", report_path);
+    return 1;
+  }
+
+  if (num_entries != num_files)
+  {
+    printf("Packed %lu of %lu files\n", num_entries, num_files);
+    return 1;
+  }
+
+  perf_add_metric(S_perf_current, &S_perf_num_current,
+                  "pack.throughput", "files/s",
+                  (best > 0) ? (num_files * 1e9 / best) : 0.0, PERF_KIND_SPEED);
+  perf_add_metric(S_perf_current, &S_perf_num_current,
+                  "pack.peak_rss", "KB",
+                  (double) usage.ru_maxrss, PERF_KIND_SIZE);
+  perf_add_metric(S_perf_current, &S_perf_num_current,
+                  "pack.rom_size", "bytes",
+                  (double) st.st_size, PERF_KIND_SIZE);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perf_run_bench()                                                           */
+/******************************************************************************/
+int perf_run_bench(char* command)
+{
+  FILE* fp;
+
+  char line[PERF_LINE_SIZE];
+  char kernel[PERF_NAME_SIZE - 8];
+  char name[PERF_NAME_SIZE];
+  char units[PERF_UNIT_SIZE - 4];
+  char unit[PERF_UNIT_SIZE];
+
+  double value;
+
+  struct perf_metric* m;
+  int                 index;
+
+  fp = popen(command, "r");
+
+  if (fp == NULL)
+  {
+    printf("Could not run benchmark: %s\n", command);
+    return 1;
+  }
+
+  /* one kernel per line */
+  while (fgets(line, PERF_LINE_SIZE, fp) != NULL)
+  {
+    if (perf_get_string(line, "\"name\"", kernel, sizeof(kernel)))
+      continue;
+
+    if (perf_get_string(line, "\"units\"", units, sizeof(units)))
+      continue;
+
+    if (perf_get_number(line, "\"units_per_sec\"", &value))
+      continue;
+
+    sprintf(name, "bench.%s", kernel);
+    sprintf(unit, "%s/s", units);
+
+    m = perf_find_metric(S_perf_current, S_perf_num_current, name);
+
+    if (m == NULL)
+    {
+      if (perf_add_metric(S_perf_current, &S_perf_num_current,
+                          name, unit, 0.0, PERF_KIND_SPEED))
+      {
+        continue;
+      }
+
+      m = &S_perf_current[S_perf_num_current - 1];
+    }
+
+    index = m - S_perf_current;
+
+    if (S_perf_num_samples[index] < PERF_MAX_BENCH_REPS)
+    {
+      S_perf_samples[index][S_perf_num_samples[index]] = value;
+      S_perf_num_samples[index] += 1;
+    }
+  }
+
+  if (pclose(fp) != 0)
+  {
+    printf("Benchmark failed: %s\n", command);
+    return 1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perf_measure_bench()                                                       */
+/******************************************************************************/
+int perf_measure_bench(char* bin_dir, unsigned long num_reps)
+{
+  char command[PERF_PATH_MAX_SIZE];
+
+  unsigned long k;
+  int           m;
+  unsigned long n;
+
+  /* the counters are not gated, so do not ask for them */
+  sprintf(command, "%s/kunobench --no-counters", bin_dir);
+
+  /* a single run is at the mercy of whatever else */
+  /* the machine is doing, so gate on the median   */
+  for (k = 0; k < num_reps; k++)
+  {
+    if (perf_run_bench(command))
+      return 1;
+  }
+
+  for (m = 0; m < S_perf_num_current; m++)
+  {
+    n = S_perf_num_samples[m];
+
+    if (n == 0)
+      continue;
+
+    qsort(S_perf_samples[m], n, sizeof(double), perf_compare_doubles);
+
+    if (n % 2)
+      S_perf_current[m].value = S_perf_samples[m][n / 2];
+    else
+      S_perf_current[m].value = (S_perf_samples[m][n / 2 - 1] + S_perf_samples[m][n / 2]) / 2.0;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perf_load_baseline()                                                       */
+/******************************************************************************/
+int perf_load_baseline(char* filename)
+{
+  FILE* fp;
+
+  char line[PERF_LINE_SIZE];
+  char name[PERF_NAME_SIZE];
+  char unit[PERF_UNIT_SIZE];
+  char kind[16];
+
+  double value;
+
+  fp = fopen(filename, "r");
+
+  if (fp == NULL)
+    return 1;
+
+  S_perf_num_baseline = 0;
+  S_perf_baseline_files = PERF_DEFAULT_FILES;
+  S_perf_baseline_seed = PERF_DEFAULT_SEED;
+
+  while (fgets(line, PERF_LINE_SIZE, fp) != NULL)
+  {
+    if (strstr(line, "\"corpus\"") != NULL)
+    {
+      if (!perf_get_number(line, "\"files\"", &value))
+        S_perf_baseline_files = (unsigned long) value;
+
+      if (!perf_get_number(line, "\"seed\"", &value))
+        S_perf_baseline_seed = (unsigned long) value;
+
+      continue;
+    }
+
+    if (perf_get_string(line, "\"name\"", name, sizeof(name)))
+      continue;
+
+    if (perf_get_string(line, "\"unit\"", unit, sizeof(unit)))
+      continue;
+
+    if (perf_get_string(line, "\"kind\"", kind, sizeof(kind)))
+      continue;
+
+    if (perf_get_number(line, "\"value\"", &value))
+      continue;
+
+    perf_add_metric(S_perf_baseline, &S_perf_num_baseline, name, unit, value,
+                    strcmp(kind, "size") ? PERF_KIND_SPEED : PERF_KIND_SIZE);
+  }
+
+  fclose(fp);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perf_save_baseline()                                                       */
+/******************************************************************************/
+int perf_save_baseline(char* filename, unsigned long num_files, unsigned long seed)
+{
+  FILE* fp;
+  int   k;
+
+  fp = fopen(filename, "w");
+
+  if (fp == NULL)
+    return 1;
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"corpus\": {\"files\": %lu, \"seed\": %lu},\n", num_files, seed);
+  fprintf(fp, "  \"metrics\": [\n");
+
+  for (k = 0; k < S_perf_num_current; k++)
+  {
+    fprintf(fp, "    {\"name\": \"%s\", \"unit\": \"%s\", \"kind\": \"%s\", \"value\": %.0f}%s\n",
+            S_perf_current[k].name,
+            S_perf_current[k].unit,
+            (S_perf_current[k].kind == PERF_KIND_SIZE) ? "size" : "speed",
+            S_perf_current[k].value,
+            (k + 1 < S_perf_num_current) ? "," : "");
+  }
+
+  fprintf(fp, "  ]\n}\n");
+
+  fclose(fp);
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perf_compare()                                                             */
+/******************************************************************************/
+int perf_compare(double tolerance, double size_tolerance)
+{
+  int k;
+
+  struct perf_metric* base;
+  struct perf_metric* cur;
+
+  double tol;
+  double change;
+  char*  status;
+
+  int num_regressed;
+
+  num_regressed = 0;
+
+  printf("%-28s %-10s %14s %14s %9s  %s\n",
+         "Metric", "Unit", "Baseline", "Current", "Change", "Status");
+
+  /* every baseline metric must still be measured */
+  for (k = 0; k < S_perf_num_baseline; k++)
+  {
+    base = &S_perf_baseline[k];
+    cur = perf_find_metric(S_perf_current, S_perf_num_current, base->name);
+
+    if (cur == NULL)
+    {
+      printf("%-28s %-10s %14.0f %14s %9s  %s\n",
+             base->name, base->unit, base->value, "-", "-", "MISSING");
+
+      num_regressed += 1;
+      continue;
+    }
+
+    change = (base->value > 0) ? (100.0 * (cur->value - base->value) / base->value) : 0.0;
+
+    /* a regression is slower, or bigger */
+    if (base->kind == PERF_KIND_SIZE)
+    {
+      tol = size_tolerance;
+      status = (change > tol) ? "REGRESSED" : (change < -tol) ? "improved" : "ok";
+    }
+    else
+    {
+      tol = tolerance;
+      status = (change < -tol) ? "REGRESSED" : (change > tol) ? "improved" : "ok";
+    }
+
+    if (!strcmp(status, "REGRESSED"))
+      num_regressed += 1;
+
+    printf("%-28s %-10s %14.0f %14.0f %+8.1f%%  %s\n",
+           base->name, base->unit, base->value, cur->value, change, status);
+  }
+
+  /* new metrics are shown, but have nothing to regress against */
+  for (k = 0; k < S_perf_num_current; k++)
+  {
+    cur = &S_perf_current[k];
+
+    if (perf_find_metric(S_perf_baseline, S_perf_num_baseline, cur->name) != NULL)
+      continue;
+
+    printf("%-28s %-10s %14s %14.0f %9s  %s\n",
+           cur->name, cur->unit, "-", cur->value, "-", "new");
+  }
+
+  printf("Tolerance: %.1f%% (speed), %.1f%% (size)\n", tolerance, size_tolerance);
+
+  if (num_regressed > 0)
+  {
+    printf("%d metric(s) regressed\n", num_regressed);
+    return 1;
+  }
+
+  printf("No regressions\n");
+
+  return 0;
+}
+
+/******************************************************************************/
+/* main()                                                                     */
+/******************************************************************************/
+int main(int argc, char *argv[])
+{
+  int k;
+
+  char* bin_dir;
+  char* work_dir;
+  char* baseline_name;
+
+  char bin_path[PERF_PATH_MAX_SIZE];
+
+  unsigned long num_files;
+  unsigned long seed;
+  unsigned long num_pack_reps;
+  unsigned long num_bench_reps;
+
+  double tolerance;
+  double size_tolerance;
+
+  unsigned char update_flag;
+  unsigned char corpus_flag;
+
+  /* parse command line */
+  bin_dir = "bin";
+  work_dir = "perfcheck";
+  baseline_name = "tools/perf_baseline.json";
+
+  num_files = PERF_DEFAULT_FILES;
+  seed = PERF_DEFAULT_SEED;
+  num_pack_reps = PERF_DEFAULT_PACK_REPS;
+  num_bench_reps = PERF_DEFAULT_BENCH_REPS;
+
+  tolerance = PERF_DEFAULT_TOLERANCE;
+  size_tolerance = PERF_DEFAULT_SIZE_TOLERANCE;
+
+  update_flag = 0;
+  corpus_flag = 0;
+
+  for (k = 1; k < argc; k++)
+  {
+    if (!strcmp(argv[k], "--bin") && (k + 1 < argc))
+      bin_dir = argv[++k];
+    else if (!strcmp(argv[k], "--work") && (k + 1 < argc))
+      work_dir = argv[++k];
+    else if (!strcmp(argv[k], "--baseline") && (k + 1 < argc))
+      baseline_name = argv[++k];
+    else if (!strcmp(argv[k], "--files") && (k + 1 < argc))
+    {
+      num_files = strtoul(argv[++k], NULL, 10);
+      corpus_flag = 1;
+    }
+    else if (!strcmp(argv[k], "--seed") && (k + 1 < argc))
+    {
+      seed = strtoul(argv[++k], NULL, 10);
+      corpus_flag = 1;
+    }
+    else if (!strcmp(argv[k], "--pack-reps") && (k + 1 < argc))
+      num_pack_reps = strtoul(argv[++k], NULL, 10);
+    else if (!strcmp(argv[k], "--bench-reps") && (k + 1 < argc))
+      num_bench_reps = strtoul(argv[++k], NULL, 10);
+    else if (!strcmp(argv[k], "--tolerance") && (k + 1 < argc))
+      tolerance = strtod(argv[++k], NULL);
+    else if (!strcmp(argv[k], "--size-tolerance") && (k + 1 < argc))
+      size_tolerance = strtod(argv[++k], NULL);
+    else if (!strcmp(argv[k], "--update"))
+      update_flag = 1;
+    else
+      break;
+  }
+
+  if ((k < argc) || (num_files == 0) || (num_pack_reps == 0) ||
+      (num_bench_reps == 0) || (num_bench_reps > PERF_MAX_BENCH_REPS))
+  {
+    printf("Usage: %s [--baseline file] [--update] [--tolerance pct] [--size-tolerance pct]\n", argv[0]);
+    printf("       [--bin dir] [--work dir] [--files n] [--seed n] [--pack-reps n] [--bench-reps n]\n");
+    return 1;
+  }
+
+  if ((strlen(work_dir) + 64 > PERF_PATH_MAX_SIZE) ||
+      (strlen(bin_dir) + 64 > PERF_PATH_MAX_SIZE))
+  {
+    printf("Path too long\n");
+    return 1;
+  }
+
+  /* the packer takes its root as a folder in the current folder, so the */
+  /* tools are run from the work folder, and need the full bin path      */
+  if (bin_dir[0] != '/')
+  {
+    if (getcwd(bin_path, PERF_PATH_MAX_SIZE - strlen(bin_dir) - 2) == NULL)
+    {
+      printf("Could not get the current folder\n");
+      return 1;
+    }
+
+    strcat(bin_path, "/");
+    strcat(bin_path, bin_dir);
+
+    bin_dir = bin_path;
+  }
+
+  /* compare against the corpus the baseline was measured on */
+  if (!update_flag)
+  {
+    if (perf_load_baseline(baseline_name))
+    {
+      printf("Could not read baseline: %s\n", baseline_name);
+      return 1;
+    }
+
+    if (!corpus_flag)
+    {
+      num_files = S_perf_baseline_files;
+      seed = S_perf_baseline_seed;
+    }
+  }
+
+  if (num_files > PERF_MAX_FILES)
+  {
+    printf("Too many files for one rom (max %d)\n", PERF_MAX_FILES);
+    return 1;
+  }
+
+  /* the pack runs first, so the peak rss is not the benchmark's */
+  printf("Packing %lu generated files (seed %lu)...\n", num_files, seed);
+
+  if (perf_measure_pack(bin_dir, work_dir, num_files, seed, num_pack_reps))
+    return 1;
+
+  printf("Running benchmarks (median of %lu runs)...\n", num_bench_reps);
+
+  if (perf_measure_bench(bin_dir, num_bench_reps))
+    return 1;
+
+  if (update_flag)
+  {
+    if (perf_save_baseline(baseline_name, num_files, seed))
+    {
+      printf("Could not write baseline: %s\n", baseline_name);
+      return 1;
+    }
+
+    printf("Baseline written: %s (%d metrics)\n", baseline_name, S_perf_num_current);
+
+    return 0;
+  }
+
+  return perf_compare(tolerance, size_tolerance);
+}
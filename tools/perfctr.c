@@ -0,0 +1,173 @@
+/******************************************************************************/
+/* perfctr.c (hardware performance counters for the tools)                    */
+/******************************************************************************/
+
+/* perf_event_open() has no libc wrapper, so it is called with syscall() */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+
+#include "perfctr.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static int S_perfctr_fds[PERFCTR_NUM_COUNTERS] = { -1, -1, -1, -1 };
+
+static const char* S_perfctr_names[PERFCTR_NUM_COUNTERS] =
+  { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+#ifdef __linux__
+static const unsigned long S_perfctr_configs[PERFCTR_NUM_COUNTERS] =
+  { PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES };
+#endif
+
+/******************************************************************************/
+/* perfctr_open()                                                             */
+/******************************************************************************/
+int perfctr_open()
+{
+#ifdef __linux__
+  int k;
+  int num_open;
+
+  struct perf_event_attr attr;
+
+  /* each counter is opened on its own, so a machine missing one  */
+  /* (or a virtual machine with no pmu at all) just loses columns */
+  num_open = 0;
+
+  for (k = 0; k < PERFCTR_NUM_COUNTERS; k++)
+  {
+    memset(&attr, 0, sizeof(attr));
+
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = S_perfctr_configs[k];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    S_perfctr_fds[k] = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+    if (S_perfctr_fds[k] >= 0)
+      num_open += 1;
+  }
+
+  return num_open;
+#else
+  return 0;
+#endif
+}
+
+/******************************************************************************/
+/* perfctr_close()                                                            */
+/******************************************************************************/
+int perfctr_close()
+{
+  int k;
+
+  for (k = 0; k < PERFCTR_NUM_COUNTERS; k++)
+  {
+#ifdef __linux__
+    if (S_perfctr_fds[k] >= 0)
+      close(S_perfctr_fds[k]);
+#endif
+
+    S_perfctr_fds[k] = -1;
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perfctr_start()                                                            */
+/******************************************************************************/
+int perfctr_start()
+{
+#ifdef __linux__
+  int k;
+
+  for (k = 0; k < PERFCTR_NUM_COUNTERS; k++)
+  {
+    if (S_perfctr_fds[k] < 0)
+      continue;
+
+    ioctl(S_perfctr_fds[k], PERF_EVENT_IOC_RESET, 0);
+    ioctl(S_perfctr_fds[k], PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perfctr_stop()                                                             */
+/******************************************************************************/
+int perfctr_stop(unsigned long* values)
+{
+  int k;
+
+#ifdef __linux__
+  unsigned long data[3];
+
+  for (k = 0; k < PERFCTR_NUM_COUNTERS; k++)
+  {
+    if (S_perfctr_fds[k] >= 0)
+      ioctl(S_perfctr_fds[k], PERF_EVENT_IOC_DISABLE, 0);
+  }
+#endif
+
+  for (k = 0; k < PERFCTR_NUM_COUNTERS; k++)
+  {
+    values[k] = 0;
+
+#ifdef __linux__
+    if (S_perfctr_fds[k] < 0)
+      continue;
+
+    /* value, time enabled, time running */
+    if (read(S_perfctr_fds[k], data, sizeof(data)) != (int) sizeof(data))
+      continue;
+
+    /* scale up if the counter was multiplexed with others */
+    if ((data[2] > 0) && (data[2] < data[1]))
+      values[k] = (unsigned long) ((double) data[0] * data[1] / data[2]);
+    else
+      values[k] = data[0];
+#endif
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/* perfctr_available()                                                        */
+/******************************************************************************/
+int perfctr_available(int index)
+{
+  if ((index < 0) || (index >= PERFCTR_NUM_COUNTERS))
+    return 0;
+
+  return (S_perfctr_fds[index] >= 0);
+}
+
+/******************************************************************************/
+/* perfctr_name()                                                             */
+/******************************************************************************/
+const char* perfctr_name(int index)
+{
+  if ((index < 0) || (index >= PERFCTR_NUM_COUNTERS))
+    return "";
+
+  return S_perfctr_names[index];
+}
@@ -0,0 +1,27 @@
+/******************************************************************************/
+/* perfctr.h (hardware performance counters for the tools)                    */
+/******************************************************************************/
+
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+enum
+{
+  PERFCTR_CYCLES = 0,
+  PERFCTR_INSTRUCTIONS,
+  PERFCTR_CACHE_MISSES,
+  PERFCTR_BRANCH_MISSES,
+  PERFCTR_NUM_COUNTERS
+};
+
+/* function declarations */
+int perfctr_open();
+int perfctr_close();
+
+int perfctr_start();
+int perfctr_stop(unsigned long* values);
+
+int perfctr_available(int index);
+const char* perfctr_name(int index);
+
+#endif